@@ -0,0 +1,186 @@
+#include "ClockEngine.h"
+#include "UsbMidiPort.h"
+
+#define CLOCK_BPM_X100_Q4     4000000000UL  // 60e6 us/min * 100 * 16 / 24 ppqn
+
+ClockEngine::ClockEngine()
+  : clocks(0), songPositions(0), tempoChanges(0), clampedSamples(0), dropouts(0), maxJitterUs(0)
+{
+  reset();
+}
+
+void ClockEngine::reset() {
+  resetEstimator();
+  shownBpmX10 = 0;
+  position = 0;
+  running = false;
+  awaitingFirstClock = false;
+}
+
+void ClockEngine::resetEstimator() {
+  lastClockMicros = 0;
+  periodQ4 = 0;
+  acquireCount = 0;
+  outlierRun = 0;
+  tempoValid = false;
+  clockPresent = false;
+}
+
+void ClockEngine::handleClock(unsigned long nowUs) {
+  clocks++;
+
+  if (clockPresent) {
+    unsigned long delta = nowUs - lastClockMicros;
+    if (delta > CLOCK_DROPOUT_US) {
+      // El clock se paró sin que update() lo viera: empezar de nuevo
+      dropouts++;
+      resetEstimator();
+    } else {
+      addPeriodSample(delta);
+    }
+  }
+  clockPresent = true;
+  lastClockMicros = nowUs;
+
+  if (running) {
+    if (awaitingFirstClock) {
+      awaitingFirstClock = false;
+    } else {
+      position++;
+    }
+  }
+}
+
+void ClockEngine::addPeriodSample(unsigned long deltaUs) {
+  int32_t sampleQ4 = (int32_t)deltaUs << 4;
+
+  if (acquireCount >= CLOCK_ACQUIRE_TICKS) {
+    int32_t deviation = sampleQ4 - periodQ4;
+    int32_t magnitude = (deviation < 0) ? -deviation : deviation;
+    uint32_t jitterUs = magnitude >> 4;
+    if (jitterUs > maxJitterUs) maxJitterUs = (jitterUs > 0xFFFF) ? 0xFFFF : jitterUs;
+
+    // Desvíos de más de 1/16 del periodo: solo cuentan si se repiten hacia el mismo lado
+    int32_t threshold = periodQ4 >> 4;
+    if (deviation > threshold) {
+      outlierRun = (outlierRun > 0) ? outlierRun + 1 : 1;
+    } else if (deviation < -threshold) {
+      outlierRun = (outlierRun < 0) ? outlierRun - 1 : -1;
+    } else {
+      outlierRun = 0;
+    }
+
+    if (outlierRun >= CLOCK_OUTLIER_TICKS || outlierRun <= -CLOCK_OUTLIER_TICKS) {
+      // Cambio de tempo: readquirir con media acumulada, manteniendo el tempo mostrado
+      tempoChanges++;
+      acquireCount = 0;
+      outlierRun = 0;
+    } else if (magnitude > (periodQ4 >> 1)) {
+      // Pulso perdido o duplicado: limitar su peso en la media
+      sampleQ4 = (deviation > 0) ? periodQ4 + (periodQ4 >> 1) : periodQ4 - (periodQ4 >> 1);
+      clampedSamples++;
+    }
+  }
+
+  if (acquireCount < CLOCK_ACQUIRE_TICKS) {
+    acquireCount++;
+    periodQ4 += (sampleQ4 - periodQ4) / acquireCount;
+  } else {
+    // Redondeo simétrico: el desplazamiento aritmético sesgaría el periodo a la baja
+    periodQ4 += (sampleQ4 - periodQ4 + (1 << (CLOCK_FILTER_SHIFT - 1))) >> CLOCK_FILTER_SHIFT;
+  }
+
+  if (periodQ4 < ((int32_t)CLOCK_MIN_PERIOD_US << 4)) {
+    periodQ4 = (int32_t)CLOCK_MIN_PERIOD_US << 4;
+  }
+
+  if (acquireCount >= CLOCK_ACQUIRE_TICKS) publishTempo();
+}
+
+void ClockEngine::publishTempo() {
+  uint16_t bpmX100 = CLOCK_BPM_X100_Q4 / (uint32_t)periodQ4;
+
+  if (!tempoValid) {
+    tempoValid = true;
+    shownBpmX10 = (bpmX100 + 5) / 10;
+    return;
+  }
+
+  // La décima mostrada solo cambia si el tempo filtrado se aleja lo bastante
+  int32_t diff = (int32_t)bpmX100 - (int32_t)shownBpmX10 * 10;
+  if (diff >= CLOCK_BPM_HYSTERESIS || diff <= -CLOCK_BPM_HYSTERESIS) {
+    shownBpmX10 = (bpmX100 + 5) / 10;
+  }
+}
+
+void ClockEngine::handleStart() {
+  position = 0;
+  running = true;
+  awaitingFirstClock = true;
+}
+
+void ClockEngine::handleContinue() {
+  running = true;
+  awaitingFirstClock = true;
+}
+
+void ClockEngine::handleStop() {
+  running = false;
+  awaitingFirstClock = false;
+}
+
+void ClockEngine::handleSongPosition(uint16_t sixteenths) {
+  // SPP cuenta semicorcheas: 6 pulsos de clock cada una
+  position = (uint32_t)sixteenths * (CLOCK_PPQN / 4);
+  songPositions++;
+}
+
+void ClockEngine::update(unsigned long nowUs, ClockData& out) {
+  if (clockPresent && nowUs - lastClockMicros > CLOCK_DROPOUT_US) {
+    dropouts++;
+    resetEstimator();
+  }
+
+  uint32_t beats = position / CLOCK_PPQN;
+  uint32_t bar = beats / CLOCK_BEATS_PER_BAR + 1;
+  out.bar = (bar > 9999) ? 9999 : bar;
+  out.beat = beats % CLOCK_BEATS_PER_BAR + 1;
+  out.tick = position % CLOCK_PPQN;
+  out.bpmX10 = shownBpmX10;
+  out.tempoValid = tempoValid;
+  out.isRunning = running && clockPresent;
+}
+
+void ClockEngine::printStatistics() const {
+  debugSerial.print(F("Clock: "));
+  if (tempoValid) {
+    debugSerial.print(shownBpmX10 / 10);
+    debugSerial.print(F("."));
+    debugSerial.print(shownBpmX10 % 10);
+    debugSerial.print(F(" BPM"));
+  } else {
+    debugSerial.print(F("sin tempo"));
+  }
+  debugSerial.println(running ? F(", en marcha") : F(", parado"));
+  debugSerial.print(F("Clock pulsos/SPP: "));
+  debugSerial.print(clocks);
+  debugSerial.print(F("/"));
+  debugSerial.println(songPositions);
+  debugSerial.print(F("Clock cambios tempo/limitados: "));
+  debugSerial.print(tempoChanges);
+  debugSerial.print(F("/"));
+  debugSerial.println(clampedSamples);
+  debugSerial.print(F("Clock jitter max (us): "));
+  debugSerial.println(maxJitterUs);
+  debugSerial.print(F("Clock caídas: "));
+  debugSerial.println(dropouts);
+}
+
+void ClockEngine::resetStatistics() {
+  clocks = 0;
+  songPositions = 0;
+  tempoChanges = 0;
+  clampedSamples = 0;
+  dropouts = 0;
+  maxJitterUs = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef CLOCK_ENGINE_H
+#define CLOCK_ENGINE_H
+
+#include "Config.h"
+#include <Arduino.h>
+
+#define CLOCK_DROPOUT_US        250000UL  // Sin clock (< 10 BPM): tempo desconocido
+#define CLOCK_MIN_PERIOD_US     4000      // Periodo mínimo filtrado (límite del cálculo en BPM)
+#define CLOCK_FILTER_SHIFT      6         // Media exponencial 1/64 sobre el periodo (~2.5 negras)
+#define CLOCK_ACQUIRE_TICKS     12        // Pulsos promediados antes de dar el tempo por válido
+#define CLOCK_OUTLIER_TICKS     6         // Desvíos seguidos del mismo signo: cambio de tempo
+#define CLOCK_BPM_HYSTERESIS    15        // Centésimas de BPM antes de cambiar la décima mostrada
+
+// Estimador de tempo sobre el MIDI clock (24 ppqn) y posición musical a
+// partir de Start/Continue/Stop y Song Position Pointer.
+//
+// El periodo se guarda en microsegundos con 4 bits fraccionarios y se filtra
+// con una media exponencial. El jitter de USB-MIDI retrasa un pulso y adelanta
+// el siguiente, así que los desvíos alternan de signo y la media los absorbe;
+// un cambio real de tempo desvía todos los pulsos hacia el mismo lado y
+// reinicia la adquisición.
+class ClockEngine {
+private:
+  // Estimación del tempo
+  unsigned long lastClockMicros;
+  int32_t periodQ4;                  // Periodo entre pulsos (us * 16)
+  uint8_t acquireCount;              // Pulsos promediados (hasta CLOCK_ACQUIRE_TICKS)
+  int8_t outlierRun;                 // Desvíos consecutivos: > 0 lentos, < 0 rápidos
+  uint16_t shownBpmX10;              // Tempo publicado, con histéresis
+  bool tempoValid;
+  bool clockPresent;
+
+  // Posición en pulsos de clock desde el inicio de la canción
+  uint32_t position;
+  bool running;
+  bool awaitingFirstClock;           // El primer pulso tras Start/Continue no avanza
+
+  // Estadísticas
+  uint32_t clocks;
+  uint32_t songPositions;
+  uint32_t tempoChanges;
+  uint32_t clampedSamples;
+  uint32_t dropouts;
+  uint16_t maxJitterUs;
+
+  void resetEstimator();
+  void addPeriodSample(unsigned long deltaUs);
+  void publishTempo();
+
+public:
+  ClockEngine();
+
+  void reset();
+  void handleClock(unsigned long nowUs);
+  void handleStart();
+  void handleContinue();
+  void handleStop();
+  void handleSongPosition(uint16_t sixteenths);
+
+  // Detectar la pérdida del clock y publicar compases:tiempos:pulsos y tempo
+  void update(unsigned long nowUs, ClockData& out);
+
+  bool isTempoValid() const { return tempoValid; }
+  bool isRunning() const { return running; }
+  uint16_t getBpmX10() const { return shownBpmX10; }
+  uint32_t getPosition() const { return position; }
+
+  // Diagnóstico
+  void printStatistics() const;
+  void resetStatistics();
+  uint32_t getClocks() const { return clocks; }
+  uint16_t getMaxJitterUs() const { return maxJitterUs; }
+};
+
+#endif // CLOCK_ENGINE_H
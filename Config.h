@@ -41,6 +41,7 @@
 #define NUM_BANKS       4
 #define NUM_SWITCHES    16  // 8 Mute + 8 Solo
 #define NUM_BUTTONS     5   // Transport buttons
+#define NUM_MUTE_GROUPS 4   // Grupos de mute configurables
 
 // Intervalos de tiempo (ms)
 #define POLL_INTERVAL_MS        5    // Polling switches/botones
@@ -49,11 +50,21 @@
 #define ENCODER_DEBOUNCE_MS     1    // Debounce encoders
 #define BUTTON_DEBOUNCE_MS      50   // Debounce botones
 #define SCREENSAVER_CHECK_MS    1000 // Verificar salvapantallas
+#define JOG_TICK_MS             20   // Emisión del jog/shuttle (50 Hz)
+#define RELATIVE_FLUSH_MS       10   // Envío de deltas acumulados de encoders relativos
+#define RELATIVE_CARRY_MAX      255  // Pasos pendientes máximos por encoder (el resto se envía en flushes siguientes)
+#define VALUE_HOLD_MS_DEFAULT   250  // Retención del valor local frente al eco del DAW
+#define ENCODER_HIRES_STEP      16   // Paso por detent en modos de 14 bits (8 por paso de 7 bits)
 
 // ==================== CONFIGURACIÓN MIDI ====================
 #define MIDI_CHANNEL_DEFAULT    1
 #define MIDI_BAUD_RATE         31250
+#define MIDI_PORT_DIN          0x01  // Serial1 (USART1), MIDI DIN
+#define MIDI_PORT_USB          0x02  // Serial (USB), puente serie-MIDI en el host
+#define MIDI_PORT_ALL          0x03
 #define MTC_FRAME_RATE         30    // 30 FPS para MTC
+#define CLOCK_PPQN             24    // Pulsos de MIDI clock por negra
+#define CLOCK_BEATS_PER_BAR    4     // El clock no transmite el compás: 4/4
 #define ENCODER_ACCELERATION   true
 
 // Comandos MIDI
@@ -62,6 +73,10 @@
 #define MIDI_RECORD            0xFB
 #define MIDI_JOG_FORWARD       60    // CC60
 #define MIDI_JOG_BACKWARD      61    // CC61
+#define MACKIE_JOG_CC          0x3C  // Jog wheel Mackie Control (canal 1)
+#define JOG_NOTE_FORWARD       0x5C  // Nota Fast Forward para pulsos de jog
+#define JOG_NOTE_BACKWARD      0x5B  // Nota Rewind para pulsos de jog
+#define SWITCH_CC_BASE         23    // CC del primer switch Mute (Solo sigue a continuación)
 
 // ==================== CONFIGURACIÓN DE PANTALLA ====================
 #define TFT_WIDTH              480
@@ -71,8 +86,8 @@
 #define MAX_BRIGHTNESS         100
 
 // Reducir buffers enormes
-#define SYSEX_BUFFER_SIZE 32    // Era 256
 #define MAX_PRESET_NAME 10      // Era 16
+#define TRACK_NAME_SIZE 5       // 4 caracteres + terminador
 #define MAX_FILENAME_LENGTH 16  // Era 32
 
 // ==================== COLORES STUDIO ONE 7 (RGB565) ====================
@@ -128,6 +143,72 @@ enum ControlType {
   CT_PITCH = 2
 };
 
+enum EncoderOutputMode {
+  ENC_OUT_ABSOLUTE = 0,      // Valor absoluto (0-127)
+  ENC_OUT_REL_TWOS = 1,      // Relativo complemento a dos (1=+1, 127=-1)
+  ENC_OUT_REL_OFFSET = 2,    // Relativo binario offset 64 (65=+1, 63=-1)
+  ENC_OUT_REL_SIGNMAG = 3,   // Relativo signo-magnitud (1=+1, 65=-1)
+  ENC_OUT_REL_MACKIE = 4,    // V-Pot Mackie (1-15 horario, 65-79 antihorario)
+  ENC_OUT_HIRES_CC = 5,      // 14 bits: MSB en CC n, LSB en CC n+32 (n < 32)
+  ENC_OUT_HIRES_NRPN = 6     // 14 bits: NRPN n (CC 99/98) con Data Entry CC 6/38
+};
+
+#define ENC_OUT_IS_RELATIVE(mode)  ((mode) >= ENC_OUT_REL_TWOS && (mode) <= ENC_OUT_REL_MACKIE)
+#define ENC_OUT_IS_HIRES(mode)     ((mode) == ENC_OUT_HIRES_CC || (mode) == ENC_OUT_HIRES_NRPN)
+
+enum SwitchMessageType {
+  SW_MSG_NOTE = 0,
+  SW_MSG_CC = 1,
+  SW_MSG_SYSEX = 2
+};
+
+enum SwitchMode {
+  SW_MODE_TOGGLE = 0,
+  SW_MODE_MOMENTARY = 1
+};
+
+enum JogOutputMode {
+  JOG_OUT_RELATIVE_CC = 0,   // CC60/CC61 con magnitud
+  JOG_OUT_MACKIE = 1,        // CC 0x3C con signo en bit 6
+  JOG_OUT_NOTES = 2          // Pulsos de nota FF/REW
+};
+
+enum ProtocolMode {
+  PROTO_STUDIO_ONE = 0,      // Mapeo configurable + SysEx Studio One
+  PROTO_MCU = 1,             // Mackie Control Universal
+  PROTO_HUI = 2              // Mackie HUI
+};
+
+enum TimeDisplayMode {
+  TIME_SHOW_MTC = 0,         // hh:mm:ss:ff
+  TIME_SHOW_BEATS = 1,       // compases:tiempos:pulsos y tempo del MIDI clock
+  TIME_SHOW_BOTH = 2
+};
+
+// Generación de timing como maestro (bits combinables)
+enum MasterMode {
+  MASTER_OFF = 0,
+  MASTER_CLOCK = 1,          // MIDI clock continuo, Start/Continue/Stop con el transporte
+  MASTER_MTC = 2,            // Quarter frames mientras el transporte está en marcha
+  MASTER_BOTH = 3
+};
+
+// Estado de la conexión con el DAW (DawMonitor)
+enum DawLinkState {
+  DAW_LINK_UNKNOWN = 0,      // Aún no ha llegado nada del DAW
+  DAW_LINK_CONNECTED = 1,
+  DAW_LINK_LOST = 2          // Silencio más largo que la ventana de presencia
+};
+
+// Tipo de frame rate codificado en MTC (bits 5-6 de las horas)
+enum MtcRate {
+  MTC_RATE_24 = 0,
+  MTC_RATE_25 = 1,
+  MTC_RATE_2997_DF = 2,      // 29.97 drop-frame
+  MTC_RATE_30 = 3
+};
+
+
 enum ButtonIndex {
   BTN_PLAY = 0,
   BTN_STOP = 1,  
@@ -168,15 +249,15 @@ struct EncoderConfig {
   //uint8_t cc;               // Número CC o Note
   uint8_t controlType : 2;   // Tipo de control (CC/Note/Pitch)
   bool isPan : 1;               // true si es encoder de pan
+  uint8_t outputMode : 3;       // Absoluto, relativo o 14 bits (EncoderOutputMode)
   int8_t value;            // Valor actual local (0-127)
-  int8_t dawValue;         // Valor recibido del DAW (0-127)
+  int8_t dawValue;         // Valor mostrado: predicción local o eco del DAW (0-127)
   int8_t minValue;         // Valor mínimo (0-127)
   int8_t maxValue;         // Valor máximo (0-127)
-  bool isMute : 1;              // Estado mute
-  bool isSolo : 1;              // Estado solo
+  uint8_t valueFine;       // 7 bits bajos del valor en modos de 14 bits (value = 7 altos)
   uint16_t trackColor;      // Color del track
  // uint16_t panColor;        // Color del pan (puede ser diferente)
-  char trackName[5];        // Nombre del track (8 chars + null terminator)
+  char trackName[TRACK_NAME_SIZE];  // Nombre del track (4 chars + terminador)
   
   // Constructor por defecto
   EncoderConfig() {
@@ -184,31 +265,69 @@ struct EncoderConfig {
   control = 7;           // Reemplaza 'cc = 7'
   controlType = CT_CC;
   isPan = false;
+  outputMode = ENC_OUT_ABSOLUTE;
   value = 64;
   dawValue = 64;
   minValue = 0;
   maxValue = 127;
-  isMute = false;
-  isSolo = false;
+  valueFine = 0;
   trackColor = 0xFFFF;
-  strncpy(trackName, "Trk", 5); // Nombre corto
-  trackName[5] = '\0';
+  strncpy(trackName, "Trk", TRACK_NAME_SIZE); // Nombre corto
+  trackName[TRACK_NAME_SIZE - 1] = '\0';
     //panColor = 0xFFFF;
     //strcpy(trackName, "Track");
   }
 };
 
+// Estado Mute/Solo de un banco: un bit por track
+struct BankMixState {
+  uint16_t mute;
+  uint16_t solo;
+  
+  BankMixState() : mute(0), solo(0) {}
+};
+
+// Mapeo de un switch a su mensaje MIDI (indexado por número de switch)
+struct SwitchMapping {
+  uint8_t messageType : 2;   // Note/CC/SysEx
+  uint8_t mode : 1;          // Toggle/Momentáneo
+  uint8_t channel : 5;       // Canal MIDI (1-16)
+  uint8_t number;            // Nota, CC o función SysEx (0-127)
+  uint8_t onValue;           // Valor/velocidad en estado activo
+  uint8_t offValue;          // Valor/velocidad en estado inactivo
+  
+  SwitchMapping() : messageType(SW_MSG_CC), mode(SW_MODE_TOGGLE), 
+                    channel(MIDI_CHANNEL_DEFAULT), number(0), onValue(127), offValue(0) {}
+};
+
 struct AppConfig {
   uint8_t brightness;                  // Brillo pantalla (0-100)
   uint32_t screensaverTimeout;        // Timeout en ms (0=deshabilitado)
   uint8_t currentBank;                // Banco actual (0-3)
-  uint8_t mtcOffset;                  // Offset MTC en frames
+  int8_t mtcOffset;                   // Offset MTC en frames (-30..30)
   bool encoderAcceleration;           // Aceleración de encoders
   uint8_t midiChannel;                // Canal MIDI base (1-16)
   DisplayOrientation orientation;      // Orientación pantalla
   bool autoSave;                      // Auto-guardar configuración
   uint8_t encoderSensitivity;         // Sensibilidad encoders (1-10)
   uint16_t vuMeterDecay;              // Decaimiento VU meters (ms)
+  uint16_t valueHoldMs;               // Retención del valor local antes de aceptar el DAW (ms)
+  SwitchMapping switchMap[NUM_SWITCHES]; // Mensaje MIDI de cada switch Mute/Solo
+  uint16_t muteGroups[NUM_MUTE_GROUPS];  // Tracks de cada grupo de mute (bitmask)
+  uint16_t soloDefeat[NUM_BANKS];        // Tracks inmunes al solo (bitmask por banco)
+  bool soloExclusive;                    // Un solo nuevo cancela los anteriores
+  uint8_t jogOutputMode;                 // Formato de salida del jog/shuttle
+  uint8_t protocolMode;                  // Protocolo con el DAW (ProtocolMode)
+  uint8_t timeDisplay;                   // Posición mostrada (TimeDisplayMode)
+  uint8_t masterMode;                    // Clock/MTC generados (MasterMode)
+  uint16_t masterTempoX10;               // Tempo del clock generado (BPM * 10)
+  uint8_t masterRate;                    // Frame rate del MTC generado (MtcRate)
+  bool usbMidi;                          // Serial como transporte MIDI (sin depuración)
+  uint8_t midiOutPorts;                  // Puertos de salida (MIDI_PORT_*)
+  uint8_t midiInPorts;                   // Puertos de entrada fusionados (MIDI_PORT_*)
+  bool midiThru;                         // Reenviar la entrada a la salida (merge)
+  bool activeSensing;                    // Enviar Active Sensing (0xFE) al DAW
+  bool trafficMonitor;                   // Trama de estadísticas MIDI por Serial cada segundo
   // Constructor por defecto
   AppConfig() {
     brightness = DEFAULT_BRIGHTNESS;
@@ -221,6 +340,28 @@ struct AppConfig {
     autoSave = true;
     encoderSensitivity = 5;
     vuMeterDecay = 1000;
+    valueHoldMs = VALUE_HOLD_MS_DEFAULT;
+    
+    // Mute en CC 23-30, Solo en CC 31-38 (fuera de los Channel Mode 120-127)
+    for (uint8_t i = 0; i < NUM_SWITCHES; i++) {
+      switchMap[i].number = SWITCH_CC_BASE + i;
+    }
+    
+    memset(muteGroups, 0, sizeof(muteGroups));
+    memset(soloDefeat, 0, sizeof(soloDefeat));
+    soloExclusive = false;
+    jogOutputMode = JOG_OUT_RELATIVE_CC;
+    protocolMode = PROTO_STUDIO_ONE;
+    timeDisplay = TIME_SHOW_MTC;
+    masterMode = MASTER_OFF;
+    masterTempoX10 = 1200;
+    masterRate = MTC_RATE_30;
+    usbMidi = false;
+    midiOutPorts = MIDI_PORT_ALL;
+    midiInPorts = MIDI_PORT_ALL;
+    midiThru = false;
+    activeSensing = false;
+    trafficMonitor = false;
   }
 };
 
@@ -229,9 +370,22 @@ struct MtcData {
   uint8_t minutes;
   uint8_t seconds;
   uint8_t frames;
+  uint8_t subFrame;          // Centésimas de frame (interpolado)
+  uint8_t rate;              // MtcRate
+  bool isRunning;
+  
+  MtcData() : hours(0), minutes(0), seconds(0), frames(0), subFrame(0), rate(MTC_RATE_30), isRunning(false) {}
+};
+
+struct ClockData {
+  uint16_t bar;              // Desde 1
+  uint8_t beat;              // 1..CLOCK_BEATS_PER_BAR
+  uint8_t tick;              // 0..CLOCK_PPQN-1
+  uint16_t bpmX10;           // Tempo en décimas de BPM
+  bool tempoValid;
   bool isRunning;
   
-  MtcData() : hours(0), minutes(0), seconds(0), frames(0), isRunning(false) {}
+  ClockData() : bar(1), beat(1), tick(0), bpmX10(0), tempoValid(false), isRunning(false) {}
 };
 
 struct TransportState {
@@ -360,10 +514,17 @@ extern volatile InterruptFlags interruptFlags;
 // Callbacks del sistema (implementados en el archivo principal)
 extern void onEncoderChange(uint8_t encoderIndex, int8_t change);
 extern void onSwitchPress(uint8_t switchIndex);
+extern void onSwitchRelease(uint8_t switchIndex);
 extern void onButtonPress(uint8_t buttonIndex);
 extern void onNavigationEncoderChange(int8_t change);
 extern void onNavigationButtonPress();
+extern void onNavigationButtonRelease();
 extern void onMenuExit();
+extern void applyProtocolMode();
+extern void applyTimingMaster();
+extern void applyMidiPorts();
+extern void onDisplayYield();
+extern void onDawLinkChanged(uint8_t state);
 extern void resetActivity();
 
 // ISRs (implementados en el archivo principal)
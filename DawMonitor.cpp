@@ -0,0 +1,91 @@
+#include "DawMonitor.h"
+#include "UsbMidiPort.h"
+#include "Midi_Controller.h"
+
+extern Midi_Controller midi_controller;
+
+DawMonitor dawMonitor;
+
+DawMonitor::DawMonitor()
+  : state(DAW_LINK_UNKNOWN), sensingTx(false), sensingRx(false),
+    lastSensingCheck(0), lastTxBytes(0), stateSince(0),
+    disconnects(0), sensingSent(0), sensingTimeouts(0)
+{
+}
+
+void DawMonitor::setActiveSensing(bool enable) {
+  sensingTx = enable;
+  lastSensingCheck = millis();
+  lastTxBytes = midi_controller.getTxQueue().getBytesSent();
+}
+
+void DawMonitor::update(unsigned long currentTime) {
+  if (sensingTx) serviceSensingTx(currentTime);
+
+  unsigned long lastReceive = midi_controller.getLastReceiveTime();
+  if (lastReceive == 0) return;  // El DAW aún no ha enviado nada
+
+  // Diferencias con signo: la entrada se procesa después de tomar currentTime
+  // en el loop y sus marcas pueden ser unos ms posteriores
+  unsigned long lastSensing = midi_controller.getLastActiveSensingTime();
+  sensingRx = lastSensing != 0 && (long)(currentTime - lastSensing) < DAW_PRESENCE_WINDOW_MS;
+
+  // Un 0xFE reciente indica que el DAW sigue la especificación: ventana corta
+  long window = sensingRx ? DAW_SENSING_TIMEOUT_MS : DAW_PRESENCE_WINDOW_MS;
+  bool present = (long)(currentTime - lastReceive) < window;
+
+  if (present && state != DAW_LINK_CONNECTED) {
+    setState(DAW_LINK_CONNECTED, currentTime);
+  } else if (!present && state == DAW_LINK_CONNECTED) {
+    if (sensingRx) sensingTimeouts++;
+    disconnects++;
+    setState(DAW_LINK_LOST, currentTime);
+  }
+}
+
+void DawMonitor::setState(uint8_t newState, unsigned long currentTime) {
+  state = newState;
+  stateSince = currentTime;
+  debugSerial.println(newState == DAW_LINK_CONNECTED ? F("DAW conectado") : F("DAW desconectado"));
+  onDawLinkChanged(newState);
+}
+
+void DawMonitor::serviceSensingTx(unsigned long currentTime) {
+  if ((long)(currentTime - lastSensingCheck) < ACTIVE_SENSING_PERIOD_MS) return;
+  lastSensingCheck = currentTime;
+
+  // Cualquier otro byte enviado en el periodo ya vale como señal de vida
+  uint32_t txBytes = midi_controller.getTxQueue().getBytesSent();
+  if (txBytes == lastTxBytes) {
+    midi_controller.sendActiveSensing();
+    sensingSent++;
+  }
+  lastTxBytes = midi_controller.getTxQueue().getBytesSent();
+}
+
+void DawMonitor::printStatistics() const {
+  debugSerial.print(F("DAW: "));
+  switch (state) {
+    case DAW_LINK_CONNECTED: debugSerial.print(F("conectado")); break;
+    case DAW_LINK_LOST:      debugSerial.print(F("desconectado")); break;
+    default:                 debugSerial.print(F("sin datos")); break;
+  }
+  if (state != DAW_LINK_UNKNOWN) {
+    debugSerial.print(F(" hace "));
+    debugSerial.print((millis() - stateSince) / 1000);
+    debugSerial.print(F("s"));
+  }
+  debugSerial.println(sensingRx ? F(" (Active Sensing)") : F(""));
+  debugSerial.print(F("Desconexiones/por Active Sensing: "));
+  debugSerial.print(disconnects);
+  debugSerial.print(F("/"));
+  debugSerial.println(sensingTimeouts);
+  debugSerial.print(F("Active Sensing enviados: "));
+  debugSerial.println(sensingSent);
+}
+
+void DawMonitor::resetStatistics() {
+  disconnects = 0;
+  sensingSent = 0;
+  sensingTimeouts = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef DAW_MONITOR_H
+#define DAW_MONITOR_H
+
+#include "Config.h"
+#include <Arduino.h>
+
+#define DAW_PRESENCE_WINDOW_MS    5000  // Sin ningún byte del DAW durante este tiempo: desconectado
+#define DAW_SENSING_TIMEOUT_MS    330   // DAW con Active Sensing: 300 ms de la especificación + margen
+#define ACTIVE_SENSING_PERIOD_MS  270   // Envío propio, por debajo de los 300 ms del receptor
+
+#define MIDI_ACTIVE_SENSING       0xFE
+
+// Presencia del DAW a partir del tráfico entrante. Cualquier byte recibido
+// cuenta como señal de vida; si el DAW envía Active Sensing, la ventana se
+// acorta a la de la especificación y su ausencia se detecta en 330 ms. Los
+// cambios de estado se notifican con onDawLinkChanged() para que pantalla y
+// resincronización suspendan o reanuden su trabajo.
+//
+// Opcionalmente envía Active Sensing cuando la salida lleva
+// ACTIVE_SENSING_PERIOD_MS sin ningún otro byte.
+class DawMonitor {
+private:
+  uint8_t state;                 // DawLinkState
+  bool sensingTx;
+  bool sensingRx;                // El DAW envía Active Sensing: ventana corta
+  unsigned long lastSensingCheck;
+  uint32_t lastTxBytes;
+  unsigned long stateSince;
+  
+  // Estadísticas
+  uint32_t disconnects;
+  uint32_t sensingSent;
+  uint32_t sensingTimeouts;
+  
+  void setState(uint8_t newState, unsigned long currentTime);
+  void serviceSensingTx(unsigned long currentTime);
+
+public:
+  DawMonitor();
+  
+  void setActiveSensing(bool enable);
+  bool isActiveSensingEnabled() const { return sensingTx; }
+  
+  // Llamar desde loop, después de procesar la entrada MIDI
+  void update(unsigned long currentTime);
+  
+  uint8_t getState() const { return state; }
+  bool isConnected() const { return state == DAW_LINK_CONNECTED; }
+  bool isDawSensing() const { return sensingRx; }
+  
+  // Diagnóstico
+  uint32_t getDisconnects() const { return disconnects; }
+  void printStatistics() const;
+  void resetStatistics();
+};
+
+extern DawMonitor dawMonitor;
+
+#endif // DAW_MONITOR_H
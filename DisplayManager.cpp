@@ -1,11 +1,13 @@
 #include "DisplayManager.h"
+#include "UsbMidiPort.h"
 #include "Strings.h"
 #include <Arduino.h>
 #include <SPI.h>
 
 DisplayManager::DisplayManager() 
   : tft(TFT_CS, TFT_DC, TFT_RST), initialized(false), currentBrightness(100),
-    currentOrientation(ORIENT_270), needsFullRedraw(true), lastFullRedraw(0)
+    currentOrientation(ORIENT_270), dawLink(DAW_LINK_UNKNOWN), needsFullRedraw(true), lastFullRedraw(0),
+    mixDirtyMask(0xFFFF)
 {
   memset(vuLevels, 0, sizeof(vuLevels));
   memset(lastVuUpdate, 0, sizeof(lastVuUpdate));
@@ -16,7 +18,7 @@ DisplayManager::~DisplayManager() {
 }
 
 bool DisplayManager::initialize(DisplayOrientation orientation, uint8_t brightness) {
-  Serial.println(F("Inicializando pantalla ST7796..."));
+  debugSerial.println(F("Inicializando pantalla ST7796..."));
   
   initializePins();
   setupSPI();
@@ -24,7 +26,7 @@ bool DisplayManager::initialize(DisplayOrientation orientation, uint8_t brightne
   tft.init(TFT_WIDTH, TFT_HEIGHT);
   
   if (!testDisplayConnection()) {
-    Serial.println(F("ERROR: Pantalla no responde"));
+    debugSerial.println(F("ERROR: Pantalla no responde"));
     return false;
   }
   
@@ -37,7 +39,7 @@ bool DisplayManager::initialize(DisplayOrientation orientation, uint8_t brightne
   clearScreen(COLOR_BLACK);
   
   initialized = true;
-  Serial.println(F("Pantalla inicializada correctamente"));
+  debugSerial.println(F("Pantalla inicializada correctamente"));
   return true;
 }
 
@@ -98,17 +100,20 @@ void DisplayManager::calculateLayout() {
 }
 
 void DisplayManager::drawMainScreen(const EncoderConfig encoders[NUM_ENCODERS], 
-                                  const MtcData& mtc, uint8_t currentBank, 
-                                  const TransportState& transport) {
+                                  const MtcData& mtc, const ClockData& clock, uint8_t currentBank, 
+                                  const TransportState& transport,
+                                  const BankMixState& mix, uint16_t impliedMute) {
   if (!initialized) return;
   
   unsigned long currentTime = millis();
   
   if (needsFullRedraw || (currentTime - lastFullRedraw > 5000)) {
     clearScreen(COLOR_BLACK);
+    onDisplayYield();
     drawHeader();
     needsFullRedraw = false;
     lastFullRedraw = currentTime;
+    mixDirtyMask = 0xFFFF;
   }
   
   updateVUMeters();
@@ -116,17 +121,24 @@ void DisplayManager::drawMainScreen(const EncoderConfig encoders[NUM_ENCODERS],
   for (int i = 0; i < 8; i++) {
     const EncoderConfig& volEncoder = encoders[i];
     const EncoderConfig& panEncoder = encoders[i + 8];
+    uint16_t bit = 1u << i;
     
     drawVolumeBar(i, volEncoder.dawValue, volEncoder.trackColor, 
-                 volEncoder.isSolo || volEncoder.isMute);
+                 (mix.solo | mix.mute) & bit);
     drawVUMeter(i, vuLevels[i], volEncoder.trackColor);
     
     drawPanBar(i, panEncoder.dawValue, panEncoder.trackColor);
     
     drawChannelInfo(i, volEncoder);
+    
+    if (mixDirtyMask & bit) {
+      drawMixIndicators(i, mix.mute & bit, mix.solo & bit, impliedMute & bit);
+    }
+    onDisplayYield();
   }
+  mixDirtyMask = 0;
   
-  drawMTCInfo(mtc);
+  drawTimeInfo(mtc, clock);
   drawTransportInfo(transport, currentBank);
 }
 
@@ -201,13 +213,24 @@ void DisplayManager::drawChannelInfo(uint8_t channel, const EncoderConfig& confi
   snprintf(nameDisplay, sizeof(nameDisplay), "%.5s", config.trackName);
   drawCenteredText(nameDisplay, x, y + 40, CHANNEL_WIDTH, 12, 
                    COLOR_LIGHT_GRAY, FONT_SIZE_SMALL);
-                   
-  if (config.isMute) {
+}
+
+void DisplayManager::drawMixIndicators(uint8_t channel, bool muted, bool soloed, bool impliedMute) {
+  uint16_t x = layout.channelX[channel];
+  uint16_t y = layout.textY;
+  
+  // Borrar ambos indicadores antes de redibujar
+  tft.fillRect(x, y + 30, 12, 12, COLOR_BLACK);
+  tft.fillRect(x + CHANNEL_WIDTH - 15, y + 30, 12, 12, COLOR_BLACK);
+  
+  if (muted) {
     tft.fillCircle(x + 5, y + 35, 4, COLOR_RED);
     drawCenteredText("M", x, y + 30, 12, 12, COLOR_WHITE, FONT_SIZE_SMALL);
+  } else if (impliedMute) {
+    tft.drawCircle(x + 5, y + 35, 4, COLOR_RED);
   }
   
-  if (config.isSolo) {
+  if (soloed) {
     tft.fillCircle(x + CHANNEL_WIDTH - 10, y + 35, 4, COLOR_YELLOW);
     drawCenteredText("S", x + CHANNEL_WIDTH - 15, y + 30, 12, 12, COLOR_BLACK, FONT_SIZE_SMALL);
   }
@@ -230,6 +253,72 @@ void DisplayManager::drawMTCInfo(const MtcData& mtc) {
   tft.print(timeStr);
 }
 
+void DisplayManager::drawBeatInfo(const ClockData& clock) {
+  char beatStr[10];
+  snprintf(beatStr, sizeof(beatStr), "%3u:%u:%02u", clock.bar, clock.beat, clock.tick);
+  
+  char bpmStr[10];
+  if (clock.tempoValid) {
+    snprintf(bpmStr, sizeof(bpmStr), "%u.%u", clock.bpmX10 / 10, clock.bpmX10 % 10);
+  } else {
+    snprintf(bpmStr, sizeof(bpmStr), "---.-");
+  }
+  
+  tft.fillRect(layout.mtcX - 5, layout.mtcY - 2, 225, 25, COLOR_DARK_GRAY);
+  
+  tft.setTextColor(clock.isRunning ? COLOR_GREEN : COLOR_WHITE);
+  tft.setTextSize(FONT_SIZE_LARGE);
+  tft.setCursor(layout.mtcX, layout.mtcY);
+  tft.print(beatStr);
+  
+  tft.setTextColor(COLOR_YELLOW);
+  tft.setTextSize(FONT_SIZE_SMALL);
+  tft.setCursor(layout.mtcX + 170, layout.mtcY);
+  tft.print(bpmStr);
+  tft.setCursor(layout.mtcX + 170, layout.mtcY + 10);
+  tft.print("BPM");
+}
+
+void DisplayManager::drawTimeInfo(const MtcData& mtc, const ClockData& clock) {
+  if (appConfig.timeDisplay == TIME_SHOW_BEATS) {
+    drawBeatInfo(clock);
+    return;
+  }
+  if (appConfig.timeDisplay != TIME_SHOW_BOTH) {
+    drawMTCInfo(mtc);
+    return;
+  }
+  
+  // Ambos en una línea a tamaño medio: hora MTC, compás y tempo
+  char timeStr[12];
+  snprintf(timeStr, sizeof(timeStr), "%02d:%02d:%02d:%02d", 
+           mtc.hours, mtc.minutes, mtc.seconds, mtc.frames);
+  char beatStr[10];
+  snprintf(beatStr, sizeof(beatStr), "%3u:%u:%02u", clock.bar, clock.beat, clock.tick);
+  char bpmStr[8];
+  if (clock.tempoValid) {
+    snprintf(bpmStr, sizeof(bpmStr), "%u.%u", clock.bpmX10 / 10, clock.bpmX10 % 10);
+  } else {
+    snprintf(bpmStr, sizeof(bpmStr), "---.-");
+  }
+  
+  tft.fillRect(layout.mtcX - 65, layout.mtcY - 2, 298, 25, COLOR_DARK_GRAY);
+  
+  tft.setTextSize(FONT_SIZE_MEDIUM);
+  tft.setTextColor(mtc.isRunning ? COLOR_GREEN : COLOR_WHITE);
+  tft.setCursor(layout.mtcX - 60, layout.mtcY + 4);
+  tft.print(timeStr);
+  
+  tft.setTextColor(clock.isRunning ? COLOR_GREEN : COLOR_WHITE);
+  tft.setCursor(layout.mtcX + 84, layout.mtcY + 4);
+  tft.print(beatStr);
+  
+  tft.setTextColor(COLOR_YELLOW);
+  tft.setTextSize(FONT_SIZE_SMALL);
+  tft.setCursor(layout.mtcX + 198, layout.mtcY + 8);
+  tft.print(bpmStr);
+}
+
 void DisplayManager::drawTransportInfo(const TransportState& transport, uint8_t currentBank) {
   char bankStr[3];//8
   snprintf(bankStr, sizeof(bankStr), "B%d", currentBank + 1);
@@ -251,11 +340,20 @@ void DisplayManager::drawTransportInfo(const TransportState& transport, uint8_t
     tft.fillCircle(transportX + 20, layout.bankY + 10, 6, COLOR_RED);
     drawCenteredText("R", transportX + 17, layout.bankY + 5, 8, 12, COLOR_WHITE, FONT_SIZE_SMALL);
   }
+  
+  // Estado de la conexión con el DAW
+  uint16_t linkColor = (dawLink == DAW_LINK_CONNECTED) ? COLOR_GREEN :
+                       (dawLink == DAW_LINK_LOST) ? COLOR_RED : COLOR_LIGHT_GRAY;
+  tft.fillRect(transportX + 34, layout.bankY + 4, 22, 12, COLOR_DARK_GRAY);
+  tft.setTextColor(linkColor);
+  tft.setTextSize(FONT_SIZE_SMALL);
+  tft.setCursor(transportX + 36, layout.bankY + 6);
+  tft.print("DAW");
 }
 
-void DisplayManager::drawScreensaver(const MtcData& mtc, uint8_t currentBank) {
+void DisplayManager::drawScreensaver(const MtcData& mtc, const ClockData& clock, uint8_t currentBank) {
   clearScreen(COLOR_BLACK);
-  drawMTCInfo(mtc);
+  drawTimeInfo(mtc, clock);
   
   char bankStr[8];
   snprintf(bankStr, sizeof(bankStr), "Bank %d", currentBank + 1);
@@ -286,6 +384,9 @@ void DisplayManager::drawBootScreen() {
 }
 
 void DisplayManager::updateVUMeters() {
+  // Sin DAW no llegan niveles nuevos: congelar en vez de caer a cero
+  if (dawLink == DAW_LINK_LOST) return;
+  
   unsigned long currentTime = millis();
   
   for (int i = 0; i < NUM_ENCODERS; i++) {
@@ -359,6 +460,17 @@ void DisplayManager::setVULevel(uint8_t channel, uint8_t level) {
   }
 }
 
+void DisplayManager::setDawLink(uint8_t state) {
+  if (state == DAW_LINK_CONNECTED && dawLink == DAW_LINK_LOST) {
+    // Reanudar el decaimiento desde ahora, no desde el último nivel recibido
+    unsigned long currentTime = millis();
+    for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+      lastVuUpdate[i] = currentTime;
+    }
+  }
+  dawLink = state;
+}
+
 uint8_t DisplayManager::getVULevel(uint8_t channel) const {
   return (channel < NUM_ENCODERS) ? vuLevels[channel] : 0;
 }
@@ -411,7 +523,7 @@ void DisplayManager::drawConfirmDialog(const char* message) {
 }
 
 void DisplayManager::runDisplayTest() {
-  Serial.println(F("Ejecutando test de pantalla..."));
+  debugSerial.println(F("Ejecutando test de pantalla..."));
   
   const uint16_t testColors[] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_WHITE, 
                                 COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA};
@@ -460,7 +572,7 @@ void DisplayManager::runDisplayTest() {
   
   delay(2000);
   clearScreen(COLOR_BLACK);
-  Serial.println(F("Test de pantalla completado"));
+  debugSerial.println(F("Test de pantalla completado"));
 }
 
 void DisplayManager::showDiagnostics() {
@@ -562,7 +674,7 @@ void DisplayManager::drawMenuFrame() {
 }
 
 void DisplayManager::benchmarkDisplay() {
-  Serial.println(F("Ejecutando benchmark de pantalla..."));
+  debugSerial.println(F("Ejecutando benchmark de pantalla..."));
   
   unsigned long startTime, endTime;
   uint32_t operations;
@@ -576,8 +688,8 @@ void DisplayManager::benchmarkDisplay() {
   }
   endTime = millis();
   
-  Serial.print(F("Llenados por segundo: "));
-  Serial.println(operations);
+  debugSerial.print(F("Llenados por segundo: "));
+  debugSerial.println(operations);
   
   clearScreen(COLOR_BLACK);
   startTime = millis();
@@ -590,8 +702,8 @@ void DisplayManager::benchmarkDisplay() {
     }
   }
   
-  Serial.print(F("Pixeles por segundo: "));
-  Serial.println(operations);
+  debugSerial.print(F("Pixeles por segundo: "));
+  debugSerial.println(operations);
   
   clearScreen(COLOR_BLACK);
   startTime = millis();
@@ -604,9 +716,9 @@ void DisplayManager::benchmarkDisplay() {
     operations++;
   }
   
-  Serial.print(F("Lineas por segundo: "));
-  Serial.println(operations);
+  debugSerial.print(F("Lineas por segundo: "));
+  debugSerial.println(operations);
   
   clearScreen(COLOR_BLACK);
-  Serial.println(F("Benchmark completado"));
+  debugSerial.println(F("Benchmark completado"));
 }
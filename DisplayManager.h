@@ -30,9 +30,11 @@ private:
   
   uint8_t vuLevels[NUM_ENCODERS];
   unsigned long lastVuUpdate[NUM_ENCODERS];
+  uint8_t dawLink;           // DawLinkState: sin DAW los VU se congelan
   
   bool needsFullRedraw;
   unsigned long lastFullRedraw;
+  uint16_t mixDirtyMask;     // Canales con indicadores Mute/Solo pendientes
   
   struct LayoutPositions {
     uint16_t channelX[8];
@@ -49,6 +51,7 @@ private:
   void drawPanBar(uint8_t channel, uint8_t value, uint16_t color);
   void drawVUMeter(uint8_t channel, uint8_t level, uint16_t color);
   void drawChannelInfo(uint8_t channel, const EncoderConfig& config);
+  void drawMixIndicators(uint8_t channel, bool muted, bool soloed, bool impliedMute);
   void drawHeader();
   void drawFooter(const TransportState& transport);
   
@@ -68,9 +71,11 @@ public:
   uint8_t getBrightness() const { return currentBrightness; }
   
   void drawMainScreen(const EncoderConfig encoders[NUM_ENCODERS], 
-                     const MtcData& mtc, uint8_t currentBank, 
-                     const TransportState& transport);
-  void drawScreensaver(const MtcData& mtc, uint8_t currentBank);
+                     const MtcData& mtc, const ClockData& clock, uint8_t currentBank, 
+                     const TransportState& transport,
+                     const BankMixState& mix, uint16_t impliedMute);
+  void markMixDirty(uint16_t mask) { mixDirtyMask |= mask; }
+  void drawScreensaver(const MtcData& mtc, const ClockData& clock, uint8_t currentBank);
   void drawBootScreen();
   void drawErrorScreen(const char* error);
   
@@ -96,11 +101,14 @@ public:
   void fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
   
   void drawMTCInfo(const MtcData& mtc);
+  void drawBeatInfo(const ClockData& clock);
+  void drawTimeInfo(const MtcData& mtc, const ClockData& clock);  // Según appConfig.timeDisplay
   void drawTransportInfo(const TransportState& transport, uint8_t currentBank);
   void drawMessage(const char* message);
   void drawConfirmDialog(const char* message);
   
   void setVULevel(uint8_t channel, uint8_t level);
+  void setDawLink(uint8_t state);
   uint8_t getVULevel(uint8_t channel) const;
   
   void runDisplayTest();
@@ -1,11 +1,20 @@
 #include "EncoderManager.h"
+#include "UsbMidiPort.h"
 #include "Midi_Controller.h"
+#include "SurfaceProtocol.h"
 
 extern Midi_Controller midi_controller;
 
 EncoderManager::EncoderManager() 
-    : encoderAccelerationEnabled(true), currentBank(0) 
+    : encoderAccelerationEnabled(true), currentBank(0),
+      holdMask(0), pendingDawMask(0), pendingDeltaMask(0), lastDeltaFlush(0),
+      mixDirtyMask(0), dispatchDirty(true), dispatchShadowed(0)
 {
+    memset(lastLocalMove, 0, sizeof(lastLocalMove));
+    memset(pendingDawValue, 0, sizeof(pendingDawValue));
+    memset(pendingDelta, 0, sizeof(pendingDelta));
+    invalidateHighResolution();
+    
     // Initialize encoder banks with default values
     for (int bank = 0; bank < NUM_BANKS; bank++) {
         for (int enc = 0; enc < NUM_ENCODERS; enc++) {
@@ -17,14 +26,31 @@ EncoderManager::EncoderManager()
 EncoderManager::~EncoderManager() {}
 
 bool EncoderManager::initialize(AppConfig* config) {
-    Serial.println(F("Inicializando gestor de encoders..."));
+    debugSerial.println(F("Inicializando gestor de encoders..."));
     encoderAccelerationEnabled = config->encoderAcceleration;
     currentBank = config->currentBank;
+    rebuildDispatchIndex();
     return true;
 }
 
 void EncoderManager::setCurrentBank(uint8_t bank) {
+    // Los deltas pendientes pertenecen al banco saliente: enviarlos enteros
+    while (pendingDeltaMask) flushRelativeDeltas();
+    
+    // Aplicar los ecos diferidos del banco saliente antes de cambiar
+    for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+        if (pendingDawMask & (1u << i)) {
+            applyDAWValue(i, currentBank, pendingDawValue[i]);
+        }
+    }
+    holdMask = 0;
+    pendingDawMask = 0;
+    mixDirtyMask = 0xFFFF;
     currentBank = bank;
+    invalidateHighResolution();
+    
+    // Con mapeos repetidos entre bancos, el feedback va al banco visible
+    if (dispatchShadowed) dispatchDirty = true;
 }
 
 EncoderConfig EncoderManager::getEncoderConfig(uint8_t index, uint8_t bank) {
@@ -36,13 +62,15 @@ EncoderConfig EncoderManager::getEncoderConfig(uint8_t index, uint8_t bank) {
 
 EncoderConfig& EncoderManager::getEncoderConfigMutable(uint8_t index, uint8_t bank) {
     static EncoderConfig dummy;
+    dispatchDirty = true;  // El llamador puede cambiar el mapeo
     if (index < NUM_ENCODERS && bank < NUM_BANKS) {
+        if (bank == currentBank) sentMsb[index] = HIRES_UNSENT;
         return encoderBanks[bank][index];
     }
     return dummy;
 }
 
-EncoderConfig (*EncoderManager::getEncoderBanks())[NUM_BANKS] {
+EncoderConfig (*EncoderManager::getEncoderBanks())[NUM_ENCODERS] {
     return encoderBanks;
 }
 
@@ -50,44 +78,368 @@ void EncoderManager::processEncoderChange(uint8_t encoderIndex, int8_t change, u
     if (encoderIndex >= NUM_ENCODERS || bank >= NUM_BANKS) return;
     
     EncoderConfig& config = encoderBanks[bank][encoderIndex];
-    config.value = constrain(config.value + change, config.minValue, config.maxValue);
+    if (ENC_OUT_IS_HIRES(config.outputMode)) {
+        // 14 bits: value guarda los 7 altos y valueFine los 7 bajos
+        int16_t value14 = ((int16_t)config.value << 7) | (config.valueFine & 0x7F);
+        value14 = constrain(value14 + change * ENCODER_HIRES_STEP,
+                            (int16_t)config.minValue << 7, ((int16_t)config.maxValue << 7) | 0x7F);
+        config.value = value14 >> 7;
+        config.valueFine = value14 & 0x7F;
+    } else {
+        config.value = constrain(config.value + change, config.minValue, config.maxValue);
+    }
+    
+    SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+    if (surface) {
+        // Mackie/HUI: encoders 0-7 son V-Pots (relativos), 8-15 los faders
+        if (encoderIndex < SURFACE_STRIPS) {
+            pendingDelta[encoderIndex] = constrain(pendingDelta[encoderIndex] + change, -RELATIVE_CARRY_MAX, RELATIVE_CARRY_MAX);
+            pendingDeltaMask |= 1u << encoderIndex;
+        } else {
+            surface->sendFader(encoderIndex - SURFACE_STRIPS, config.value);
+        }
+    } else {
+        // Send MIDI message based on control type
+        switch (config.controlType) {
+            case CT_CC:
+                if (ENC_OUT_IS_HIRES(config.outputMode)) {
+                    sendHighResolution(encoderIndex, bank, TX_PRIO_USER, false);
+                } else if (ENC_OUT_IS_RELATIVE(config.outputMode) && bank == currentBank) {
+                    // Relativo: acumular el delta y enviarlo en el siguiente flush
+                    pendingDelta[encoderIndex] = constrain(pendingDelta[encoderIndex] + change, -RELATIVE_CARRY_MAX, RELATIVE_CARRY_MAX);
+                    pendingDeltaMask |= 1u << encoderIndex;
+                } else {
+                    midi_controller.sendControlChange(config.channel, config.control, config.value);
+                }
+                break;
+            case CT_NOTE:
+                if (change > 0) {
+                    midi_controller.sendNoteOn(config.channel, config.control, config.value);
+                } else {
+                    midi_controller.sendNoteOff(config.channel, config.control, 0);
+                }
+                break;
+            case CT_PITCH:
+                if (ENC_OUT_IS_HIRES(config.outputMode)) {
+                    midi_controller.sendPitchBend(config.channel, (((int16_t)config.value << 7) | config.valueFine) - 8192);
+                } else {
+                    midi_controller.sendPitchBend(config.channel, map(config.value, 0, 127, -8192, 8191));
+                }
+                break;
+        }
+    }
+    
+    // Mostrar la predicción local sin esperar el eco del DAW
+    if (bank == currentBank) {
+        uint16_t bit = 1u << encoderIndex;
+        config.dawValue = config.value;
+        lastLocalMove[encoderIndex] = millis();
+        holdMask |= bit;
+        pendingDawMask &= ~bit;
+    }
+}
+
+void EncoderManager::update(unsigned long currentTime) {
+    if (pendingDeltaMask && currentTime - lastDeltaFlush >= RELATIVE_FLUSH_MS) {
+        flushRelativeDeltas();
+        lastDeltaFlush = currentTime;
+    }
+    
+    if (holdMask == 0) return;
+    
+    for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+        uint16_t bit = 1u << i;
+        if (!(holdMask & bit)) continue;
+        if (currentTime - lastLocalMove[i] < appConfig.valueHoldMs) continue;
+        
+        // Fin de la retención: reconciliar con el último valor del DAW
+        holdMask &= ~bit;
+        if (pendingDawMask & bit) {
+            pendingDawMask &= ~bit;
+            applyDAWValue(i, currentBank, pendingDawValue[i]);
+        }
+    }
+}
+
+void EncoderManager::processSwitchPress(uint8_t switchIndex, uint8_t bank) {
+    if (switchIndex >= NUM_SWITCHES || bank >= NUM_BANKS) return;
+    
+    // Mackie/HUI: el DAW conmuta el estado y devuelve el LED
+    SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+    if (surface) {
+        surface->sendStripButton(switchIndex, true);
+        return;
+    }
+    
+    // Switches 0-7: Mute, 8-15: Solo del track correspondiente
+    uint8_t track = switchIndex & 0x07;
+    uint16_t bit = 1u << track;
+    bool momentary = appConfig.switchMap[switchIndex].mode == SW_MODE_MOMENTARY;
+    BankMixState next = mixState[bank];
+    
+    if (switchIndex < 8) {
+        // El mute arrastra a todos los grupos que contienen el track
+        uint16_t affected = getMuteGroupMask(track);
+        bool state = momentary || !(next.mute & bit);
+        next.mute = state ? (next.mute | affected) : (next.mute & ~affected);
+    } else {
+        bool state = momentary || !(next.solo & bit);
+        if (!state) {
+            next.solo &= ~bit;
+        } else if (appConfig.soloExclusive) {
+            next.solo = (next.solo & appConfig.soloDefeat[bank]) | bit;
+        } else {
+            next.solo |= bit;
+        }
+    }
+    
+    applyMixState(bank, next);
+}
+
+void EncoderManager::processSwitchRelease(uint8_t switchIndex, uint8_t bank) {
+    if (switchIndex >= NUM_SWITCHES || bank >= NUM_BANKS) return;
+    
+    SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+    if (surface) {
+        surface->sendStripButton(switchIndex, false);
+        return;
+    }
+    
+    // Solo los switches momentáneos reaccionan al soltar
+    if (appConfig.switchMap[switchIndex].mode != SW_MODE_MOMENTARY) return;
+    
+    uint8_t track = switchIndex & 0x07;
+    BankMixState next = mixState[bank];
+    if (switchIndex < 8) {
+        next.mute &= ~getMuteGroupMask(track);
+    } else {
+        next.solo &= ~(1u << track);
+    }
+    
+    applyMixState(bank, next);
+}
+
+void EncoderManager::applyMixState(uint8_t bank, const BankMixState& newState) {
+    if (bank >= NUM_BANKS) return;
+    
+    BankMixState& current = mixState[bank];
+    uint16_t muteChanged = current.mute ^ newState.mute;
+    uint16_t soloChanged = current.solo ^ newState.solo;
+    if (!(muteChanged | soloChanged)) return;
+    
+    current = newState;
+    
+    // Emitir en bloque los mensajes de todos los tracks con switch modificados
+    uint16_t pending = (muteChanged | soloChanged) & 0xFF;
+    for (uint8_t track = 0; pending; track++, pending >>= 1) {
+        if (!(pending & 1)) continue;
+        uint16_t bit = 1u << track;
+        if (muteChanged & bit) sendSwitchMessage(track, bank, newState.mute & bit);
+        if (soloChanged & bit) sendSwitchMessage(track + 8, bank, newState.solo & bit);
+    }
+    
+    // Un cambio de solo altera el mute implícito de todo el banco
+    if (bank == currentBank) {
+        mixDirtyMask |= soloChanged ? 0xFFFF : muteChanged;
+    }
+}
+
+uint16_t EncoderManager::getMuteGroupMask(uint8_t track) const {
+    uint16_t bit = 1u << track;
+    uint16_t mask = bit;
+    for (uint8_t g = 0; g < NUM_MUTE_GROUPS; g++) {
+        if (appConfig.muteGroups[g] & bit) mask |= appConfig.muteGroups[g];
+    }
+    return mask;
+}
+
+uint16_t EncoderManager::getImpliedMuteMask(uint8_t bank) const {
+    // Con algún solo activo, los tracks sin solo ni solo-defeat quedan silenciados
+    const BankMixState& state = mixState[bank % NUM_BANKS];
+    if (!state.solo) return 0;
+    return ~(state.solo | appConfig.soloDefeat[bank % NUM_BANKS]);
+}
+
+uint16_t EncoderManager::takeMixDirtyMask() {
+    uint16_t mask = mixDirtyMask;
+    mixDirtyMask = 0;
+    return mask;
+}
+
+void EncoderManager::pushTrackState(uint8_t track, uint8_t bank) {
+    if (track >= NUM_ENCODERS || bank >= NUM_BANKS) return;
     
-    // Send MIDI message based on control type
+    // Valor absoluto actual; los modos relativos no pueden expresarlo
+    const EncoderConfig& config = encoderBanks[bank][track];
     switch (config.controlType) {
         case CT_CC:
-            midi_controller.sendControlChange(config.channel, config.control, config.value);
+            if (config.outputMode == ENC_OUT_ABSOLUTE) {
+                midi_controller.sendControlChange(config.channel, config.control, config.value, TX_PRIO_FEEDBACK);
+            } else if (ENC_OUT_IS_HIRES(config.outputMode)) {
+                sendHighResolution(track, bank, TX_PRIO_FEEDBACK, true);
+            }
             break;
         case CT_NOTE:
-            if (change > 0) {
-                midi_controller.sendNoteOn(config.channel, config.control, config.value);
+            midi_controller.sendNoteOn(config.channel, config.control, config.value, TX_PRIO_FEEDBACK);
+            break;
+        case CT_PITCH:
+            midi_controller.sendPitchBend(config.channel, map(config.value, 0, 127, -8192, 8191), TX_PRIO_FEEDBACK);
+            break;
+    }
+    
+    // Mute/Solo: solo los 8 primeros tracks tienen switch
+    if (track < 8) {
+        uint16_t bit = 1u << track;
+        sendSwitchMessage(track, bank, mixState[bank].mute & bit, TX_PRIO_FEEDBACK);
+        sendSwitchMessage(track + 8, bank, mixState[bank].solo & bit, TX_PRIO_FEEDBACK);
+    }
+}
+
+bool EncoderManager::pushesTrackValue(uint8_t track, uint8_t bank) const {
+    if (track >= NUM_ENCODERS || bank >= NUM_BANKS) return false;
+    const EncoderConfig& config = encoderBanks[bank][track];
+    return !(config.controlType == CT_CC && ENC_OUT_IS_RELATIVE(config.outputMode));
+}
+
+uint8_t EncoderManager::getPushTrackBytes(uint8_t track, uint8_t bank) const {
+    if (track >= NUM_ENCODERS || bank >= NUM_BANKS) return 0;
+
+    // Peor caso de pushTrackState, sin contar running status
+    const EncoderConfig& config = encoderBanks[bank][track];
+    uint8_t bytes = 0;
+    if (pushesTrackValue(track, bank)) {
+        if (config.controlType != CT_CC || config.outputMode == ENC_OUT_ABSOLUTE) {
+            bytes = 3;
+        } else if (config.outputMode == ENC_OUT_HIRES_NRPN) {
+            bytes = 12;                                          // CC 99, 98, 6 y 38
+        } else {
+            bytes = (config.control < HIRES_LSB_OFFSET) ? 6 : 3; // MSB (+ LSB)
+        }
+    }
+
+    if (track < 8) {
+        bytes += getSwitchMessageBytes(track) + getSwitchMessageBytes(track + 8);
+    }
+    return bytes;
+}
+
+void EncoderManager::sendSwitchMessage(uint8_t switchIndex, uint8_t bank, bool state, uint8_t priority) {
+    const SwitchMapping& mapping = appConfig.switchMap[switchIndex];
+    uint8_t value = state ? mapping.onValue : mapping.offValue;
+    
+    switch (mapping.messageType) {
+        case SW_MSG_NOTE:
+            if (state) {
+                midi_controller.sendNoteOn(mapping.channel, mapping.number, value, priority);
             } else {
-                midi_controller.sendNoteOff(config.channel, config.control, 0);
+                midi_controller.sendNoteOff(mapping.channel, mapping.number, value, priority);
             }
             break;
-        case CT_PITCH:
-            midi_controller.sendPitchBend(config.channel, map(config.value, 0, 127, -8192, 8191));
+        case SW_MSG_CC:
+            midi_controller.sendControlChange(mapping.channel, mapping.number, value, priority);
+            break;
+        case SW_MSG_SYSEX:
+            midi_controller.sendStudioOneSwitchState(mapping.number, bank, value);
             break;
     }
 }
 
-void EncoderManager::processSwitchPress(uint8_t switchIndex, uint8_t bank) {
-    // Handle mute/solo switches
-    if (switchIndex < 8) {
-        // Mute switches
-        uint8_t track = switchIndex;
-        if (track < NUM_ENCODERS && bank < NUM_BANKS) {
-            encoderBanks[bank][track].isMute = !encoderBanks[bank][track].isMute;
-            // Send MIDI mute command (CC 120-127 are typically used for mutes)
-            midi_controller.sendControlChange(encoderBanks[bank][track].channel, 120 + track, encoderBanks[bank][track].isMute ? 127 : 0);
+uint8_t EncoderManager::getSwitchMessageBytes(uint8_t switchIndex) const {
+    // Switch State: F0 00 21 7B 06 función banco estado F7
+    return (appConfig.switchMap[switchIndex].messageType == SW_MSG_SYSEX) ? 9 : 3;
+}
+
+void EncoderManager::flushRelativeDeltas() {
+    uint16_t carryMask = 0;
+    for (uint8_t i = 0; pendingDeltaMask; i++) {
+        uint16_t bit = 1u << i;
+        if (!(pendingDeltaMask & bit)) continue;
+        pendingDeltaMask &= ~bit;
+        
+        // Cada mensaje lleva como mucho lo que admite el formato; el resto
+        // queda pendiente para el siguiente flush en vez de perderse
+        const EncoderConfig& config = encoderBanks[currentBank][i];
+        SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+        int8_t limit = surface ? 63 : relativeStepLimit(config.outputMode);
+        int8_t step = constrain(pendingDelta[i], -limit, limit);
+        if (step == 0) {
+            // Nada que enviar
+        } else if (surface) {
+            surface->sendVPot(i, step);
+        } else {
+            midi_controller.sendControlChange(config.channel, config.control,
+                                              encodeRelative(config.outputMode, step),
+                                              TX_PRIO_USER | TX_NO_COALESCE);
+        }
+        pendingDelta[i] -= step;
+        if (pendingDelta[i]) carryMask |= bit;
+    }
+    pendingDeltaMask = carryMask;
+}
+
+void EncoderManager::sendHighResolution(uint8_t track, uint8_t bank, uint8_t priority, bool force) {
+    const EncoderConfig& config = encoderBanks[bank][track];
+    uint8_t msb = config.value & 0x7F;
+    uint8_t lsb = config.valueFine & 0x7F;
+    priority |= TX_NO_COALESCE;  // El orden MSB -> LSB debe llegar intacto
+    
+    // Solo se envían los bytes que cambiaron. Un MSB nuevo pone a cero el LSB
+    // en el receptor, así que obliga a reenviar también el LSB.
+    bool visible = (bank == currentBank);
+    bool msbChanged = force || !visible || msb != sentMsb[track];
+    bool lsbChanged = msbChanged || lsb != sentLsb[track];
+    
+    if (config.outputMode == ENC_OUT_HIRES_NRPN) {
+        uint8_t channelIndex = (config.channel - 1) & 0x0F;
+        if (force || nrpnSelected[channelIndex] != config.control) {
+            midi_controller.sendControlChange(config.channel, NRPN_PARAM_MSB, 0, priority);
+            midi_controller.sendControlChange(config.channel, NRPN_PARAM_LSB, config.control, priority);
+            nrpnSelected[channelIndex] = config.control;
+        }
+        if (msbChanged) midi_controller.sendControlChange(config.channel, NRPN_DATA_MSB, msb, priority);
+        if (lsbChanged) midi_controller.sendControlChange(config.channel, NRPN_DATA_LSB, lsb, priority);
+    } else {
+        if (msbChanged) midi_controller.sendControlChange(config.channel, config.control, msb, priority);
+        // Los CC 32-63 son los LSB de 0-31: por encima solo hay MSB
+        if (lsbChanged && config.control < HIRES_LSB_OFFSET) {
+            midi_controller.sendControlChange(config.channel, config.control + HIRES_LSB_OFFSET, lsb, priority);
+        }
+    }
+    
+    if (visible) {
+        sentMsb[track] = msb;
+        sentLsb[track] = lsb;
+    }
+}
+
+void EncoderManager::invalidateHighResolution() {
+    memset(sentMsb, HIRES_UNSENT, sizeof(sentMsb));
+    memset(sentLsb, HIRES_UNSENT, sizeof(sentLsb));
+    memset(nrpnSelected, HIRES_UNSENT, sizeof(nrpnSelected));
+}
+
+int8_t EncoderManager::relativeStepLimit(uint8_t mode) {
+    // Pasos máximos que caben en un mensaje (simétrico en los dos sentidos)
+    return (mode == ENC_OUT_REL_MACKIE) ? 15 : 63;
+}
+
+uint8_t EncoderManager::encodeRelative(uint8_t mode, int8_t delta) {
+    switch (mode) {
+        case ENC_OUT_REL_TWOS:
+            return (uint8_t)constrain(delta, -64, 63) & 0x7F;
+        case ENC_OUT_REL_OFFSET:
+            return 64 + constrain(delta, -64, 63);
+        case ENC_OUT_REL_SIGNMAG: {
+            uint8_t magnitude = constrain(abs(delta), 0, 63);
+            return (delta < 0) ? (0x40 | magnitude) : magnitude;
         }
-    } else if (switchIndex < 16) {
-        // Solo switches
-        uint8_t track = switchIndex - 8;
-        if (track < NUM_ENCODERS && bank < NUM_BANKS) {
-            encoderBanks[bank][track].isSolo = !encoderBanks[bank][track].isSolo;
-            // Send MIDI solo command
-            midi_controller.sendControlChange(encoderBanks[bank][track].channel, 110 + track, encoderBanks[bank][track].isSolo ? 127 : 0);
+        case ENC_OUT_REL_MACKIE: {
+            // V-Pot: bit 6 = sentido antihorario, bits 0-3 = pasos
+            uint8_t ticks = constrain(abs(delta), 1, 15);
+            return (delta < 0) ? (0x40 | ticks) : ticks;
         }
+        default:
+            return 0;
     }
 }
 
@@ -100,9 +452,34 @@ void EncoderManager::syncFromDAW(uint8_t track, uint8_t bank, uint8_t value, uin
 }
 
 void EncoderManager::setEncoderDAWValue(uint8_t track, uint8_t bank, uint8_t value) {
-    if (track < NUM_ENCODERS && bank < NUM_BANKS) {
-        encoderBanks[bank][track].dawValue = value;
+    if (track >= NUM_ENCODERS || bank >= NUM_BANKS) return;
+    
+    // Durante la retención el eco se guarda para evitar saltos en pantalla
+    uint16_t bit = 1u << track;
+    if (bank == currentBank && (holdMask & bit)) {
+        if (millis() - lastLocalMove[track] < appConfig.valueHoldMs) {
+            pendingDawValue[track] = value;
+            pendingDawMask |= bit;
+            return;
+        }
+        holdMask &= ~bit;
+        pendingDawMask &= ~bit;
     }
+    
+    applyDAWValue(track, bank, value);
+}
+
+void EncoderManager::applyDAWValue(uint8_t track, uint8_t bank, uint8_t value) {
+    // El DAW es la referencia: el valor local adopta el valor confirmado
+    EncoderConfig& config = encoderBanks[bank][track];
+    config.dawValue = value;
+    int8_t newValue = constrain((int8_t)value, config.minValue, config.maxValue);
+    if (newValue != config.value) {
+        // El DAW solo informa de los 7 bits altos: la parte fina local ya no vale
+        config.valueFine = 0;
+        if (bank == currentBank) sentMsb[track] = HIRES_UNSENT;
+    }
+    config.value = newValue;
 }
 
 uint8_t EncoderManager::getEncoderDAWValue(uint8_t track, uint8_t bank) {
@@ -114,15 +491,55 @@ uint8_t EncoderManager::getEncoderDAWValue(uint8_t track, uint8_t bank) {
 
 void EncoderManager::syncNameFromDAW(uint8_t track, uint8_t bank, const char* name) {
      if (track < NUM_ENCODERS && bank < NUM_BANKS && name) {
-    // Copiar máximo 5 caracteres + null terminator
-        strncpy(encoderBanks[bank][track].trackName, name, 5);
-        encoderBanks[bank][track].trackName[5] = '\0';
+    // Copiar como máximo TRACK_NAME_SIZE - 1 caracteres + terminador
+        strncpy(encoderBanks[bank][track].trackName, name, TRACK_NAME_SIZE - 1);
+        encoderBanks[bank][track].trackName[TRACK_NAME_SIZE - 1] = '\0';
+    }
+}
+
+void EncoderManager::setTrackNameChar(uint8_t track, uint8_t bank, uint8_t position, char c) {
+    if (track >= NUM_ENCODERS || bank >= NUM_BANKS || position >= TRACK_NAME_SIZE - 1) return;
+    // El LCD Mackie rellena con espacios: se recortan al mostrar
+    encoderBanks[bank][track].trackName[position] = (c >= 0x20 && c < 0x7F) ? c : ' ';
+    encoderBanks[bank][track].trackName[TRACK_NAME_SIZE - 1] = '\0';
+}
+
+void EncoderManager::syncMixBitFromDAW(uint8_t bank, uint8_t track, bool isSolo, bool state) {
+    if (bank >= NUM_BANKS) return;
+    
+    uint16_t bit = 1u << (track & 0x07);
+    const BankMixState& current = mixState[bank];
+    uint16_t mute = current.mute;
+    uint16_t solo = current.solo;
+    if (isSolo) {
+        solo = state ? (solo | bit) : (solo & ~bit);
+    } else {
+        mute = state ? (mute | bit) : (mute & ~bit);
+    }
+    syncMixFromDAW(bank, bit, mute, solo);
+}
+
+void EncoderManager::syncMixFromDAW(uint8_t bank, uint16_t rangeMask, uint16_t mute, uint16_t solo) {
+    if (bank >= NUM_BANKS) return;
+    
+    // Estado confirmado por el DAW: se actualiza sin reenviar mensajes
+    BankMixState& current = mixState[bank];
+    uint16_t newMute = (current.mute & ~rangeMask) | (mute & rangeMask);
+    uint16_t newSolo = (current.solo & ~rangeMask) | (solo & rangeMask);
+    uint16_t muteChanged = current.mute ^ newMute;
+    uint16_t soloChanged = current.solo ^ newSolo;
+    current.mute = newMute;
+    current.solo = newSolo;
+    
+    if (bank == currentBank) {
+        mixDirtyMask |= soloChanged ? 0xFFFF : muteChanged;
     }
 }
 
 void EncoderManager::resetEncoderConfig(uint8_t index, uint8_t bank) {
     if (index < NUM_ENCODERS && bank < NUM_BANKS) {
         encoderBanks[bank][index] = EncoderConfig();
+        dispatchDirty = true;
     }
 }
 
@@ -131,7 +548,113 @@ void EncoderManager::resetAllBanks() {
         for (int enc = 0; enc < NUM_ENCODERS; enc++) {
             encoderBanks[bank][enc] = EncoderConfig();
         }
+        mixState[bank] = BankMixState();
+    }
+    mixDirtyMask = 0xFFFF;
+    dispatchDirty = true;
+}
+
+void EncoderManager::dispatchDAWMessage(uint8_t channel, uint8_t type, uint8_t number, uint8_t value) {
+    if (dispatchDirty) rebuildDispatchIndex();
+    
+    // Sondeo lineal: una entrada vacía termina la cadena. Se recorren todas
+    // las coincidencias porque un encoder y un switch pueden compartir mapeo
+    // (entre encoders solo hay uno por clave).
+    uint8_t slot = dispatchHash(channel, type, number);
+    for (uint8_t probes = 0; probes < DISPATCH_TABLE_SIZE; probes++) {
+        uint8_t target = dispatchTable[slot];
+        if (target == DISPATCH_EMPTY) return;
+        
+        uint8_t keyChannel, keyType, keyNumber;
+        if (getDispatchKey(target, keyChannel, keyType, keyNumber) &&
+            keyChannel == channel && keyType == type && keyNumber == number) {
+            applyDispatchTarget(target, type, value);
+        }
+        slot = (slot + 1) & (DISPATCH_TABLE_SIZE - 1);
+    }
+}
+
+void EncoderManager::applyDispatchTarget(uint8_t target, uint8_t type, uint8_t value) {
+    if (target < NUM_BANKS * NUM_ENCODERS) {
+        setEncoderDAWValue(target % NUM_ENCODERS, target / NUM_ENCODERS, value);
+        return;
+    }
+    
+    // Switches: 0-7 Mute, 8-15 Solo del track correspondiente en el banco visible
+    uint8_t switchIndex = target - NUM_BANKS * NUM_ENCODERS;
+    const SwitchMapping& mapping = appConfig.switchMap[switchIndex];
+    bool state;
+    if (value == mapping.onValue) {
+        state = true;
+    } else if (value == mapping.offValue) {
+        state = false;
+    } else {
+        state = value >= 64;
+    }
+    
+    syncMixBitFromDAW(currentBank, switchIndex & 0x07, switchIndex >= 8, state);
+}
+
+void EncoderManager::rebuildDispatchIndex() {
+    const uint8_t encoderTargets = NUM_BANKS * NUM_ENCODERS;
+    uint8_t shadowed = 0;
+    memset(dispatchTable, DISPATCH_EMPTY, sizeof(dispatchTable));
+    
+    // Banco visible primero: si varios encoders comparten mapeo (la
+    // configuración por defecto es CC7 en todos) solo se indexa uno, así un
+    // CC entrante actualiza un único encoder y las cadenas no crecen
+    for (uint8_t i = 0; i < DISPATCH_TARGETS; i++) {
+        uint8_t target = (i < encoderTargets) ? (i + currentBank * NUM_ENCODERS) % encoderTargets : i;
+        uint8_t channel, type, number;
+        if (!getDispatchKey(target, channel, type, number)) continue;
+        
+        uint8_t slot = dispatchHash(channel, type, number);
+        bool duplicate = false;
+        while (dispatchTable[slot] != DISPATCH_EMPTY) {
+            uint8_t other = dispatchTable[slot];
+            uint8_t otherChannel, otherType, otherNumber;
+            if (target < encoderTargets && other < encoderTargets &&
+                getDispatchKey(other, otherChannel, otherType, otherNumber) &&
+                otherChannel == channel && otherType == type && otherNumber == number) {
+                duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & (DISPATCH_TABLE_SIZE - 1);
+        }
+        if (duplicate) {
+            shadowed++;
+            continue;
+        }
+        dispatchTable[slot] = target;
     }
+    
+    if (shadowed != dispatchShadowed) {
+        debugSerial.print(F("Feedback MIDI: encoders con mapeo repetido: "));
+        debugSerial.println(shadowed);
+    }
+    dispatchShadowed = shadowed;
+    dispatchDirty = false;
+}
+
+bool EncoderManager::getDispatchKey(uint8_t target, uint8_t& channel, uint8_t& type, uint8_t& number) const {
+    if (target < NUM_BANKS * NUM_ENCODERS) {
+        const EncoderConfig& config = encoderBanks[target / NUM_ENCODERS][target % NUM_ENCODERS];
+        channel = config.channel;
+        type = config.controlType;
+        number = (type == CT_PITCH) ? 0 : config.control;
+        return true;
+    }
+    
+    const SwitchMapping& mapping = appConfig.switchMap[target - NUM_BANKS * NUM_ENCODERS];
+    if (mapping.messageType == SW_MSG_SYSEX) return false;
+    channel = mapping.channel;
+    type = (mapping.messageType == SW_MSG_NOTE) ? CT_NOTE : CT_CC;
+    number = mapping.number;
+    return true;
+}
+
+uint8_t EncoderManager::dispatchHash(uint8_t channel, uint8_t type, uint8_t number) {
+    return (uint8_t)(number * 5 + channel * 17 + type * 37) & (DISPATCH_TABLE_SIZE - 1);
 }
 
 bool EncoderManager::getEncoderAcceleration() const {
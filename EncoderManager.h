@@ -2,14 +2,72 @@
 #define ENCODER_MANAGER_H
 
 #include "Config.h"
+#include "MidiTxQueue.h"
+
+// Índice inverso (canal, tipo, número) -> destino para el feedback del DAW.
+// Cada entrada guarda solo el destino; la clave se comprueba contra su mapeo.
+#define DISPATCH_TABLE_SIZE   128   // Potencia de 2, mayor que DISPATCH_TARGETS
+#define DISPATCH_EMPTY        0xFF
+#define DISPATCH_TARGETS      (NUM_BANKS * NUM_ENCODERS + NUM_SWITCHES)
+
+// Controladores de la salida de 14 bits
+#define HIRES_LSB_OFFSET      32    // CC n (MSB) / CC n+32 (LSB)
+#define NRPN_PARAM_MSB        99
+#define NRPN_PARAM_LSB        98
+#define NRPN_DATA_MSB         6
+#define NRPN_DATA_LSB         38
+#define HIRES_UNSENT          0xFF  // Fuerza el envío del byte
+
+#if DISPATCH_TARGETS >= DISPATCH_TABLE_SIZE
+#error "DISPATCH_TABLE_SIZE debe ser mayor que el número de destinos"
+#endif
 #include <Arduino.h>
 
 class EncoderManager {
 private:
-    EncoderConfig encoderBanks[NUM_ENCODERS][NUM_BANKS];
+    EncoderConfig encoderBanks[NUM_BANKS][NUM_ENCODERS];
     bool encoderAccelerationEnabled;
     uint8_t currentBank;
     
+    // Predicción local del banco visible (reconciliada con el eco del DAW)
+    uint16_t holdMask;                          // Encoders con valor local retenido
+    uint16_t pendingDawMask;                    // Ecos del DAW diferidos durante la retención
+    unsigned long lastLocalMove[NUM_ENCODERS];
+    int8_t pendingDawValue[NUM_ENCODERS];
+    
+    // Deltas acumulados de encoders en modo relativo (banco visible)
+    int16_t pendingDelta[NUM_ENCODERS];
+    uint16_t pendingDeltaMask;
+    unsigned long lastDeltaFlush;
+    
+    // Últimos bytes de 14 bits enviados (banco visible) y NRPN activo por canal
+    uint8_t sentMsb[NUM_ENCODERS];
+    uint8_t sentLsb[NUM_ENCODERS];
+    uint8_t nrpnSelected[16];
+    
+    // Estado Mute/Solo por banco (bitmasks)
+    BankMixState mixState[NUM_BANKS];
+    uint16_t mixDirtyMask;                      // Tracks del banco visible pendientes de redibujar
+    
+    // Índice inverso para el feedback entrante
+    uint8_t dispatchTable[DISPATCH_TABLE_SIZE];
+    bool dispatchDirty;
+    uint8_t dispatchShadowed;                   // Encoders tapados por otro con el mismo mapeo
+    
+    void applyDAWValue(uint8_t track, uint8_t bank, uint8_t value);
+    void sendSwitchMessage(uint8_t switchIndex, uint8_t bank, bool state, uint8_t priority = TX_PRIO_USER);
+    uint8_t getSwitchMessageBytes(uint8_t switchIndex) const;
+    uint16_t getMuteGroupMask(uint8_t track) const;
+    void flushRelativeDeltas();
+    static uint8_t encodeRelative(uint8_t mode, int8_t delta);
+    static int8_t relativeStepLimit(uint8_t mode);
+    void sendHighResolution(uint8_t track, uint8_t bank, uint8_t priority, bool force);
+    void invalidateHighResolution();
+    void rebuildDispatchIndex();
+    bool getDispatchKey(uint8_t target, uint8_t& channel, uint8_t& type, uint8_t& number) const;
+    static uint8_t dispatchHash(uint8_t channel, uint8_t type, uint8_t number);
+    void applyDispatchTarget(uint8_t target, uint8_t type, uint8_t value);
+    
 public:
     EncoderManager();
     ~EncoderManager();
@@ -20,17 +78,38 @@ public:
     // Configuration access
     EncoderConfig getEncoderConfig(uint8_t index, uint8_t bank);
     EncoderConfig& getEncoderConfigMutable(uint8_t index, uint8_t bank);
-    EncoderConfig (*getEncoderBanks())[NUM_BANKS];
+    EncoderConfig (*getEncoderBanks())[NUM_ENCODERS];
     
     // Processing
     void processEncoderChange(uint8_t encoderIndex, int8_t change, uint8_t bank);
     void processSwitchPress(uint8_t switchIndex, uint8_t bank);
+    void processSwitchRelease(uint8_t switchIndex, uint8_t bank);
+    void update(unsigned long currentTime);
+    
+    // Mute/Solo
+    void applyMixState(uint8_t bank, const BankMixState& newState);
+    const BankMixState& getMixState(uint8_t bank) const { return mixState[bank % NUM_BANKS]; }
+    uint16_t getImpliedMuteMask(uint8_t bank) const;
+    uint16_t takeMixDirtyMask();
+    
+    // Volcado del estado de la superficie al DAW
+    void pushTrackState(uint8_t track, uint8_t bank);
+    bool pushesTrackValue(uint8_t track, uint8_t bank) const;   // Falso en modos relativos
+    uint8_t getPushTrackBytes(uint8_t track, uint8_t bank) const; // Bytes que pondrá en el cable
     
     // DAW synchronization
     void syncFromDAW(uint8_t track, uint8_t bank, uint8_t value, uint16_t color);
     void setEncoderDAWValue(uint8_t track, uint8_t bank, uint8_t value);
     uint8_t getEncoderDAWValue(uint8_t track, uint8_t bank);
     void syncNameFromDAW(uint8_t track, uint8_t bank, const char* name);
+    void syncMixFromDAW(uint8_t bank, uint16_t rangeMask, uint16_t mute, uint16_t solo);
+    void syncMixBitFromDAW(uint8_t bank, uint8_t track, bool isSolo, bool state);
+    void setTrackNameChar(uint8_t track, uint8_t bank, uint8_t position, char c);
+    
+    // Feedback CC/Note/Pitch del DAW (type: ControlType; Pitch en 0-127)
+    void dispatchDAWMessage(uint8_t channel, uint8_t type, uint8_t number, uint8_t value);
+    void invalidateDispatchIndex() { dispatchDirty = true; }
+    uint8_t getDispatchShadowed() const { return dispatchShadowed; }
     
     // Configuration management
     void resetEncoderConfig(uint8_t index, uint8_t bank);
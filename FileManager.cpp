@@ -1,4 +1,5 @@
 #include "FileManager.h"
+#include "UsbMidiPort.h"
 
 FileManager::FileManager() 
   : sdInitialized(false), sdCardPresent(false), totalSpace(0), freeSpace(0),
@@ -17,7 +18,7 @@ FileManager::FileManager()
 FileManager::~FileManager() {}
 
 bool FileManager::initialize() {
-  Serial.println(F("Inicializando sistema de archivos SD..."));
+  debugSerial.println(F("Inicializando sistema de archivos SD..."));
   
   SPI.begin();
   
@@ -28,24 +29,24 @@ bool FileManager::initialize() {
       break;
     }
     delay(100);
-    Serial.print(F("Reintento SD: "));
-    Serial.println(retry + 1);
+    debugSerial.print(F("Reintento SD: "));
+    debugSerial.println(retry + 1);
   }
   
   if (!sdInitialized) {
-    Serial.println(F("ERROR: No se pudo inicializar tarjeta SD"));
+    debugSerial.println(F("ERROR: No se pudo inicializar tarjeta SD"));
     return false;
   }
   
   if (!validateSDCard() || !initializeDirectories()) {
-    Serial.println(F("ERROR: Validación de SD falló"));
+    debugSerial.println(F("ERROR: Validación de SD falló"));
     return false;
   }
   
   updateSpaceInfo();
-  Serial.print(F("SD inicializada - Espacio total: "));
-  Serial.print(totalSpace / 1024);
-  Serial.println(F(" KB"));
+  debugSerial.print(F("SD inicializada - Espacio total: "));
+  debugSerial.print(totalSpace / 1024);
+  debugSerial.println(F(" KB"));
   
   return true;
 }
@@ -81,16 +82,16 @@ bool FileManager::initializeDirectories() {
   
   for (int i = 0; i < 3; i++) {
     if (!createDirectory(dirs[i])) {
-      Serial.print(F("ADVERTENCIA: No se pudo crear directorio "));
-      Serial.println(dirs[i]);
+      debugSerial.print(F("ADVERTENCIA: No se pudo crear directorio "));
+      debugSerial.println(dirs[i]);
     }
   }
   
   return true;
 }
 
-bool FileManager::saveConfiguration(const AppConfig& config, const EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]) {
-  Serial.println(F("Guardando configuración..."));
+bool FileManager::saveConfiguration(const AppConfig& config, const EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]) {
+  debugSerial.println(F("Guardando configuración..."));
   
   if (fileExists(CONFIG_FILENAME)) {
     createBackup(CONFIG_FILENAME);
@@ -129,7 +130,7 @@ bool FileManager::saveConfiguration(const AppConfig& config, const EncoderConfig
   filesWritten++;
   
   if (!verifyFileIntegrity(CONFIG_FILENAME)) {
-    Serial.println(F("ERROR: Verificación de integridad falló"));
+    debugSerial.println(F("ERROR: Verificación de integridad falló"));
     restoreFromBackup(CONFIG_FILENAME);
     return false;
   }
@@ -138,16 +139,16 @@ bool FileManager::saveConfiguration(const AppConfig& config, const EncoderConfig
   return true;
 }
 
-bool FileManager::loadConfiguration(AppConfig& config, EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]) {
-  Serial.println(F("Cargando configuración..."));
+bool FileManager::loadConfiguration(AppConfig& config, EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]) {
+  debugSerial.println(F("Cargando configuración..."));
   
   if (!fileExists(CONFIG_FILENAME)) {
-    Serial.println(F("Archivo de configuración no existe"));
+    debugSerial.println(F("Archivo de configuración no existe"));
     return false;
   }
   
   if (!verifyFileIntegrity(CONFIG_FILENAME)) {
-    Serial.println(F("Archivo corrupto, intentando restaurar desde backup"));
+    debugSerial.println(F("Archivo corrupto, intentando restaurar desde backup"));
     if (!restoreFromBackup(CONFIG_FILENAME)) {
       return false;
     }
@@ -166,8 +167,10 @@ bool FileManager::loadConfiguration(AppConfig& config, EncoderConfig encoders[NU
     return false;
   }
   
-  if (header.version != CONFIG_VERSION) {
-    Serial.println(F("Versión de configuración incompatible"));
+  size_t encoderDataSize = sizeof(EncoderConfig) * NUM_ENCODERS * NUM_BANKS;
+  if (header.version != CONFIG_VERSION ||
+      header.dataSize != sizeof(AppConfig) + encoderDataSize) {
+    debugSerial.println(F("Versión de configuración incompatible"));
     configFile.close();
     return false;
   }
@@ -178,7 +181,6 @@ bool FileManager::loadConfiguration(AppConfig& config, EncoderConfig encoders[NU
     return false;
   }
   
-  size_t encoderDataSize = sizeof(EncoderConfig) * NUM_ENCODERS * NUM_BANKS;
   if (configFile.read((uint8_t*)encoders, encoderDataSize) != encoderDataSize) {
     configFile.close();
     logError("read encoder config");
@@ -192,7 +194,7 @@ bool FileManager::loadConfiguration(AppConfig& config, EncoderConfig encoders[NU
 }
 
 bool FileManager::resetConfiguration() {
-  Serial.println(F("Reseteando configuración..."));
+  debugSerial.println(F("Reseteando configuración..."));
   
   if (fileExists(CONFIG_FILENAME)) {
     createBackup(CONFIG_FILENAME);
@@ -201,7 +203,7 @@ bool FileManager::resetConfiguration() {
   bool success = deleteFile(CONFIG_FILENAME);
   
   if (success) {
-    Serial.println(F("Configuración reseteada"));
+    debugSerial.println(F("Configuración reseteada"));
     logSuccess("reset configuration");
   } else {
     logError("reset configuration");
@@ -210,7 +212,7 @@ bool FileManager::resetConfiguration() {
   return success;
 }
 
-bool FileManager::savePreset(const char* presetName, const EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]) {
+bool FileManager::savePreset(const char* presetName, const EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]) {
   if (!isValidPresetName(presetName)) {
     logError("invalid preset name");
     return false;
@@ -245,14 +247,14 @@ bool FileManager::savePreset(const char* presetName, const EncoderConfig encoder
   presetFile.close();
   filesWritten++;
   
-  Serial.print(F("Preset '"));
-  Serial.print(presetName);
-  Serial.println(F("' guardado"));
+  debugSerial.print(F("Preset '"));
+  debugSerial.print(presetName);
+  debugSerial.println(F("' guardado"));
   
   return true;
 }
 
-bool FileManager::loadPreset(const char* presetName, EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]) {
+bool FileManager::loadPreset(const char* presetName, EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]) {
   if (!isValidPresetName(presetName)) {
     return false;
   }
@@ -260,9 +262,9 @@ bool FileManager::loadPreset(const char* presetName, EncoderConfig encoders[NUM_
   snprintf(pathBuffer, sizeof(pathBuffer), "%s/%s.pre", PRESET_DIRECTORY, presetName);
   
   if (!fileExists(pathBuffer)) {
-    Serial.print(F("Preset '"));
-    Serial.print(presetName);
-    Serial.println(F("' no existe"));
+    debugSerial.print(F("Preset '"));
+    debugSerial.print(presetName);
+    debugSerial.println(F("' no existe"));
     return false;
   }
   
@@ -278,8 +280,15 @@ bool FileManager::loadPreset(const char* presetName, EncoderConfig encoders[NUM_
     logError("read preset header");
     return false;
   }
-  
+
+  // Un preset de otra versión tiene otro layout de EncoderConfig
   size_t dataSize = sizeof(EncoderConfig) * NUM_ENCODERS * NUM_BANKS;
+  if (header.version != CONFIG_VERSION || header.dataSize != dataSize) {
+    debugSerial.println(F("Versión de preset incompatible"));
+    presetFile.close();
+    return false;
+  }
+
   if (presetFile.read((uint8_t*)encoders, dataSize) != dataSize) {
     presetFile.close();
     logError("read preset data");
@@ -289,9 +298,9 @@ bool FileManager::loadPreset(const char* presetName, EncoderConfig encoders[NUM_
   presetFile.close();
   filesRead++;
   
-  Serial.print(F("Preset '"));
-  Serial.print(presetName);
-  Serial.println(F("' cargado"));
+  debugSerial.print(F("Preset '"));
+  debugSerial.print(presetName);
+  debugSerial.println(F("' cargado"));
   
   return true;
 }
@@ -304,16 +313,16 @@ bool FileManager::deletePreset(const char* presetName) {
   snprintf(pathBuffer, sizeof(pathBuffer), "%s/%s.pre", PRESET_DIRECTORY, presetName);
   
   if (!fileExists(pathBuffer)) {
-    Serial.print(F("Preset '"));
-    Serial.print(presetName);
-    Serial.println(F("' no existe"));
+    debugSerial.print(F("Preset '"));
+    debugSerial.print(presetName);
+    debugSerial.println(F("' no existe"));
     return false;
   }
   
   if (deleteFile(pathBuffer)) {
-    Serial.print(F("Preset '"));
-    Serial.print(presetName);
-    Serial.println(F("' eliminado"));
+    debugSerial.print(F("Preset '"));
+    debugSerial.print(presetName);
+    debugSerial.println(F("' eliminado"));
     return true;
   }
   
@@ -331,21 +340,21 @@ bool FileManager::renamePreset(const char* oldName, const char* newName) {
   snprintf(newPath, sizeof(newPath), "%s/%s.pre", PRESET_DIRECTORY, newName);
   
   if (!fileExists(oldPath)) {
-    Serial.print(F("Preset origen '"));
-    Serial.print(oldName);
-    Serial.println(F("' no existe"));
+    debugSerial.print(F("Preset origen '"));
+    debugSerial.print(oldName);
+    debugSerial.println(F("' no existe"));
     return false;
   }
   
   if (fileExists(newPath)) {
-    Serial.print(F("Preset destino '"));
-    Serial.print(newName);
-    Serial.println(F("' ya existe"));
+    debugSerial.print(F("Preset destino '"));
+    debugSerial.print(newName);
+    debugSerial.println(F("' ya existe"));
     return false;
   }
   
   if (copyFile(oldPath, newPath) && deleteFile(oldPath)) {
-    Serial.print(F("Preset renombrado"));
+    debugSerial.print(F("Preset renombrado"));
     return true;
   }
   
@@ -659,7 +668,7 @@ void FileManager::updateSpaceInfo() {
 }
 
 void FileManager::clearTempFiles() {
-  Serial.println(F("Limpiando archivos temporales..."));
+  debugSerial.println(F("Limpiando archivos temporales..."));
   
   File tempDir = SD.open(TEMP_DIRECTORY);
   if (!tempDir || !tempDir.isDirectory()) {
@@ -685,16 +694,16 @@ void FileManager::clearTempFiles() {
   
   tempDir.close();
   
-  Serial.print(F("Archivos temporales eliminados: "));
-  Serial.println(filesDeleted);
+  debugSerial.print(F("Archivos temporales eliminados: "));
+  debugSerial.println(filesDeleted);
 }
 
 void FileManager::defragmentFiles() {
-  Serial.println(F("Desfragmentación no soportada"));
+  debugSerial.println(F("Desfragmentación no soportada"));
 }
 
 bool FileManager::repairFileSystem() {
-  Serial.println(F("Reparando sistema de archivos..."));
+  debugSerial.println(F("Reparando sistema de archivos..."));
   
   bool repaired = false;
   
@@ -714,7 +723,7 @@ bool FileManager::repairFileSystem() {
   }
   
   if (repaired) {
-    Serial.println(F("Estructura reparada"));
+    debugSerial.println(F("Estructura reparada"));
   }
   
   return repaired;
@@ -726,7 +735,7 @@ bool FileManager::checkSDHealth() {
 }
 
 void FileManager::reinitializeSD() {
-  Serial.println(F("Reinicializando SD..."));
+  debugSerial.println(F("Reinicializando SD..."));
   
   sdInitialized = false;
   sdCardPresent = false;
@@ -734,9 +743,9 @@ void FileManager::reinitializeSD() {
   delay(100);
   
   if (initialize()) {
-    Serial.println(F("SD reinicializada"));
+    debugSerial.println(F("SD reinicializada"));
   } else {
-    Serial.println(F("Error reinicialización"));
+    debugSerial.println(F("Error reinicialización"));
   }
 }
 
@@ -786,20 +795,20 @@ bool FileManager::importPresets(const char* filename) {
 }
 
 bool FileManager::recoverConfiguration() {
-  Serial.println(F("Recuperando configuración..."));
+  debugSerial.println(F("Recuperando configuración..."));
   
   if (restoreFromBackup(CONFIG_FILENAME)) {
-    Serial.println(F("Recuperada desde backup"));
+    debugSerial.println(F("Recuperada desde backup"));
     return true;
   }
   
-  Serial.println(F("Creando por defecto"));
+  debugSerial.println(F("Creando por defecto"));
   resetConfiguration();
   return false;
 }
 
 bool FileManager::verifyAllFiles() {
-  Serial.println(F("Verificando archivos..."));
+  debugSerial.println(F("Verificando archivos..."));
   
   bool allValid = true;
   uint8_t filesChecked = 0;
@@ -808,7 +817,7 @@ bool FileManager::verifyAllFiles() {
   if (fileExists(CONFIG_FILENAME)) {
     filesChecked++;
     if (!verifyFileIntegrity(CONFIG_FILENAME)) {
-      Serial.println(F("Config corrupto"));
+      debugSerial.println(F("Config corrupto"));
       allValid = false;
       filesCorrupted++;
     }
@@ -822,17 +831,17 @@ bool FileManager::verifyAllFiles() {
     filesChecked++;
     
     if (!verifyFileIntegrity(pathBuffer)) {
-      Serial.print(F("Preset corrupto: "));
-      Serial.println(presetNames[i]);
+      debugSerial.print(F("Preset corrupto: "));
+      debugSerial.println(presetNames[i]);
       allValid = false;
       filesCorrupted++;
     }
   }
   
-  Serial.print(F("Verificados: "));
-  Serial.print(filesChecked);
-  Serial.print(F(", Corruptos: "));
-  Serial.println(filesCorrupted);
+  debugSerial.print(F("Verificados: "));
+  debugSerial.print(filesChecked);
+  debugSerial.print(F(", Corruptos: "));
+  debugSerial.println(filesCorrupted);
   
   return allValid;
 }
@@ -852,57 +861,57 @@ uint8_t FileManager::scanForCorruption() {
 void FileManager::printDirectoryTree(const char* path) const {
   File dir = SD.open(path);
   if (!dir || !dir.isDirectory()) {
-    Serial.print(F("Error abriendo: "));
-    Serial.println(path);
+    debugSerial.print(F("Error abriendo: "));
+    debugSerial.println(path);
     return;
   }
   
-  Serial.print(F("Directorio "));
-  Serial.println(path);
-  Serial.println(F("------------------"));
+  debugSerial.print(F("Directorio "));
+  debugSerial.println(path);
+  debugSerial.println(F("------------------"));
   
   File entry = dir.openNextFile();
   while (entry) {
-    Serial.print(entry.isDirectory() ? F("[DIR] ") : F("[FILE] "));
-    Serial.print(entry.name());
+    debugSerial.print(entry.isDirectory() ? F("[DIR] ") : F("[FILE] "));
+    debugSerial.print(entry.name());
     
     if (!entry.isDirectory()) {
-      Serial.print(F(" ("));
-      Serial.print(entry.size());
-      Serial.print(F(" bytes)"));
+      debugSerial.print(F(" ("));
+      debugSerial.print(entry.size());
+      debugSerial.print(F(" bytes)"));
     }
     
-    Serial.println();
+    debugSerial.println();
     entry.close();
     entry = dir.openNextFile();
   }
   
   dir.close();
-  Serial.println(F("------------------"));
+  debugSerial.println(F("------------------"));
 }
 
 void FileManager::printSystemInfo() const {
-  Serial.println(F("\n=== INFO SD ==="));
-  Serial.print(F("Inicializada: "));
-  Serial.println(sdInitialized ? F("Si") : F("No"));
-  Serial.print(F("Presente: "));
-  Serial.println(sdCardPresent ? F("Si") : F("No"));
-  Serial.print(F("Total: "));
-  Serial.print(totalSpace / 1024);
-  Serial.println(F(" KB"));
-  Serial.print(F("Libre: "));
-  Serial.print(freeSpace / 1024);
-  Serial.println(F(" KB"));
-  Serial.print(F("Uso: "));
-  Serial.print(getUsagePercent());
-  Serial.println(F("%"));
-  Serial.print(F("Escritos: "));
-  Serial.println(filesWritten);
-  Serial.print(F("Leidos: "));
-  Serial.println(filesRead);
-  Serial.print(F("Errores: "));
-  Serial.println(errorCount);
-  Serial.println(F("==============="));
+  debugSerial.println(F("\n=== INFO SD ==="));
+  debugSerial.print(F("Inicializada: "));
+  debugSerial.println(sdInitialized ? F("Si") : F("No"));
+  debugSerial.print(F("Presente: "));
+  debugSerial.println(sdCardPresent ? F("Si") : F("No"));
+  debugSerial.print(F("Total: "));
+  debugSerial.print(totalSpace / 1024);
+  debugSerial.println(F(" KB"));
+  debugSerial.print(F("Libre: "));
+  debugSerial.print(freeSpace / 1024);
+  debugSerial.println(F(" KB"));
+  debugSerial.print(F("Uso: "));
+  debugSerial.print(getUsagePercent());
+  debugSerial.println(F("%"));
+  debugSerial.print(F("Escritos: "));
+  debugSerial.println(filesWritten);
+  debugSerial.print(F("Leidos: "));
+  debugSerial.println(filesRead);
+  debugSerial.print(F("Errores: "));
+  debugSerial.println(errorCount);
+  debugSerial.println(F("==============="));
 }
 
 bool FileManager::isValidFilename(const char* filename) const {
@@ -942,14 +951,14 @@ void FileManager::sanitizeFilename(char* filename) const {
 
 void FileManager::logError(const char* operation, const char* filename) {
   errorCount++;
-  Serial.print(F("ERROR: "));
-  Serial.print(operation);
+  debugSerial.print(F("ERROR: "));
+  debugSerial.print(operation);
   if (filename) {
-    Serial.print(F(" ("));
-    Serial.print(filename);
-    Serial.print(F(")"));
+    debugSerial.print(F(" ("));
+    debugSerial.print(filename);
+    debugSerial.print(F(")"));
   }
-  Serial.println();
+  debugSerial.println();
   
   if (loggingEnabled) {
     char logMsg[64];
@@ -959,14 +968,14 @@ void FileManager::logError(const char* operation, const char* filename) {
 }
 
 void FileManager::logSuccess(const char* operation, const char* filename) {
-  Serial.print(F("OK: "));
-  Serial.print(operation);
+  debugSerial.print(F("OK: "));
+  debugSerial.print(operation);
   if (filename) {
-    Serial.print(F(" ("));
-    Serial.print(filename);
-    Serial.print(F(")"));
+    debugSerial.print(F(" ("));
+    debugSerial.print(filename);
+    debugSerial.print(F(")"));
   }
-  Serial.println();
+  debugSerial.println();
   
   if (loggingEnabled) {
     char logMsg[64];
@@ -1026,16 +1035,16 @@ bool FileManager::createPath(const char* fullPath) {
 }
 
 void FileManager::printFileInfo(const FileInfo& info) const {
-  Serial.print(info.isDirectory ? F("[DIR] ") : F("[FILE] "));
-  Serial.print(info.name);
+  debugSerial.print(info.isDirectory ? F("[DIR] ") : F("[FILE] "));
+  debugSerial.print(info.name);
   
   if (!info.isDirectory) {
-    Serial.print(F(" ("));
-    Serial.print(info.size);
-    Serial.print(F(" bytes)"));
+    debugSerial.print(F(" ("));
+    debugSerial.print(info.size);
+    debugSerial.print(F(" bytes)"));
   }
   
-  Serial.println();
+  debugSerial.println();
 }
 
 void FileManager::cleanupOldBackups(const char* baseFilename) {
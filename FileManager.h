@@ -15,7 +15,7 @@
 
 #define MAX_FILENAME_LENGTH    16//32
 #define MAX_PRESET_NAME        16
-#define CONFIG_VERSION         1
+#define CONFIG_VERSION         15
 #define MAX_BACKUP_FILES       5
 #define SD_RETRY_COUNT         3
 
@@ -92,16 +92,16 @@ public:
   
   // Operaciones de configuración principal
   bool saveConfiguration(const AppConfig& config, 
-                        const EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]);
+                        const EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]);
   bool loadConfiguration(AppConfig& config, 
-                        EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]);
+                        EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]);
   bool resetConfiguration();
   
   // Gestión de presets
   bool savePreset(const char* presetName, 
-                 const EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]);
+                 const EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]);
   bool loadPreset(const char* presetName, 
-                 EncoderConfig encoders[NUM_ENCODERS][NUM_BANKS]);
+                 EncoderConfig encoders[NUM_BANKS][NUM_ENCODERS]);
   bool deletePreset(const char* presetName);
   bool renamePreset(const char* oldName, const char* newName);
   
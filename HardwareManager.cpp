@@ -1,4 +1,5 @@
 #include "HardwareManager.h"
+#include "UsbMidiPort.h"
 
 HardwareManager::HardwareManager() 
   : lastMCP3State(0xFFFF), lastMCP4State(0xFFFF),
@@ -17,7 +18,7 @@ HardwareManager::~HardwareManager() {
 }
 
 bool HardwareManager::initialize() {
-  Serial.println(F("Inicializando sistema de hardware..."));
+  debugSerial.println(F("Inicializando sistema de hardware..."));
   
   // Inicializar I2C
   Wire.begin();
@@ -32,7 +33,7 @@ bool HardwareManager::initialize() {
   success &= initializeMCP(mcpButtonsEnc, MCP_BUTTONS_ENC_ADDR, "MCP4 Buttons");
   
   if (!success) {
-    Serial.println(F("ERROR: Falló inicialización de uno o más MCPs"));
+    debugSerial.println(F("ERROR: Falló inicialización de uno o más MCPs"));
     return false;
   }
   
@@ -42,20 +43,20 @@ bool HardwareManager::initialize() {
   configureSwitchMCP(mcpSwitches);
   configureSwitchMCP(mcpButtonsEnc);
   
-  Serial.println(F("Hardware inicializado correctamente"));
+  debugSerial.println(F("Hardware inicializado correctamente"));
   return true;
 }
 
 bool HardwareManager::initializeMCP(Adafruit_MCP23X17& mcp, uint8_t address, const char* name) {
-  Serial.print(F("Inicializando "));
-  Serial.print(name);
-  Serial.print(F(" en dirección 0x"));
-  Serial.println(address, HEX);
+  debugSerial.print(F("Inicializando "));
+  debugSerial.print(name);
+  debugSerial.print(F(" en dirección 0x"));
+  debugSerial.println(address, HEX);
   
   if (!mcp.begin_I2C(address)) {
-    Serial.print(F("ERROR: "));
-    Serial.print(name);
-    Serial.println(F(" no responde"));
+    debugSerial.print(F("ERROR: "));
+    debugSerial.print(name);
+    debugSerial.println(F(" no responde"));
     errorCount++;
     return false;
   }
@@ -65,8 +66,8 @@ bool HardwareManager::initializeMCP(Adafruit_MCP23X17& mcp, uint8_t address, con
     return false;
   }
   
-  Serial.print(name);
-  Serial.println(F(" inicializado correctamente"));
+  debugSerial.print(name);
+  debugSerial.println(F(" inicializado correctamente"));
   return true;
 }
 
@@ -99,7 +100,7 @@ void HardwareManager::setupInterrupts() {
   attachInterrupt(digitalPinToInterrupt(INT_MCP2_A), handleMCP2AInterrupt, FALLING);
   attachInterrupt(digitalPinToInterrupt(INT_MCP2_B), handleMCP2BInterrupt, FALLING);
   
-  Serial.println(F("Interrupciones configuradas"));
+  debugSerial.println(F("Interrupciones configuradas"));
 }
 
 void HardwareManager::processMCP1AEncoders() {
@@ -233,6 +234,8 @@ void HardwareManager::pollSwitchesAndButtons() {
         if (pressed) {
           onSwitchPress(i);
           switchPressCount++;
+        } else {
+          onSwitchRelease(i);
         }
       }
     }
@@ -294,6 +297,8 @@ void HardwareManager::readNavigationEncoder() {
       navButtonState = currentButtonState;
       if (navButtonState) {
         onNavigationButtonPress();
+      } else {
+        onNavigationButtonRelease();
       }
     }
   }
@@ -313,8 +318,8 @@ bool HardwareManager::validateMCPResponse(Adafruit_MCP23X17& mcp, const char* na
   uint8_t readValue = mcp.readGPIOA();
   
   if (readValue != testValue) {
-    Serial.print(F("ERROR: Test de comunicación falló para "));
-    Serial.println(name);
+    debugSerial.print(F("ERROR: Test de comunicación falló para "));
+    debugSerial.println(name);
     handleMCPError(name, "communication test");
     return false;
   }
@@ -326,10 +331,10 @@ bool HardwareManager::validateMCPResponse(Adafruit_MCP23X17& mcp, const char* na
 
 void HardwareManager::handleMCPError(const char* mcpName, const char* operation) {
   errorCount++;
-  Serial.print(F("ERROR MCP: "));
-  Serial.print(mcpName);
-  Serial.print(F(" - "));
-  Serial.println(operation);
+  debugSerial.print(F("ERROR MCP: "));
+  debugSerial.print(mcpName);
+  debugSerial.print(F(" - "));
+  debugSerial.println(operation);
 }
 
 bool HardwareManager::checkMCPHealth() {
@@ -364,7 +369,7 @@ bool HardwareManager::checkMCPHealth() {
 }
 
 void HardwareManager::resetMCPs() {
-  Serial.println(F("Reiniciando MCPs..."));
+  debugSerial.println(F("Reiniciando MCPs..."));
   
   // Limpiar todas las interrupciones
   clearAllInterrupts();
@@ -375,7 +380,7 @@ void HardwareManager::resetMCPs() {
   configureSwitchMCP(mcpSwitches);
   configureSwitchMCP(mcpButtonsEnc);
   
-  Serial.println(F("MCPs reiniciados"));
+  debugSerial.println(F("MCPs reiniciados"));
 }
 
 void HardwareManager::clearAllInterrupts() {
@@ -384,23 +389,23 @@ void HardwareManager::clearAllInterrupts() {
 }
 
 bool HardwareManager::testAllMCPs() {
-  Serial.println(F("Ejecutando test completo de MCPs..."));
+  debugSerial.println(F("Ejecutando test completo de MCPs..."));
   
   bool success = true;
   success &= validateMCPResponse(mcpEncodersVol, "MCP1");
   success &= validateMCPResponse(mcpEncodersPan, "MCP2");
   
   if (success) {
-    Serial.println(F("Test de MCPs completado exitosamente"));
+    debugSerial.println(F("Test de MCPs completado exitosamente"));
   } else {
-    Serial.println(F("Test de MCPs falló"));
+    debugSerial.println(F("Test de MCPs falló"));
   }
   
   return success;
 }
 
 void HardwareManager::calibrateEncoders() {
-  Serial.println(F("Calibrando encoders..."));
+  debugSerial.println(F("Calibrando encoders..."));
   
   // Resetear contadores y estados
   memset(encoderValue, 0, sizeof(encoderValue));
@@ -410,7 +415,7 @@ void HardwareManager::calibrateEncoders() {
   encoderValueNav = 0;
   lastEncodedNav = 0;
   
-  Serial.println(F("Calibración completada"));
+  debugSerial.println(F("Calibración completada"));
 }
 
 bool HardwareManager::isInitialized() const {
@@ -418,12 +423,12 @@ bool HardwareManager::isInitialized() const {
 }
 
 void HardwareManager::printDiagnostics() const {
-  Serial.println(F("\n=== DIAGNÓSTICO HARDWARE ==="));
-  Serial.print(F("Lecturas de encoders: "));
-  Serial.println(encoderReadCount);
-  Serial.print(F("Presses de switches: "));
-  Serial.println(switchPressCount);
-  Serial.print(F("Errores detectados: "));
-  Serial.println(errorCount);
-  Serial.println(F("==========================\n"));
+  debugSerial.println(F("\n=== DIAGNÓSTICO HARDWARE ==="));
+  debugSerial.print(F("Lecturas de encoders: "));
+  debugSerial.println(encoderReadCount);
+  debugSerial.print(F("Presses de switches: "));
+  debugSerial.println(switchPressCount);
+  debugSerial.print(F("Errores detectados: "));
+  debugSerial.println(errorCount);
+  debugSerial.println(F("==========================\n"));
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "HuiProtocol.h"
+#include "Midi_Controller.h"
+#include "EncoderManager.h"
+
+extern Midi_Controller midi_controller;
+extern EncoderManager encoders;
+
+#define HUI_ZONE_NONE  0xFF
+
+HuiProtocol::HuiProtocol()
+  : active(false), ledZone(HUI_ZONE_NONE), sysExIndex(0), sysExValid(false),
+    sysExCommand(0), scribbleZone(0), faderTouchMask(0), lastPingTime(0), pingsAnswered(0)
+{
+  memset(faderHigh, 0, sizeof(faderHigh));
+  memset(meterLevel, 0, sizeof(meterLevel));
+  memset(timecodeDigits, 0, sizeof(timecodeDigits));
+  memset(lastFaderMove, 0, sizeof(lastFaderMove));
+}
+
+void HuiProtocol::setActive(bool enable) {
+  active = enable;
+  ledZone = HUI_ZONE_NONE;
+  lastPingTime = 0;
+  
+  // Los medidores HUI llegan como aftertouch polifónico
+  midiInput.acceptStatus(0xA0, enable);
+  midiUart.setPingDetect(enable);
+  usbMidi.setPingDetect(enable);
+}
+
+// ==================== KEEPALIVE ====================
+
+void HuiProtocol::serviceKeepalive() {
+  if (!active) return;
+  
+  uint8_t pings = midiUart.takePingRequests() + usbMidi.takePingRequests();
+  if (!pings) return;
+  
+  // Varios pings acumulados se contestan con una sola respuesta
+  lastPingTime = millis();
+  pingsAnswered++;
+  midi_controller.sendNoteOn(HUI_CHANNEL, 0x00, HUI_PING_REPLY_VELOCITY);
+}
+
+void HuiProtocol::update(unsigned long currentTime) {
+  serviceKeepalive();
+  
+  if (!faderTouchMask) return;
+  
+  for (uint8_t strip = 0; strip < SURFACE_STRIPS; strip++) {
+    uint8_t bit = 1 << strip;
+    if ((faderTouchMask & bit) && currentTime - lastFaderMove[strip] >= HUI_FADER_TOUCH_MS) {
+      sendSwitch(strip, HUI_PORT_FADER_TOUCH, false);
+      faderTouchMask &= ~bit;
+    }
+  }
+}
+
+// ==================== ENTRADA ====================
+
+void HuiProtocol::handleNote(uint8_t note, uint8_t velocity) {
+  // La única nota del protocolo es el ping (nota 0), que ya atiende la ISR
+}
+
+void HuiProtocol::handleControlChange(uint8_t cc, uint8_t value) {
+  if (cc == HUI_CC_LED_ZONE) {
+    ledZone = value;
+  } else if (cc == HUI_CC_LED_PORT) {
+    if (ledZone != HUI_ZONE_NONE) {
+      handleLed(ledZone, value & 0x0F, value & HUI_PORT_ON);
+    }
+  } else if (cc < HUI_CC_FADER_HI + SURFACE_STRIPS) {
+    faderHigh[cc - HUI_CC_FADER_HI] = value;
+  } else if (cc >= HUI_CC_FADER_LO && cc < HUI_CC_FADER_LO + SURFACE_STRIPS) {
+    // El par queda completo con la parte baja: 14 bits -> 0-127
+    uint8_t strip = cc - HUI_CC_FADER_LO;
+    uint16_t value14 = ((uint16_t)faderHigh[strip] << 7) | value;
+    encoders.setEncoderDAWValue(SURFACE_STRIPS + strip, systemState.currentBank, value14 >> 7);
+  } else if (cc >= HUI_CC_VPOT_RING && cc < HUI_CC_VPOT_RING + SURFACE_STRIPS) {
+    // Posición 1-11 en el nibble bajo (0 = apagado)
+    uint8_t position = value & 0x0F;
+    if (position >= 1 && position <= 11) {
+      encoders.setEncoderDAWValue(cc - HUI_CC_VPOT_RING, systemState.currentBank,
+                                  (position - 1) * 127 / 10);
+    }
+  }
+}
+
+void HuiProtocol::handleLed(uint8_t zone, uint8_t port, bool on) {
+  if (zone < SURFACE_STRIPS) {
+    if (port == HUI_PORT_MUTE) {
+      encoders.syncMixBitFromDAW(systemState.currentBank, zone, false, on);
+    } else if (port == HUI_PORT_SOLO) {
+      encoders.syncMixBitFromDAW(systemState.currentBank, zone, true, on);
+    }
+  } else if (zone == HUI_ZONE_TRANSPORT) {
+    TransportState transport = midi_controller.getTransportState();
+    if (port == HUI_PORT_PLAY) transport.isPlaying = on;
+    else if (port == HUI_PORT_RECORD) transport.isRecording = on;
+    else if (port == HUI_PORT_STOP && on) transport.isPlaying = false;
+    else return;
+    midi_controller.setTransportState(transport);
+  }
+}
+
+void HuiProtocol::handlePolyPressure(uint8_t note, uint8_t value) {
+  if (note >= SURFACE_STRIPS) return;
+  
+  uint8_t side = (value >> 4) & 0x01;
+  uint8_t level = min(value & 0x0F, HUI_METER_MAX);
+  meterLevel[note][side] = level;
+  
+  extern void updateVUMeterLevel(uint8_t track, uint8_t level);
+  uint8_t peak = max(meterLevel[note][0], meterLevel[note][1]);
+  updateVUMeterLevel(note, (uint16_t)peak * 127 / HUI_METER_MAX);
+}
+
+void HuiProtocol::beginSysEx() {
+  sysExIndex = 0;
+  sysExValid = false;
+}
+
+void HuiProtocol::handleSysExByte(uint8_t data) {
+  // Bytes tras el header 00 00 66: dispositivo 05, 00 y comando
+  switch (sysExIndex) {
+    case 0: sysExValid = (data == HUI_DEVICE_ID); break;
+    case 1: sysExValid = sysExValid && data == 0x00; break;
+    case 2: sysExCommand = data; break;
+    default:
+      if (sysExValid) handleSysExData(sysExIndex - 3, data);
+      break;
+  }
+  if (sysExIndex < 0xFF) sysExIndex++;
+}
+
+void HuiProtocol::handleSysExData(uint8_t position, uint8_t data) {
+  if (sysExCommand == HUI_SYSEX_SCRIBBLE) {
+    // [zona] [c0..c3], posiblemente varias zonas seguidas en el mismo mensaje
+    uint8_t field = position % (HUI_SCRIBBLE_CHARS + 1);
+    if (field == 0) {
+      scribbleZone = data;
+    } else if (scribbleZone < SURFACE_STRIPS && field - 1 < TRACK_NAME_SIZE - 1) {
+      encoders.setTrackNameChar(scribbleZone, systemState.currentBank, field - 1, (char)data);
+      encoders.setTrackNameChar(scribbleZone + SURFACE_STRIPS, systemState.currentBank, field - 1, (char)data);
+    }
+  } else if (sysExCommand == HUI_SYSEX_TIMECODE && position < HUI_TIMECODE_DIGITS) {
+    // Bit 4: punto decimal
+    timecodeDigits[position] = data & 0x0F;
+    if (position == HUI_TIMECODE_DIGITS - 1) updateTimecode();
+  }
+}
+
+void HuiProtocol::updateTimecode() {
+  // 8 dígitos, de derecha a izquierda: FF SS MM HH
+  const uint8_t* d = timecodeDigits;
+  MtcData mtc = midi_controller.getMtcData();
+  mtc.frames = d[1] * 10 + d[0];
+  mtc.seconds = d[3] * 10 + d[2];
+  mtc.minutes = d[5] * 10 + d[4];
+  mtc.hours = d[7] * 10 + d[6];
+  midi_controller.setMtcData(mtc);
+}
+
+// ==================== SALIDA ====================
+
+void HuiProtocol::sendSwitch(uint8_t zone, uint8_t port, bool pressed) {
+  // El par zona/puerto no puede fusionarse con otro pendiente de la cola
+  midi_controller.sendControlChange(HUI_CHANNEL, HUI_CC_SWITCH_ZONE, zone,
+                                    TX_PRIO_USER | TX_NO_COALESCE);
+  midi_controller.sendControlChange(HUI_CHANNEL, HUI_CC_SWITCH_PORT,
+                                    pressed ? (HUI_PORT_ON | port) : port,
+                                    TX_PRIO_USER | TX_NO_COALESCE);
+}
+
+void HuiProtocol::sendVPot(uint8_t strip, int8_t delta) {
+  if (strip >= SURFACE_STRIPS || delta == 0) return;
+  // Horario: 0x40 + pasos; antihorario: pasos sin el bit 6
+  uint8_t magnitude = constrain(abs(delta), 1, 0x3F);
+  uint8_t value = (delta > 0) ? (0x40 | magnitude) : magnitude;
+  midi_controller.sendControlChange(HUI_CHANNEL, HUI_CC_VPOT + strip, value,
+                                    TX_PRIO_USER | TX_NO_COALESCE);
+}
+
+void HuiProtocol::sendFader(uint8_t strip, uint8_t value) {
+  if (strip >= SURFACE_STRIPS) return;
+  
+  // El host ignora el fader si no está "tocado"
+  uint8_t bit = 1 << strip;
+  if (!(faderTouchMask & bit)) {
+    sendSwitch(strip, HUI_PORT_FADER_TOUCH, true);
+    faderTouchMask |= bit;
+  }
+  lastFaderMove[strip] = millis();
+  
+  // Parte alta y baja; la baja repite el valor para llegar al tope
+  midi_controller.sendControlChange(HUI_CHANNEL, HUI_CC_FADER_HI + strip, value);
+  midi_controller.sendControlChange(HUI_CHANNEL, HUI_CC_FADER_LO + strip, value);
+}
+
+void HuiProtocol::sendStripButton(uint8_t switchIndex, bool pressed) {
+  // Switches 0-7: Mute, 8-15: Solo. El host conmuta y devuelve el LED
+  sendSwitch(switchIndex & 0x07, switchIndex < 8 ? HUI_PORT_MUTE : HUI_PORT_SOLO, pressed);
+}
+
+void HuiProtocol::sendButton(uint8_t buttonIndex) {
+  uint8_t zone = HUI_ZONE_TRANSPORT;
+  uint8_t port;
+  switch (buttonIndex) {
+    case BTN_PLAY: port = HUI_PORT_PLAY; break;
+    case BTN_STOP: port = HUI_PORT_STOP; break;
+    case BTN_REC: port = HUI_PORT_RECORD; break;
+    case BTN_BANK_UP: zone = HUI_ZONE_BANK; port = HUI_PORT_BANK_RIGHT; break;
+    case BTN_BANK_DOWN: zone = HUI_ZONE_BANK; port = HUI_PORT_BANK_LEFT; break;
+    default: return;
+  }
+  // Solo hay evento de pulsación: enviar pulsación y liberación seguidas
+  sendSwitch(zone, port, true);
+  sendSwitch(zone, port, false);
+}
@@ -0,0 +1,126 @@
+#ifndef HUI_PROTOCOL_H
+#define HUI_PROTOCOL_H
+
+#include "Config.h"
+#include "SurfaceProtocol.h"
+#include <Arduino.h>
+
+// ==================== MACKIE HUI ====================
+// Todo va por el canal 1. Los botones y LEDs se direccionan con un par
+// zona/puerto; los faders con un par de CC alto/bajo (14 bits).
+#define HUI_CHANNEL             1
+
+// Control Change del host hacia la superficie
+#define HUI_CC_FADER_HI         0x00    // 0x00-0x07: fader, 7 bits altos
+#define HUI_CC_LED_ZONE         0x0C    // Selección de zona para LEDs
+#define HUI_CC_VPOT_RING        0x10    // 0x10-0x17: anillo del V-Pot
+#define HUI_CC_FADER_LO         0x20    // 0x20-0x27: fader, 7 bits bajos
+#define HUI_CC_LED_PORT         0x2C    // Puerto + estado (bit 6) en la zona elegida
+
+// Control Change de la superficie hacia el host
+#define HUI_CC_SWITCH_ZONE      0x0F
+#define HUI_CC_SWITCH_PORT      0x2F    // 0x40 | puerto al pulsar, puerto al soltar
+#define HUI_CC_VPOT             0x40    // 0x40-0x47: giro de V-Pot
+
+#define HUI_PORT_ON             0x40
+
+// Zonas 0-7: un strip cada una
+#define HUI_PORT_FADER_TOUCH    0
+#define HUI_PORT_SELECT         1
+#define HUI_PORT_MUTE           2
+#define HUI_PORT_SOLO           3
+
+// Zona de banco/canal
+#define HUI_ZONE_BANK           0x0A
+#define HUI_PORT_BANK_LEFT      1
+#define HUI_PORT_BANK_RIGHT     3
+
+// Zona de transporte
+#define HUI_ZONE_TRANSPORT      0x0E
+#define HUI_PORT_REWIND         1
+#define HUI_PORT_FORWARD        2
+#define HUI_PORT_STOP           3
+#define HUI_PORT_PLAY           4
+#define HUI_PORT_RECORD         5
+
+// Ping: el host envía 90 00 00 cada segundo y espera 90 00 7F.
+// Lo detecta la ISR de recepción (MidiUart) para poder responder aunque
+// el loop esté ocupado redibujando la pantalla.
+#define HUI_PING_REPLY_VELOCITY 0x7F
+#define HUI_OFFLINE_MS          3000    // Sin ping durante este tiempo: host perdido
+
+// SysEx: F0 00 00 66 05 00 [comando] ... F7
+#define HUI_DEVICE_ID           0x05
+#define HUI_SYSEX_SCRIBBLE      0x10    // [zona] [4 caracteres]
+#define HUI_SYSEX_TIMECODE      0x11    // Dígitos de derecha a izquierda
+#define HUI_SCRIBBLE_CHARS      4
+#define HUI_TIMECODE_DIGITS     8
+
+// Medidores por aftertouch polifónico: nota = strip, valor = [lado:4][nivel:4]
+#define HUI_METER_MAX           0x0C
+
+#define HUI_FADER_TOUCH_MS      300     // Sin movimiento: soltar el touch del fader
+
+class HuiProtocol : public SurfaceProtocol {
+private:
+  bool active;
+  
+  // Zona de LEDs seleccionada por el host (0xFF: ninguna)
+  uint8_t ledZone;
+  
+  // Parte alta pendiente de cada fader hasta recibir la baja
+  uint8_t faderHigh[SURFACE_STRIPS];
+  
+  // Nivel de cada lado del medidor: se muestra el mayor
+  uint8_t meterLevel[SURFACE_STRIPS][2];
+  
+  // SysEx en curso
+  uint8_t sysExIndex;
+  bool sysExValid;
+  uint8_t sysExCommand;
+  uint8_t scribbleZone;
+  uint8_t timecodeDigits[HUI_TIMECODE_DIGITS];
+  
+  // Touch de los faders (encoders 8-15)
+  uint8_t faderTouchMask;
+  unsigned long lastFaderMove[SURFACE_STRIPS];
+  
+  // Keepalive
+  unsigned long lastPingTime;
+  uint32_t pingsAnswered;
+  
+  void handleLed(uint8_t zone, uint8_t port, bool on);
+  void handleSysExData(uint8_t position, uint8_t data);
+  void updateTimecode();
+  void sendSwitch(uint8_t zone, uint8_t port, bool pressed);
+
+public:
+  HuiProtocol();
+  
+  void setActive(bool enable) override;
+  bool isActive() const { return active; }
+  
+  // Responder pings detectados por la ISR. Barato: se puede llamar desde
+  // cualquier punto largo del loop (redibujado de pantalla incluido)
+  void serviceKeepalive();
+  void update(unsigned long currentTime) override;
+  
+  // Entrada desde el DAW
+  void handleNote(uint8_t note, uint8_t velocity) override;
+  void handleControlChange(uint8_t cc, uint8_t value) override;
+  void handlePolyPressure(uint8_t note, uint8_t value) override;
+  void beginSysEx() override;
+  void handleSysExByte(uint8_t data) override;
+  
+  // Salida hacia el DAW
+  void sendVPot(uint8_t strip, int8_t delta) override;
+  void sendFader(uint8_t strip, uint8_t value) override;
+  void sendStripButton(uint8_t switchIndex, bool pressed) override;
+  void sendButton(uint8_t buttonIndex) override;
+  
+  // Diagnóstico
+  bool isHostOnline() const { return active && lastPingTime && millis() - lastPingTime < HUI_OFFLINE_MS; }
+  uint32_t getPingsAnswered() const { return pingsAnswered; }
+};
+
+#endif // HUI_PROTOCOL_H
@@ -0,0 +1,91 @@
+#include "JogManager.h"
+#include "Midi_Controller.h"
+
+extern Midi_Controller midi_controller;
+
+JogManager::JogManager()
+  : jogAccumulator(0), shuttlePosition(0), shuttleActive(false), shuttleMoved(false),
+    lastTick(0), lastShuttleEmit(0), detentsReceived(0), messagesSent(0)
+{
+}
+
+void JogManager::addMovement(int8_t detents) {
+  if (detents == 0) return;
+  detentsReceived += abs(detents);
+  
+  if (shuttleActive) {
+    // En shuttle el giro fija la velocidad, no la posición
+    shuttlePosition = constrain(shuttlePosition + detents, -SHUTTLE_MAX_POSITION, SHUTTLE_MAX_POSITION);
+    shuttleMoved = true;
+  } else {
+    // En jog se acumula y se emite coalescido en el siguiente tick
+    jogAccumulator = constrain(jogAccumulator + detents, -JOG_MAX_STEP, JOG_MAX_STEP);
+  }
+}
+
+void JogManager::beginShuttle() {
+  shuttleActive = true;
+  shuttleMoved = false;
+  shuttlePosition = 0;
+  lastShuttleEmit = millis();
+}
+
+bool JogManager::endShuttle() {
+  bool moved = shuttleMoved;
+  shuttleActive = false;
+  shuttleMoved = false;
+  shuttlePosition = 0;
+  return moved;
+}
+
+void JogManager::update(unsigned long currentTime) {
+  if (currentTime - lastTick < JOG_TICK_MS) return;
+  lastTick = currentTime;
+  
+  if (jogAccumulator != 0) {
+    uint8_t detents = abs(jogAccumulator);
+    int16_t amount = scaleJogVelocity(detents);
+    emit(jogAccumulator > 0 ? amount : -amount);
+    jogAccumulator = 0;
+  }
+  
+  // Shuttle: ritmo fijo, magnitud proporcional al desplazamiento
+  if (shuttleActive && shuttlePosition != 0 &&
+      currentTime - lastShuttleEmit >= SHUTTLE_INTERVAL_MS) {
+    emit(shuttlePosition * SHUTTLE_GAIN);
+    lastShuttleEmit = currentTime;
+  }
+}
+
+uint8_t JogManager::scaleJogVelocity(uint8_t detents) const {
+  // Giro lento: paso a paso; giro rápido: crecimiento cuadrático
+  uint16_t scaled = detents + (detents * detents) / 4;
+  return (scaled > JOG_MAX_STEP) ? JOG_MAX_STEP : scaled;
+}
+
+void JogManager::emit(int16_t amount) {
+  if (amount == 0) return;
+  
+  bool forward = amount > 0;
+  uint8_t magnitude = constrain(abs(amount), 1, JOG_MAX_STEP);
+  uint8_t channel = midi_controller.getMidiChannel();
+  
+  switch (appConfig.jogOutputMode) {
+    case JOG_OUT_MACKIE:
+      // Mackie: 0x01-0x3F horario, 0x41-0x7F antihorario
+      midi_controller.sendControlChange(1, MACKIE_JOG_CC, forward ? magnitude : (0x40 | magnitude),
+                                        TX_PRIO_USER | TX_NO_COALESCE);
+      break;
+    case JOG_OUT_NOTES: {
+      uint8_t note = forward ? JOG_NOTE_FORWARD : JOG_NOTE_BACKWARD;
+      midi_controller.sendNoteOn(channel, note, magnitude);
+      midi_controller.sendNoteOff(channel, note, 0);
+      break;
+    }
+    case JOG_OUT_RELATIVE_CC:
+    default:
+      midi_controller.sendJogWheel(forward ? magnitude : -magnitude);
+      break;
+  }
+  messagesSent++;
+}
@@ -0,0 +1,45 @@
+#ifndef JOG_MANAGER_H
+#define JOG_MANAGER_H
+
+#include "Config.h"
+#include <Arduino.h>
+
+#define SHUTTLE_MAX_POSITION   7     // Desplazamiento máximo del shuttle (detents)
+#define SHUTTLE_INTERVAL_MS    40    // Periodo fijo de emisión del shuttle
+#define SHUTTLE_GAIN           2     // Pasos emitidos por detent de desplazamiento
+#define JOG_MAX_STEP           63    // Magnitud máxima por mensaje
+
+class JogManager {
+private:
+  int16_t jogAccumulator;         // Detents acumulados desde el último tick
+  int8_t shuttlePosition;         // Desplazamiento del shuttle (botón nav pulsado)
+  bool shuttleActive;
+  bool shuttleMoved;
+  unsigned long lastTick;
+  unsigned long lastShuttleEmit;
+  
+  // Estadísticas
+  uint32_t detentsReceived;
+  uint32_t messagesSent;
+  
+  uint8_t scaleJogVelocity(uint8_t detents) const;
+  void emit(int16_t amount);
+
+public:
+  JogManager();
+  
+  // Entrada desde el encoder de navegación
+  void addMovement(int8_t detents);
+  void beginShuttle();
+  bool endShuttle();               // true si el shuttle llegó a moverse
+  bool isShuttleActive() const { return shuttleActive; }
+  
+  // Generación de mensajes a ritmo fijo (llamar desde loop)
+  void update(unsigned long currentTime);
+  
+  // Diagnóstico
+  uint32_t getDetentsReceived() const { return detentsReceived; }
+  uint32_t getMessagesSent() const { return messagesSent; }
+};
+
+#endif // JOG_MANAGER_H
@@ -24,6 +24,15 @@
 #include "Midi_Controller.h"
 #include "MenuManager.h"
 #include "FileManager.h"
+#include "JogManager.h"
+#include "ResyncManager.h"
+#include "McuProtocol.h"
+#include "HuiProtocol.h"
+#include "TimingGenerator.h"
+#include "UsbMidiPort.h"
+#include "DawMonitor.h"
+#include "MidiStats.h"
+#include "MidiTrace.h"
 
 // Instancias globales de los managers
 HardwareManager hardware;
@@ -32,6 +41,10 @@ Midi_Controller midi_controller;
 MenuManager menu;
 EncoderManager encoders;
 FileManager fileSystem;
+JogManager jog;
+ResyncManager resync;
+McuProtocol mcu;
+HuiProtocol hui;
 
 // Variables globales del sistema
 SystemState systemState;
@@ -65,28 +78,32 @@ int freeMemory() {
 }
 
 void setup() {
-  Serial.begin(115200);
-  Serial.println(F("Inicializando Controlador MIDI Mackie..."));
+  // La misma velocidad sirve a la depuración y al transporte MIDI por USB
+  Serial.begin(USB_MIDI_BAUD_RATE);
+  debugSerial.println(F("Inicializando Controlador MIDI Mackie..."));
   
   // Inicializar sistema por orden de dependencias
   if (!fileSystem.initialize()) {
-    Serial.println(F("ERROR: Falló inicialización SD"));
+    debugSerial.println(F("ERROR: Falló inicialización SD"));
   }
   
   fileSystem.loadConfiguration(appConfig, encoders.getEncoderBanks());
   
   if (!hardware.initialize()) {
-    Serial.println(F("ERROR CRÍTICO: Falló inicialización hardware"));
+    debugSerial.println(F("ERROR CRÍTICO: Falló inicialización hardware"));
     while(1) { delay(1000); }
   }
   
   if (!display.initialize(appConfig.orientation, appConfig.brightness)) {
-    Serial.println(F("ERROR: Falló inicialización pantalla"));
+    debugSerial.println(F("ERROR: Falló inicialización pantalla"));
   }
   
   midi_controller.initialize(appConfig.midiChannel);
   menu.initialize(&appConfig, &systemState);
   encoders.initialize(&appConfig);
+  applyProtocolMode();
+  applyTimingMaster();
+  applyMidiPorts();
   
   // Configurar interrupciones
   hardware.setupInterrupts();
@@ -97,9 +114,12 @@ void setup() {
   systemState.inMenu = false;
   systemState.currentBank = appConfig.currentBank;
   
-  Serial.println(F("Sistema inicializado correctamente"));
-  Serial.print(F("Memoria libre: "));
-  Serial.println(freeMemory());
+  // Pedir al DAW el estado del banco inicial
+  resync.invalidateBank(systemState.currentBank);
+  
+  debugSerial.println(F("Sistema inicializado correctamente"));
+  debugSerial.print(F("Memoria libre: "));
+  debugSerial.println(freeMemory());
 }
 
 void loop() {
@@ -117,13 +137,46 @@ void loop() {
   // Procesar encoder de navegación
   processNavigationEncoder();
   
-  // Procesar MIDI entrante
+  // Reconciliar valores locales con los ecos del DAW
+  encoders.update(currentTime);
+  
+  // Emisión de jog/shuttle a ritmo fijo
+  jog.update(currentTime);
+  
+  // Peticiones de resincronización con el DAW (con presupuesto de ancho de banda).
+  // En modo Mackie/HUI el DAW reenvía por sí mismo todo el estado de los strips
+  SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+  if (surface) {
+    surface->update(currentTime);
+  } else {
+    resync.update(currentTime);
+  }
+  
+  // Procesar todo el MIDI entrante disponible (con presupuesto de tiempo)
   midi_controller.processMidiInput();
+  midi_controller.updateTimecode();
+  timingGenerator.update();
+  
+  // Presencia del DAW y Active Sensing de salida
+  dawMonitor.update(currentTime);
+  
+  // Tasas de tráfico y trama de monitorización
+  midiStats.update(currentTime);
+  
+  // Captura MIDI a la SD: como mucho un sector por pasada
+  midiTrace.update(currentTime);
+  
+  // Vaciar la cola de salida MIDI según prioridad
+  midi_controller.processMidiOutput();
   
   // Actualizar pantalla (con control de framrate)
   if (currentTime - systemState.lastDisplayUpdate >= DISPLAY_UPDATE_INTERVAL) {
     updateDisplay(currentTime);
     systemState.lastDisplayUpdate = currentTime;
+    
+    // El redibujado puede tardar varios ms: drenar lo acumulado mientras tanto
+    midi_controller.processMidiInput();
+    midi_controller.processMidiOutput();
   }
   
   // Gestión de salvapantallas
@@ -134,9 +187,6 @@ void loop() {
     performDiagnostics();
     systemState.lastDiagnostic = currentTime;
   }
-  
-  // Pequeño delay para estabilidad
-  delay(1);
 }
 
 void processInterrupts() {
@@ -172,16 +222,20 @@ void processNavigationEncoder() {
 
 void updateDisplay(unsigned long currentTime) {
   if (systemState.screensaverActive) {
-    display.drawScreensaver(midi_controller.getMtcData(), systemState.currentBank);
+    display.drawScreensaver(midi_controller.getMtcData(), midi_controller.getClockData(), systemState.currentBank);
   } else if (systemState.inMenu) {
     menu.draw(display);
   } else {
     // Pantalla principal con meters y información
+    display.markMixDirty(encoders.takeMixDirtyMask());
     display.drawMainScreen(
       encoders.getEncoderBanks()[systemState.currentBank],
       midi_controller.getMtcData(),
+      midi_controller.getClockData(),
       systemState.currentBank,
-      midi_controller.getTransportState()
+      midi_controller.getTransportState(),
+      encoders.getMixState(systemState.currentBank),
+      encoders.getImpliedMuteMask(systemState.currentBank)
     );
   }
 }
@@ -192,7 +246,7 @@ void updateScreensaver(unsigned long currentTime) {
         (currentTime - systemState.lastActivityTime) > appConfig.screensaverTimeout) {
       systemState.screensaverActive = true;
       display.setBrightness(0);
-      Serial.println(F("Salvapantallas activado"));
+      debugSerial.println(F("Salvapantallas activado"));
     }
   }
 }
@@ -201,18 +255,23 @@ void performDiagnostics() {
   // Verificar memoria disponible
   int freeRam = freeMemory();
   if (freeRam < 1000) {
-    Serial.print(F("ADVERTENCIA: Poca memoria libre: "));
-    Serial.println(freeRam);
+    debugSerial.print(F("ADVERTENCIA: Poca memoria libre: "));
+    debugSerial.println(freeRam);
   }
   
   // Verificar estado de MCPs
   if (!hardware.checkMCPHealth()) {
-    Serial.println(F("ADVERTENCIA: Problema detectado en MCPs"));
+    debugSerial.println(F("ADVERTENCIA: Problema detectado en MCPs"));
   }
   
   // Verificar SD card
   if (!fileSystem.checkSDHealth()) {
-    Serial.println(F("ADVERTENCIA: Problema con tarjeta SD"));
+    debugSerial.println(F("ADVERTENCIA: Problema con tarjeta SD"));
+  }
+  
+  // Verificar sincronización con el DAW
+  if (resync.getFailedMask()) {
+    debugSerial.println(F("ADVERTENCIA: Tracks sin respuesta del DAW"));
   }
 }
 
@@ -227,10 +286,33 @@ void onSwitchPress(uint8_t switchIndex) {
   resetActivity();
 }
 
+void onSwitchRelease(uint8_t switchIndex) {
+  encoders.processSwitchRelease(switchIndex, systemState.currentBank);
+}
+
 void onButtonPress(uint8_t buttonIndex) {
+  // Como maestro, Play/Stop arrancan el generador, que envía FA/FB/FC alineados con el clock
+  bool masterTransport = timingGenerator.isActive() &&
+                         (buttonIndex == BTN_PLAY || buttonIndex == BTN_STOP);
+  if (masterTransport) {
+    if (buttonIndex == BTN_PLAY) {
+      timingGenerator.start();
+    } else {
+      timingGenerator.stop();
+    }
+  }
+  
+  SurfaceProtocol* surface = midi_controller.getSurfaceProtocol();
+  if (surface) {
+    // Transporte y banco de 8 strips los gestiona el DAW
+    surface->sendButton(buttonIndex);
+    resetActivity();
+    return;
+  }
+  
   switch (buttonIndex) {
-    case BTN_PLAY: midi_controller.sendTransportCommand(MIDI_PLAY); break;
-    case BTN_STOP: midi_controller.sendTransportCommand(MIDI_STOP); break;
+    case BTN_PLAY: if (!masterTransport) midi_controller.sendTransportCommand(MIDI_PLAY); break;
+    case BTN_STOP: if (!masterTransport) midi_controller.sendTransportCommand(MIDI_STOP); break;
     case BTN_REC: midi_controller.sendTransportCommand(MIDI_RECORD); break;
     case BTN_BANK_UP: changeBankSafely(1); break;
     case BTN_BANK_DOWN: changeBankSafely(-1); break;
@@ -242,7 +324,7 @@ void onNavigationEncoderChange(int8_t change) {
   if (systemState.inMenu) {
     menu.navigate(change);
   } else {
-    midi_controller.sendJogWheel(change);
+    jog.addMovement(change);
   }
   resetActivity();
 }
@@ -251,6 +333,16 @@ void onNavigationButtonPress() {
   if (systemState.inMenu) {
     menu.select();
   } else {
+    // Mantener pulsado activa el shuttle; el menú se abre al soltar sin girar
+    jog.beginShuttle();
+  }
+  resetActivity();
+}
+
+void onNavigationButtonRelease() {
+  if (!jog.isShuttleActive()) return;
+  
+  if (!jog.endShuttle() && !systemState.inMenu) {
     systemState.inMenu = true;
     menu.enter();
   }
@@ -271,14 +363,86 @@ void resetActivity() {
   }
 }
 
+void applyProtocolMode() {
+  mcu.setActive(appConfig.protocolMode == PROTO_MCU);
+  hui.setActive(appConfig.protocolMode == PROTO_HUI);
+  
+  debugSerial.print(F("Protocolo DAW: "));
+  switch (appConfig.protocolMode) {
+    case PROTO_MCU:
+      midi_controller.setSurfaceProtocol(&mcu);
+      debugSerial.println(F("Mackie Control"));
+      break;
+    case PROTO_HUI:
+      midi_controller.setSurfaceProtocol(&hui);
+      debugSerial.println(F("HUI"));
+      break;
+    default:
+      midi_controller.setSurfaceProtocol(nullptr);
+      debugSerial.println(F("Studio One"));
+      break;
+  }
+}
+
+void applyTimingMaster() {
+  timingGenerator.setTempo(appConfig.masterTempoX10);
+  timingGenerator.setFrameRate(appConfig.masterRate);
+  timingGenerator.setMode(appConfig.masterMode);
+  midi_controller.setTxRunningStatus(!(appConfig.masterMode & MASTER_MTC));
+  
+  // Lo que genera el propio controlador no se mezcla con el de la entrada
+  MidiThru& thru = midi_controller.getThru();
+  bool clockMaster = appConfig.masterMode & MASTER_CLOCK;
+  thru.acceptStatus(MIDI_CLOCK, !clockMaster);
+  thru.acceptStatus(MIDI_PLAY, !clockMaster);
+  thru.acceptStatus(MIDI_CONTINUE, !clockMaster);
+  thru.acceptStatus(MIDI_STOP, !clockMaster);
+  thru.acceptStatus(0xF2, !clockMaster);  // Song Position Pointer
+  thru.acceptStatus(MTC_QUARTER_FRAME, !(appConfig.masterMode & MASTER_MTC));
+}
+
+void applyMidiPorts() {
+  if (appConfig.usbMidi && !usbMidi.isEnabled()) {
+    // Último mensaje de depuración antes de que Serial pase a transportar MIDI
+    debugSerial.println(F("Puerto USB: MIDI (depuración desactivada)"));
+  }
+  usbMidi.setEnabled(appConfig.usbMidi);
+  
+  uint8_t available = appConfig.usbMidi ? MIDI_PORT_ALL : MIDI_PORT_DIN;
+  uint8_t inputs = appConfig.midiInPorts & available;
+  midi_controller.setOutputPorts(appConfig.midiOutPorts & available);
+  midiInput.setInputPorts(inputs ? inputs : MIDI_PORT_DIN);
+  midi_controller.setMidiThru(appConfig.midiThru);
+  dawMonitor.setActiveSensing(appConfig.activeSensing);
+  midiStats.setFrameInterval(appConfig.trafficMonitor ? MIDI_STATS_WINDOW_MS : 0);
+}
+
+void onDawLinkChanged(uint8_t state) {
+  // Sin DAW se congelan los VU y se pausan las peticiones; al volver se
+  // le reenvía el estado de la superficie. La captura "hasta desconexión" se cierra
+  display.setDawLink(state);
+  resync.onDawLinkChanged(state);
+  midiTrace.onDawLinkChanged(state);
+}
+
+void onDisplayYield() {
+  // Redibujados largos: el buffer de Serial se llena en 5 ms a 115200 baudios
+  usbMidi.poll();
+  
+  // El ping HUI tampoco puede esperar al siguiente loop
+  hui.serviceKeepalive();
+  midi_controller.processMidiOutput();
+}
+
 void changeBankSafely(int8_t direction) {
   uint8_t newBank = (systemState.currentBank + direction + NUM_BANKS) % NUM_BANKS;
   if (newBank != systemState.currentBank) {
     systemState.currentBank = newBank;
     appConfig.currentBank = newBank;
     encoders.setCurrentBank(newBank);
-    Serial.print(F("Banco cambiado a: "));
-    Serial.println(newBank + 1);
+    resync.invalidateBank(newBank);
+    debugSerial.print(F("Banco cambiado a: "));
+    debugSerial.println(newBank + 1);
   }
 }
 
@@ -291,10 +455,12 @@ void handleMCP2BInterrupt() { interruptFlags.mcp2B = true; }
 // Funciones de sincronización con DAW
 void syncEncoderColorFromDAW(uint8_t track, uint8_t bank, uint16_t color) {
   encoders.syncFromDAW(track, bank, encoders.getEncoderDAWValue(track, bank), color);
+  resync.onColorReceived(track, bank);
 }
 
 void syncEncoderValueFromDAW(uint8_t track, uint8_t bank, uint8_t value) {
   encoders.setEncoderDAWValue(track, bank, value);
+  resync.onValueReceived(track, bank);
 }
 
 void updateVUMeterLevel(uint8_t track, uint8_t level) {
@@ -303,4 +469,13 @@ void updateVUMeterLevel(uint8_t track, uint8_t level) {
 
 void syncEncoderNameFromDAW(uint8_t track, uint8_t bank, const char* name) {
   encoders.syncNameFromDAW(track, bank, name);
+  resync.onNameReceived(track, bank);
+}
+
+void syncChannelMessageFromDAW(uint8_t channel, uint8_t type, uint8_t number, uint8_t value) {
+  encoders.dispatchDAWMessage(channel, type, number, value);
+}
+
+void syncMixStateFromDAW(uint8_t bank, uint16_t rangeMask, uint16_t mute, uint16_t solo) {
+  encoders.syncMixFromDAW(bank, rangeMask, mute, solo);
 }
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "McuProtocol.h"
+#include "Midi_Controller.h"
+#include "EncoderManager.h"
+
+extern Midi_Controller midi_controller;
+extern EncoderManager encoders;
+
+#define MCU_ENTRY(fn, strip)  (((fn) << 3) | (strip))
+
+// Nota -> (función << 3 | strip). Decodificación de LEDs en O(1).
+static const uint8_t mcuNoteTable[128] PROGMEM = {
+  // 0x00-0x07 Rec arm, 0x08-0x0F Solo
+  MCU_ENTRY(MCU_FN_REC, 0), MCU_ENTRY(MCU_FN_REC, 1), MCU_ENTRY(MCU_FN_REC, 2), MCU_ENTRY(MCU_FN_REC, 3),
+  MCU_ENTRY(MCU_FN_REC, 4), MCU_ENTRY(MCU_FN_REC, 5), MCU_ENTRY(MCU_FN_REC, 6), MCU_ENTRY(MCU_FN_REC, 7),
+  MCU_ENTRY(MCU_FN_SOLO, 0), MCU_ENTRY(MCU_FN_SOLO, 1), MCU_ENTRY(MCU_FN_SOLO, 2), MCU_ENTRY(MCU_FN_SOLO, 3),
+  MCU_ENTRY(MCU_FN_SOLO, 4), MCU_ENTRY(MCU_FN_SOLO, 5), MCU_ENTRY(MCU_FN_SOLO, 6), MCU_ENTRY(MCU_FN_SOLO, 7),
+  // 0x10-0x17 Mute, 0x18-0x1F Select
+  MCU_ENTRY(MCU_FN_MUTE, 0), MCU_ENTRY(MCU_FN_MUTE, 1), MCU_ENTRY(MCU_FN_MUTE, 2), MCU_ENTRY(MCU_FN_MUTE, 3),
+  MCU_ENTRY(MCU_FN_MUTE, 4), MCU_ENTRY(MCU_FN_MUTE, 5), MCU_ENTRY(MCU_FN_MUTE, 6), MCU_ENTRY(MCU_FN_MUTE, 7),
+  MCU_ENTRY(MCU_FN_SELECT, 0), MCU_ENTRY(MCU_FN_SELECT, 1), MCU_ENTRY(MCU_FN_SELECT, 2), MCU_ENTRY(MCU_FN_SELECT, 3),
+  MCU_ENTRY(MCU_FN_SELECT, 4), MCU_ENTRY(MCU_FN_SELECT, 5), MCU_ENTRY(MCU_FN_SELECT, 6), MCU_ENTRY(MCU_FN_SELECT, 7),
+  // 0x20-0x27 V-Pot push, 0x28-0x2D asignación, 0x2E-0x2F Bank
+  MCU_ENTRY(MCU_FN_VPOT_PUSH, 0), MCU_ENTRY(MCU_FN_VPOT_PUSH, 1), MCU_ENTRY(MCU_FN_VPOT_PUSH, 2), MCU_ENTRY(MCU_FN_VPOT_PUSH, 3),
+  MCU_ENTRY(MCU_FN_VPOT_PUSH, 4), MCU_ENTRY(MCU_FN_VPOT_PUSH, 5), MCU_ENTRY(MCU_FN_VPOT_PUSH, 6), MCU_ENTRY(MCU_FN_VPOT_PUSH, 7),
+  0, 0, 0, 0, 0, 0, MCU_ENTRY(MCU_FN_BANK, 0), MCU_ENTRY(MCU_FN_BANK, 1),
+  // 0x30-0x31 Channel, 0x32-0x3F
+  MCU_ENTRY(MCU_FN_CHANNEL, 0), MCU_ENTRY(MCU_FN_CHANNEL, 1), 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  // 0x40-0x57
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  // 0x58-0x5A, 0x5B-0x5F Rewind, Forward, Stop, Play, Record
+  0, 0, 0, MCU_ENTRY(MCU_FN_TRANSPORT, 0), MCU_ENTRY(MCU_FN_TRANSPORT, 1),
+  MCU_ENTRY(MCU_FN_TRANSPORT, 2), MCU_ENTRY(MCU_FN_TRANSPORT, 3), MCU_ENTRY(MCU_FN_TRANSPORT, 4),
+  // 0x60-0x67
+  0, 0, 0, 0, 0, 0, 0, 0,
+  // 0x68-0x6F Fader touch
+  MCU_ENTRY(MCU_FN_FADER_TOUCH, 0), MCU_ENTRY(MCU_FN_FADER_TOUCH, 1), MCU_ENTRY(MCU_FN_FADER_TOUCH, 2), MCU_ENTRY(MCU_FN_FADER_TOUCH, 3),
+  MCU_ENTRY(MCU_FN_FADER_TOUCH, 4), MCU_ENTRY(MCU_FN_FADER_TOUCH, 5), MCU_ENTRY(MCU_FN_FADER_TOUCH, 6), MCU_ENTRY(MCU_FN_FADER_TOUCH, 7),
+  // 0x70-0x7F
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// Transporte: índice de MCU_FN_TRANSPORT (0 = Rewind ... 4 = Record)
+#define MCU_TRANSPORT_STOP    2
+#define MCU_TRANSPORT_PLAY    3
+#define MCU_TRANSPORT_RECORD  4
+
+McuProtocol::McuProtocol()
+  : active(false), sysExIndex(0), sysExDevice(0), sysExCommand(0), lcdPosition(0),
+    faderTouchMask(0), messagesDecoded(0), lcdCharsDecoded(0)
+{
+  memset(timecodeDigits, 0, sizeof(timecodeDigits));
+  memset(lastFaderMove, 0, sizeof(lastFaderMove));
+}
+
+void McuProtocol::setActive(bool enable) {
+  active = enable;
+  // Los medidores MCU llegan como channel pressure
+  midiInput.acceptStatus(0xD0, enable);
+}
+
+// ==================== ENTRADA ====================
+
+void McuProtocol::handleNote(uint8_t note, uint8_t velocity) {
+  uint8_t entry = pgm_read_byte(&mcuNoteTable[note & 0x7F]);
+  uint8_t function = entry >> 3;
+  uint8_t strip = entry & 0x07;
+  bool on = velocity > 0;  // 0x7F encendido, 0x01 parpadeo
+  messagesDecoded++;
+  
+  switch (function) {
+    case MCU_FN_MUTE:
+      encoders.syncMixBitFromDAW(systemState.currentBank, strip, false, on);
+      break;
+    case MCU_FN_SOLO:
+      encoders.syncMixBitFromDAW(systemState.currentBank, strip, true, on);
+      break;
+    case MCU_FN_TRANSPORT: {
+      TransportState transport = midi_controller.getTransportState();
+      if (strip == MCU_TRANSPORT_PLAY) transport.isPlaying = on;
+      else if (strip == MCU_TRANSPORT_RECORD) transport.isRecording = on;
+      else if (strip == MCU_TRANSPORT_STOP && on) transport.isPlaying = false;
+      midi_controller.setTransportState(transport);
+      break;
+    }
+    default:
+      // Rec arm, select, etc.: sin indicador en esta superficie
+      break;
+  }
+}
+
+void McuProtocol::handleControlChange(uint8_t cc, uint8_t value) {
+  messagesDecoded++;
+  
+  if (cc >= MCU_CC_VPOT_RING && cc < MCU_CC_VPOT_RING + MCU_STRIPS) {
+    // Anillo: posición 1-11 en el nibble bajo (0 = apagado)
+    uint8_t position = value & 0x0F;
+    if (position >= 1 && position <= 11) {
+      encoders.setEncoderDAWValue(cc - MCU_CC_VPOT_RING, systemState.currentBank,
+                                  (position - 1) * 127 / 10);
+    }
+  } else if (cc >= MCU_CC_TIMECODE && cc < MCU_CC_TIMECODE + MCU_TIMECODE_DIGITS) {
+    // Carácter de 7 segmentos: 0x30-0x39 son dígitos, bit 6 es el punto
+    uint8_t c = value & 0x3F;
+    timecodeDigits[cc - MCU_CC_TIMECODE] = (c >= 0x30 && c <= 0x39) ? c - 0x30 : 0;
+    updateTimecode();
+  }
+}
+
+void McuProtocol::handlePitchBend(uint8_t channel, uint8_t value) {
+  // Canales 1-8: faders de los strips (encoders 8-15). Canal 9: master, no usado.
+  // El valor ya llega reducido a 7 bits por Midi_Controller
+  if (channel < 1 || channel > MCU_STRIPS) return;
+  messagesDecoded++;
+  encoders.setEncoderDAWValue(MCU_STRIPS + channel - 1, systemState.currentBank, value);
+}
+
+void McuProtocol::handleChannelPressure(uint8_t value) {
+  uint8_t strip = (value >> 4) & 0x07;
+  uint8_t level = value & 0x0F;
+  messagesDecoded++;
+  
+  extern void updateVUMeterLevel(uint8_t track, uint8_t level);
+  if (level <= MCU_METER_MAX) {
+    updateVUMeterLevel(strip, (uint16_t)level * 127 / MCU_METER_MAX);
+  } else if (level == MCU_METER_OVERLOAD) {
+    updateVUMeterLevel(strip, 127);
+  }
+}
+
+void McuProtocol::beginSysEx() {
+  sysExIndex = 0;
+}
+
+void McuProtocol::handleSysExByte(uint8_t data) {
+  // Bytes tras la cabecera 00 00 66: dispositivo, comando y datos
+  switch (sysExIndex) {
+    case 0:
+      sysExDevice = data;
+      break;
+    case 1:
+      sysExCommand = data;
+      break;
+    case 2:
+      lcdPosition = data;
+      break;
+    default:
+      if (sysExCommand == MCU_SYSEX_LCD &&
+          (sysExDevice == MCU_DEVICE_MAIN || sysExDevice == MCU_DEVICE_XT)) {
+        handleLcdChar(lcdPosition++, (char)data);
+      }
+      break;
+  }
+  if (sysExIndex < 0xFF) sysExIndex++;
+}
+
+void McuProtocol::handleLcdChar(uint8_t position, char c) {
+  // Solo la línea superior (nombres); cada strip ocupa 7 caracteres
+  if (position >= MCU_LCD_LINE_LENGTH) return;
+  uint8_t strip = position / MCU_LCD_STRIP_WIDTH;
+  uint8_t column = position % MCU_LCD_STRIP_WIDTH;
+  if (column >= TRACK_NAME_SIZE - 1) return;
+  
+  lcdCharsDecoded++;
+  encoders.setTrackNameChar(strip, systemState.currentBank, column, c);
+  encoders.setTrackNameChar(strip + MCU_STRIPS, systemState.currentBank, column, c);
+}
+
+void McuProtocol::updateTimecode() {
+  // 10 dígitos, de derecha a izquierda: FFF SS MM HHH
+  const uint8_t* d = timecodeDigits;
+  MtcData mtc = midi_controller.getMtcData();
+  mtc.frames = d[1] * 10 + d[0];
+  mtc.seconds = d[4] * 10 + d[3];
+  mtc.minutes = d[6] * 10 + d[5];
+  mtc.hours = d[8] * 10 + d[7];
+  midi_controller.setMtcData(mtc);
+}
+
+// ==================== SALIDA ====================
+
+void McuProtocol::sendVPot(uint8_t strip, int8_t delta) {
+  if (strip >= MCU_STRIPS || delta == 0) return;
+  // Signo-magnitud: 0x01-0x3F horario, 0x41-0x7F antihorario
+  uint8_t magnitude = constrain(abs(delta), 1, 0x3F);
+  uint8_t value = (delta < 0) ? (0x40 | magnitude) : magnitude;
+  midi_controller.sendControlChange(MCU_CHANNEL, MCU_CC_VPOT + strip, value,
+                                    TX_PRIO_USER | TX_NO_COALESCE);
+}
+
+void McuProtocol::sendFader(uint8_t strip, uint8_t value) {
+  if (strip >= MCU_STRIPS) return;
+  
+  // Los DAW ignoran el fader si no está "tocado"
+  uint8_t bit = 1 << strip;
+  if (!(faderTouchMask & bit)) {
+    sendNote(MCU_NOTE_FADER_TOUCH + strip, true);
+    faderTouchMask |= bit;
+  }
+  lastFaderMove[strip] = millis();
+  
+  // 7 bits a 14 bits repitiendo el valor en la parte baja para llegar al tope
+  uint16_t value14 = ((uint16_t)value << 7) | value;
+  midi_controller.sendPitchBend(strip + 1, (int16_t)value14 - 8192);
+}
+
+void McuProtocol::sendStripButton(uint8_t switchIndex, bool pressed) {
+  // Switches 0-7: Mute, 8-15: Solo. El DAW conmuta y devuelve el LED
+  uint8_t strip = switchIndex & 0x07;
+  sendNote((switchIndex < 8 ? MCU_NOTE_MUTE : MCU_NOTE_SOLO) + strip, pressed);
+}
+
+void McuProtocol::sendButton(uint8_t buttonIndex) {
+  uint8_t note;
+  switch (buttonIndex) {
+    case BTN_PLAY: note = MCU_NOTE_PLAY; break;
+    case BTN_STOP: note = MCU_NOTE_STOP; break;
+    case BTN_REC: note = MCU_NOTE_RECORD; break;
+    case BTN_BANK_UP: note = MCU_NOTE_BANK_RIGHT; break;
+    case BTN_BANK_DOWN: note = MCU_NOTE_BANK_LEFT; break;
+    default: return;
+  }
+  // Solo hay evento de pulsación: enviar pulsación y liberación seguidas
+  sendNote(note, true);
+  sendNote(note, false);
+}
+
+void McuProtocol::sendNote(uint8_t note, bool on) {
+  midi_controller.sendNoteOn(MCU_CHANNEL, note, on ? 0x7F : 0x00);
+}
+
+void McuProtocol::update(unsigned long currentTime) {
+  if (!faderTouchMask) return;
+  
+  for (uint8_t strip = 0; strip < MCU_STRIPS; strip++) {
+    uint8_t bit = 1 << strip;
+    if ((faderTouchMask & bit) && currentTime - lastFaderMove[strip] >= MCU_FADER_TOUCH_MS) {
+      sendNote(MCU_NOTE_FADER_TOUCH + strip, false);
+      faderTouchMask &= ~bit;
+    }
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef MCU_PROTOCOL_H
+#define MCU_PROTOCOL_H
+
+#include "Config.h"
+#include "SurfaceProtocol.h"
+#include <Arduino.h>
+
+// ==================== MACKIE CONTROL UNIVERSAL ====================
+#define MCU_STRIPS              SURFACE_STRIPS
+#define MCU_CHANNEL             1       // Botones, V-Pots y timecode van por el canal 1
+
+// Control Change
+#define MCU_CC_VPOT             0x10    // 0x10-0x17: giro de V-Pot (signo en bit 6)
+#define MCU_CC_VPOT_RING        0x30    // 0x30-0x37: anillo de LEDs del V-Pot
+#define MCU_CC_JOG              0x3C
+#define MCU_CC_TIMECODE         0x40    // 0x40-0x49: dígitos, 0x40 el de la derecha
+#define MCU_TIMECODE_DIGITS     10
+
+// Notas de botones
+#define MCU_NOTE_REC            0x00    // 0x00-0x07
+#define MCU_NOTE_SOLO           0x08    // 0x08-0x0F
+#define MCU_NOTE_MUTE           0x10    // 0x10-0x17
+#define MCU_NOTE_SELECT         0x18    // 0x18-0x1F
+#define MCU_NOTE_VPOT_PUSH      0x20    // 0x20-0x27
+#define MCU_NOTE_BANK_LEFT      0x2E
+#define MCU_NOTE_BANK_RIGHT     0x2F
+#define MCU_NOTE_CHANNEL_LEFT   0x30
+#define MCU_NOTE_CHANNEL_RIGHT  0x31
+#define MCU_NOTE_REWIND         0x5B
+#define MCU_NOTE_FORWARD        0x5C
+#define MCU_NOTE_STOP           0x5D
+#define MCU_NOTE_PLAY           0x5E
+#define MCU_NOTE_RECORD         0x5F
+#define MCU_NOTE_FADER_TOUCH    0x68    // 0x68-0x6F
+
+// SysEx: F0 00 00 66 [dispositivo] [comando] ... F7
+#define MCU_DEVICE_MAIN         0x14
+#define MCU_DEVICE_XT           0x15
+#define MCU_SYSEX_LCD           0x12    // [offset] [caracteres...]
+#define MCU_LCD_STRIP_WIDTH     7
+#define MCU_LCD_LINE_LENGTH     56
+
+// Medidores por channel pressure: [strip:3][nivel:4]
+#define MCU_METER_MAX           0x0C
+#define MCU_METER_OVERLOAD      0x0E
+
+#define MCU_FADER_TOUCH_MS      300     // Sin movimiento: soltar el touch del fader
+
+// Función de cada nota (tabla en PROGMEM)
+enum McuFunction {
+  MCU_FN_NONE = 0,
+  MCU_FN_REC,
+  MCU_FN_SOLO,
+  MCU_FN_MUTE,
+  MCU_FN_SELECT,
+  MCU_FN_VPOT_PUSH,
+  MCU_FN_BANK,
+  MCU_FN_CHANNEL,
+  MCU_FN_TRANSPORT,
+  MCU_FN_FADER_TOUCH
+};
+
+class McuProtocol : public SurfaceProtocol {
+private:
+  bool active;
+  
+  // Decodificación SysEx en curso
+  uint8_t sysExIndex;
+  uint8_t sysExDevice;
+  uint8_t sysExCommand;
+  uint8_t lcdPosition;
+  
+  // Timecode
+  uint8_t timecodeDigits[MCU_TIMECODE_DIGITS];
+  
+  // Touch de los faders (encoders 8-15)
+  uint8_t faderTouchMask;
+  unsigned long lastFaderMove[MCU_STRIPS];
+  
+  // Estadísticas
+  uint32_t messagesDecoded;
+  uint32_t lcdCharsDecoded;
+  
+  void handleLcdChar(uint8_t position, char c);
+  void updateTimecode();
+  void sendNote(uint8_t note, bool on);
+
+public:
+  McuProtocol();
+  
+  void setActive(bool enable) override;
+  bool isActive() const { return active; }
+  
+  // Liberar el touch de faders inactivos (llamar desde loop)
+  void update(unsigned long currentTime) override;
+  
+  // Entrada desde el DAW
+  void handleNote(uint8_t note, uint8_t velocity) override;
+  void handleControlChange(uint8_t cc, uint8_t value) override;
+  void handlePitchBend(uint8_t channel, uint8_t value) override;
+  void handleChannelPressure(uint8_t value) override;
+  void beginSysEx() override;
+  void handleSysExByte(uint8_t data) override;
+  
+  // Salida hacia el DAW
+  void sendVPot(uint8_t strip, int8_t delta) override;
+  void sendFader(uint8_t strip, uint8_t value) override;
+  void sendStripButton(uint8_t switchIndex, bool pressed) override;
+  void sendButton(uint8_t buttonIndex) override;
+  
+  // Diagnóstico
+  uint32_t getMessagesDecoded() const { return messagesDecoded; }
+  uint32_t getLcdCharsDecoded() const { return lcdCharsDecoded; }
+};
+
+#endif // MCU_PROTOCOL_H
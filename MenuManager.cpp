@@ -1,9 +1,12 @@
 #include "MenuManager.h"
+#include "UsbMidiPort.h"
 #include "Strings.h"
 #include "Midi_Controller.h"
 #include "EncoderManager.h"
 #include "FileManager.h"
 #include "HardwareManager.h"
+#include "ResyncManager.h"
+#include "MidiTrace.h"
 
 #define MENU_START_Y 50
 #define MENU_ITEM_HEIGHT 30
@@ -12,6 +15,7 @@ extern Midi_Controller midi_controller;
 extern EncoderManager encoders;
 extern FileManager fileSystem;
 extern HardwareManager hardware;
+extern ResyncManager resync;
 extern DisplayManager display;
 
 MenuManager* MenuManager::instance = nullptr;
@@ -19,6 +23,13 @@ MenuManager* MenuManager::instance = nullptr;
 const char* const MenuManager::orientationOptions[4] = {"0°", "90°", "180°", "270°"};
 const char* const MenuManager::timeoutOptions[6] = {"Off", "1min", "5min", "10min", "30min", "60min"};
 const char* const MenuManager::controlTypeOptions[3] = {"CC", "Note", "Pitch"};
+const char* const MenuManager::outputModeOptions[7] = {"Absoluto", "Rel 2C", "Rel Off64", "Rel S/M", "V-Pot", "14b CC", "14b NRPN"};
+const char* const MenuManager::protocolOptions[3] = {"Studio One", "Mackie MCU", "HUI"};
+const char* const MenuManager::timeDisplayOptions[3] = {"MTC", "Compases", "MTC+Compases"};
+const char* const MenuManager::masterModeOptions[4] = {"Off", "Clock", "MTC", "Clock+MTC"};
+const char* const MenuManager::masterRateOptions[4] = {"24", "25", "29.97DF", "30"};
+const char* const MenuManager::portOptions[3] = {"DIN", "USB", "DIN+USB"};
+const char* const MenuManager::traceModeOptions[3] = {"Off", "Manual", "Hasta desc."};
 const char* const MenuManager::encoderSelectOptions[16] = {
   "Enc 1", "Enc 2", "Enc 3", "Enc 4", "Enc 5", "Enc 6", "Enc 7", "Enc 8",
   "Enc 9", "Enc 10", "Enc 11", "Enc 12", "Enc 13", "Enc 14", "Enc 15", "Enc 16"
@@ -41,6 +52,7 @@ MenuManager::MenuManager()
         MenuItem{"Seleccionar Encoder", actionSelectEncoder, MENU_OPTION, &tempEncoderIndex, 0, 15, encoderSelectOptions, 16, true, true},
         MenuItem{"Modo Vol/Pan", actionToggleEncoderMode, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
         MenuItem{"Tipo Control", actionSetControlType, MENU_OPTION, nullptr, 0, 2, controlTypeOptions, 3, true, true},
+        MenuItem{"Modo Salida", actionSetOutputMode, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
         MenuItem{"Canal MIDI", actionSetMidiChannel, MENU_INTEGER, nullptr, 1, 16, nullptr, 0, true, true},
         MenuItem{"Numero Control", actionSetControlNumber, MENU_INTEGER, nullptr, 0, 127, nullptr, 0, true, true},
         MenuItem{"Ajustar Rango", actionSetEncoderRange, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
@@ -60,6 +72,19 @@ MenuManager::MenuManager()
         MenuItem{"Offset MTC", actionSetMtcOffset, MENU_INTEGER, &tempMtcOffset, -30, 30, nullptr, 0, true, true},
         MenuItem{"Test MIDI", actionTestMidi, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
         MenuItem{"Reset MIDI", actionResetMidi, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Enviar Estado", actionPushSurface, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Protocolo", actionSetProtocol, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Mostrar Tiempo", actionSetTimeDisplay, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Maestro", actionSetMasterMode, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Tempo Maestro", actionSetMasterTempo, MENU_INTEGER, &tempMasterTempo, 30, 300, nullptr, 0, true, true},
+        MenuItem{"FPS Maestro", actionSetMasterRate, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Puerto USB", actionToggleUsbMidi, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Salida MIDI", actionSetOutputPorts, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Entrada MIDI", actionSetInputPorts, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"MIDI Thru", actionToggleMidiThru, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Active Sensing", actionToggleActiveSensing, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Monitor Trafico", actionToggleTrafficMonitor, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
+        MenuItem{"Captura MIDI", actionSetMidiTrace, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true},
         MenuItem{"Volver", actionBackMenu, MENU_ACTION, nullptr, 0, 0, nullptr, 0, true, true}
     },
     globalMenu{
@@ -79,6 +104,7 @@ MenuManager::MenuManager()
   tempBrightness = 100;
   tempMidiChannel = 1;
   tempMtcOffset = 0;
+  tempMasterTempo = 120;
   tempScreensaverTimeout = 2;
   tempOrientation = 3;
 }
@@ -88,13 +114,13 @@ MenuManager::~MenuManager() {
 }
 
 bool MenuManager::initialize(AppConfig* config, SystemState* state) {
-  Serial.println(F("Inicializando sistema de menús..."));
+  debugSerial.println(F("Inicializando sistema de menús..."));
   
   appConfig = config;
   systemState = state;
   refreshFromConfig();
   
-  Serial.println(F("Sistema de menús inicializado"));
+  debugSerial.println(F("Sistema de menús inicializado"));
   return true;
 }
 
@@ -106,7 +132,7 @@ void MenuManager::enter() {
   scrollOffset = 0;
   editingValue = false;
   
-  Serial.println(F("Menú activado"));
+  debugSerial.println(F("Menú activado"));
 }
 
 void MenuManager::exit() {
@@ -119,7 +145,7 @@ void MenuManager::exit() {
   currentMenuLevel = 0;
   onMenuExit();
   
-  Serial.println(F("Menú desactivado"));
+  debugSerial.println(F("Menú desactivado"));
 }
 
 void MenuManager::navigate(int8_t direction) {
@@ -343,14 +369,14 @@ void MenuManager::startValueEdit() {
   if (!item.valuePtr) return;
   
   editingValue = true;
-  Serial.print(F("Editando: "));
-  Serial.println(item.name);
+  debugSerial.print(F("Editando: "));
+  debugSerial.println(item.name);
 }
 
 void MenuManager::stopValueEdit() {
   editingValue = false;
   applyTempValues();
-  Serial.println(F("Edición terminada"));
+  debugSerial.println(F("Edición terminada"));
 }
 
 void MenuManager::changeValue(int8_t change) {
@@ -393,12 +419,16 @@ void MenuManager::applyTempValues() {
   appConfig->brightness = tempBrightness;
   appConfig->midiChannel = tempMidiChannel;
   appConfig->mtcOffset = tempMtcOffset;
+  if (appConfig->masterTempoX10 / 10 != tempMasterTempo) {
+    appConfig->masterTempoX10 = tempMasterTempo * 10;
+    applyTimingMaster();
+  }
   appConfig->orientation = (DisplayOrientation)tempOrientation;
   
   uint32_t timeouts[] = {0, 60000, 300000, 600000, 1800000, 3600000};
   appConfig->screensaverTimeout = timeouts[constrainValue(tempScreensaverTimeout, 0, 5)];
   
-  Serial.println(F("Configuración aplicada"));
+  debugSerial.println(F("Configuración aplicada"));
 }
 
 void MenuManager::refreshFromConfig() {
@@ -407,6 +437,7 @@ void MenuManager::refreshFromConfig() {
   tempBrightness = appConfig->brightness;
   tempMidiChannel = appConfig->midiChannel;
   tempMtcOffset = appConfig->mtcOffset;
+  tempMasterTempo = appConfig->masterTempoX10 / 10;
   tempOrientation = (int16_t)appConfig->orientation;
   
   uint32_t timeout = appConfig->screensaverTimeout;
@@ -432,9 +463,9 @@ MenuItem* MenuManager::getCurrentMenu() {
 uint8_t MenuManager::getCurrentMenuSize() {
   switch (currentMenuType[currentMenuLevel]) {
     case MenuType::MAIN_MENU: return 6;
-    case MenuType::ENCODER_SETTINGS: return 8;
+    case MenuType::ENCODER_SETTINGS: return 9;
     case MenuType::DISPLAY_SETTINGS: return 5;
-    case MenuType::MIDI_SETTINGS: return 6;
+    case MenuType::MIDI_SETTINGS: return 19;
     case MenuType::SYSTEM_SETTINGS: return 7;
     default: return 0;
   }
@@ -491,7 +522,7 @@ void MenuManager::showConfirmDialog(const char* message, void (*onConfirm)()) {
 void MenuManager::onMenuExit() {
   if (!instance) return;
   
-  Serial.println(F("=== RESTAURANDO ESTADO DESPUÉS DEL MENÚ ==="));
+  debugSerial.println(F("=== RESTAURANDO ESTADO DESPUÉS DEL MENÚ ==="));
   
   display.forceFullRedraw();
   
@@ -503,46 +534,46 @@ void MenuManager::onMenuExit() {
   
   uint8_t currentBank = instance->systemState ? instance->systemState->currentBank : 0;
   
-  Serial.print(F("Sincronizando banco actual: "));
-  Serial.println(currentBank + 1);
+  debugSerial.print(F("Sincronizando banco actual: "));
+  debugSerial.println(currentBank + 1);
+  
+  // Colores, nombres y valores del banco: una petición en bloque del resync
+  resync.invalidateBank(currentBank);
   
   for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
     EncoderConfig config = encoders.getEncoderConfig(i, currentBank);
     
-    midi_controller.sendStudioOneValueRequest(i, currentBank);
-    midi_controller.sendStudioOneColorRequest(i, currentBank);
-    
     if (config.controlType == CT_CC) {
       midi_controller.sendControlChange(config.channel, config.control, config.value);
     }
     
-    Serial.print(F("Encoder "));
-    Serial.print(i + 1);
-    Serial.print(F(" - Canal: "));
-    Serial.print(config.channel);
-    Serial.print(F(" CC: "));
-    Serial.print(config.control);
-    Serial.print(F(" Valor: "));
-    Serial.println(config.value);
+    debugSerial.print(F("Encoder "));
+    debugSerial.print(i + 1);
+    debugSerial.print(F(" - Canal: "));
+    debugSerial.print(config.channel);
+    debugSerial.print(F(" CC: "));
+    debugSerial.print(config.control);
+    debugSerial.print(F(" Valor: "));
+    debugSerial.println(config.value);
     
     if (i % 4 == 0) {
       delay(10);
     }
   }
   
-  Serial.println(F("Solicitando estado MTC actual..."));
+  debugSerial.println(F("Solicitando estado MTC actual..."));
   uint8_t mtcRequest[] = {0xF0, 0x7F, 0x7F, 0x06, 0x01, 0xF7};
   midi_controller.sendCustomSysEx(mtcRequest, sizeof(mtcRequest));
   
-  Serial.println(F("Solicitando estado de transporte..."));
+  debugSerial.println(F("Solicitando estado de transporte..."));
   uint8_t transportRequest[] = {0xF0, 0x7F, 0x7F, 0x06, 0x02, 0xF7};
   midi_controller.sendCustomSysEx(transportRequest, sizeof(transportRequest));
   
   if (instance->appConfig) {
     display.setBrightness(instance->appConfig->brightness);
-    Serial.print(F("Brillo restaurado a: "));
-    Serial.print(instance->appConfig->brightness);
-    Serial.println(F("%"));
+    debugSerial.print(F("Brillo restaurado a: "));
+    debugSerial.print(instance->appConfig->brightness);
+    debugSerial.println(F("%"));
   }
   
   display.clearScreen(COLOR_BLACK);
@@ -550,13 +581,15 @@ void MenuManager::onMenuExit() {
                           TFT_WIDTH/2 - 150, TFT_HEIGHT/2 - 20, 
                           300, 40, COLOR_CYAN, FONT_SIZE_MEDIUM);
   
-  Serial.println(F("Actualizando visualización de encoders..."));
+  debugSerial.println(F("Actualizando visualización de encoders..."));
   
   MtcData mtc = midi_controller.getMtcData();
   TransportState transport = midi_controller.getTransportState();
   
   display.drawMainScreen(encoders.getEncoderBanks()[currentBank], 
-                        mtc, currentBank, transport);
+                        mtc, midi_controller.getClockData(), currentBank, transport,
+                        encoders.getMixState(currentBank),
+                        encoders.getImpliedMuteMask(currentBank));
   
   if (instance->systemState) {
     instance->systemState->lastActivityTime = millis();
@@ -564,29 +597,29 @@ void MenuManager::onMenuExit() {
     instance->systemState->lastPollTime = millis();
   }
   
-  Serial.println(F("Verificando conexión MIDI..."));
+  debugSerial.println(F("Verificando conexión MIDI..."));
   if (midi_controller.getMessagesReceived() == 0) {
-    Serial.println(F("ADVERTENCIA: No se detecta actividad MIDI"));
+    debugSerial.println(F("ADVERTENCIA: No se detecta actividad MIDI"));
     display.drawMessage("Verificar conexión MIDI");
     delay(1000);
   }
   
-  Serial.println(F("=== ESTADO RESTAURADO EXITOSAMENTE ==="));
-  Serial.print(F("Tiempo MTC: "));
-  Serial.print(mtc.hours);
-  Serial.print(F(":"));
-  Serial.print(mtc.minutes);
-  Serial.print(F(":"));
-  Serial.print(mtc.seconds);
-  Serial.print(F(":"));
-  Serial.println(mtc.frames);
-  
-  Serial.print(F("Transporte: "));
-  if (transport.isPlaying) Serial.print(F("Play "));
-  if (transport.isRecording) Serial.print(F("Rec "));
-  if (transport.isPaused) Serial.print(F("Pause"));
-  if (!transport.isPlaying && !transport.isRecording) Serial.print(F("Stop"));
-  Serial.println();
+  debugSerial.println(F("=== ESTADO RESTAURADO EXITOSAMENTE ==="));
+  debugSerial.print(F("Tiempo MTC: "));
+  debugSerial.print(mtc.hours);
+  debugSerial.print(F(":"));
+  debugSerial.print(mtc.minutes);
+  debugSerial.print(F(":"));
+  debugSerial.print(mtc.seconds);
+  debugSerial.print(F(":"));
+  debugSerial.println(mtc.frames);
+  
+  debugSerial.print(F("Transporte: "));
+  if (transport.isPlaying) debugSerial.print(F("Play "));
+  if (transport.isRecording) debugSerial.print(F("Rec "));
+  if (transport.isPaused) debugSerial.print(F("Pause"));
+  if (!transport.isPlaying && !transport.isRecording) debugSerial.print(F("Stop"));
+  debugSerial.println();
   
   for (int i = 0; i < 3; i++) {
     display.fillRect(TFT_WIDTH - 20, 10, 10, 10, i % 2 ? COLOR_GREEN : COLOR_BLACK);
@@ -594,7 +627,7 @@ void MenuManager::onMenuExit() {
   }
   
   display.forceFullRedraw();
-  Serial.println(F("Sistema listo para controlar"));
+  debugSerial.println(F("Sistema listo para controlar"));
 }
 // Agregar estas funciones al final de MenuManager.cpp
 
@@ -674,7 +707,7 @@ void MenuManager::actionEnterGlobalMenu() {
 void MenuManager::actionSystemTest() {
   if (!instance) return;
   
-  Serial.println(F("Ejecutando test del sistema..."));
+  debugSerial.println(F("Ejecutando test del sistema..."));
   
   // Test de pantalla
   display.runDisplayTest();
@@ -697,8 +730,12 @@ void MenuManager::actionSystemTest() {
   } else {
     instance->showMessage("Test SD: ERROR", 3000);
   }
-  
-  Serial.println(F("Test del sistema completado"));
+
+  // Volcado de diagnóstico por el puerto de depuración
+  midi_controller.printMidiStatistics();
+  resync.printStatistics();
+
+  debugSerial.println(F("Test del sistema completado"));
 }
 
 void MenuManager::actionExitMenu() {
@@ -711,8 +748,8 @@ void MenuManager::actionExitMenu() {
 void MenuManager::actionSelectEncoder() {
   if (!instance) return;
   // La selección se maneja automáticamente por el sistema de menú
-  Serial.print(F("Encoder seleccionado: "));
-  Serial.println(instance->tempEncoderIndex + 1);
+  debugSerial.print(F("Encoder seleccionado: "));
+  debugSerial.println(instance->tempEncoderIndex + 1);
 }
 
 void MenuManager::actionToggleEncoderMode() {
@@ -726,10 +763,10 @@ void MenuManager::actionToggleEncoderMode() {
   
   instance->showMessage(config.isPan ? "Modo: Pan" : "Modo: Volumen", 1500);
   
-  Serial.print(F("Encoder "));
-  Serial.print(encIndex + 1);
-  Serial.print(F(" cambiado a modo: "));
-  Serial.println(config.isPan ? F("Pan") : F("Volumen"));
+  debugSerial.print(F("Encoder "));
+  debugSerial.print(encIndex + 1);
+  debugSerial.print(F(" cambiado a modo: "));
+  debugSerial.println(config.isPan ? F("Pan") : F("Volumen"));
 }
 
 void MenuManager::actionSetControlType() {
@@ -757,6 +794,22 @@ void MenuManager::actionSetControlType() {
   }
 }
 
+void MenuManager::actionSetOutputMode() {
+  if (!instance) return;
+  
+  uint8_t encIndex = instance->tempEncoderIndex;
+  uint8_t bank = instance->systemState ? instance->systemState->currentBank : 0;
+  
+  EncoderConfig& config = encoders.getEncoderConfigMutable(encIndex, bank);
+  
+  // Rotar entre absoluto, los formatos relativos y los de 14 bits
+  config.outputMode = (config.outputMode + 1) % 7;
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Salida: %s", outputModeOptions[config.outputMode]);
+  instance->showMessage(msg, 1500);
+}
+
 void MenuManager::actionSetMidiChannel() {
   if (!instance) return;
   
@@ -821,9 +874,9 @@ void MenuManager::actionResetEncoder() {
   encoders.resetEncoderConfig(encIndex, bank);
   instance->showMessage("Encoder reseteado", 1500);
   
-  Serial.print(F("Encoder "));
-  Serial.print(encIndex + 1);
-  Serial.println(F(" reseteado a valores por defecto"));
+  debugSerial.print(F("Encoder "));
+  debugSerial.print(encIndex + 1);
+  debugSerial.println(F(" reseteado a valores por defecto"));
 }
 
 void MenuManager::actionBackMenu() {
@@ -923,6 +976,153 @@ void MenuManager::actionTestMidi() {
   instance->showMessage("Test MIDI enviado", 2000);
 }
 
+void MenuManager::actionPushSurface() {
+  if (!instance) return;
+  
+  uint8_t currentBank = instance->systemState ? instance->systemState->currentBank : 0;
+  resync.startPush(currentBank);
+  instance->showMessage("Enviando estado al DAW", 1500);
+}
+
+void MenuManager::actionSetProtocol() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->protocolMode = (config->protocolMode + 1) % 3;
+  applyProtocolMode();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Protocolo: %s", protocolOptions[config->protocolMode]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionSetTimeDisplay() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->timeDisplay = (config->timeDisplay + 1) % 3;
+  display.forceFullRedraw();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Tiempo: %s", timeDisplayOptions[config->timeDisplay]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionSetMasterMode() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->masterMode = (config->masterMode + 1) % 4;
+  applyTimingMaster();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Maestro: %s", masterModeOptions[config->masterMode]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionSetMasterTempo() {
+  if (!instance) return;
+  
+  instance->appConfig->masterTempoX10 = instance->tempMasterTempo * 10;
+  applyTimingMaster();
+  
+  char msg[32];
+  snprintf(msg, sizeof(msg), "Tempo: %d BPM", instance->tempMasterTempo);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionSetMasterRate() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->masterRate = (config->masterRate + 1) % 4;
+  applyTimingMaster();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "FPS maestro: %s", masterRateOptions[config->masterRate]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionToggleUsbMidi() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->usbMidi = !config->usbMidi;
+  applyMidiPorts();
+  
+  instance->showMessage(config->usbMidi ? "USB: MIDI" : "USB: Depuracion", 1500);
+}
+
+void MenuManager::actionSetOutputPorts() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->midiOutPorts = (config->midiOutPorts % MIDI_PORT_ALL) + 1;  // 1, 2, 3
+  applyMidiPorts();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Salida: %s", portOptions[config->midiOutPorts - 1]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionSetInputPorts() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->midiInPorts = (config->midiInPorts % MIDI_PORT_ALL) + 1;
+  applyMidiPorts();
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Entrada: %s", portOptions[config->midiInPorts - 1]);
+  instance->showMessage(msg, 1500);
+}
+
+void MenuManager::actionToggleMidiThru() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->midiThru = !config->midiThru;
+  applyMidiPorts();
+  
+  instance->showMessage(config->midiThru ? "Thru: ON" : "Thru: OFF", 1500);
+}
+
+void MenuManager::actionToggleActiveSensing() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->activeSensing = !config->activeSensing;
+  applyMidiPorts();
+  
+  instance->showMessage(config->activeSensing ? "Active Sensing: ON" : "Active Sensing: OFF", 1500);
+}
+
+void MenuManager::actionToggleTrafficMonitor() {
+  if (!instance) return;
+  
+  AppConfig* config = instance->appConfig;
+  config->trafficMonitor = !config->trafficMonitor;
+  applyMidiPorts();
+  
+  // La trama sale por Serial: con el puerto USB en modo MIDI no se ve
+  instance->showMessage(config->trafficMonitor ? "Monitor: ON" : "Monitor: OFF", 1500);
+}
+
+void MenuManager::actionSetMidiTrace() {
+  if (!instance) return;
+  
+  // Solo en tiempo de ejecución: una captura no debe arrancar sola al encender
+  uint8_t mode = (midiTrace.getMode() + 1) % TRACE_MODE_COUNT;
+  if (!midiTrace.start(mode)) {
+    instance->showMessage("Captura: sin SD", 1500);
+    return;
+  }
+  
+  static char msg[24];
+  snprintf(msg, sizeof(msg), "Captura: %s", traceModeOptions[mode]);
+  instance->showMessage(msg, 1500);
+}
+
 void MenuManager::actionResetMidi() {
   if (!instance) return;
   
@@ -939,7 +1139,7 @@ void MenuManager::actionResetMidi() {
     instance->tempMtcOffset = 0;
     
     instance->showMessage("MIDI reseteado", 2000);
-    Serial.println(F("Configuración MIDI reseteada"));
+    debugSerial.println(F("Configuración MIDI reseteada"));
   });*/
 }
 
@@ -952,10 +1152,10 @@ void MenuManager::actionSaveConfig() {
   
   if (fileSystem.saveConfiguration(*instance->appConfig, encoders.getEncoderBanks())) {
     instance->showMessage("Configuración guardada", 2000);
-    Serial.println(F("Configuración guardada exitosamente"));
+    debugSerial.println(F("Configuración guardada exitosamente"));
   } else {
     instance->showMessage("Error al guardar", 3000);
-    Serial.println(F("ERROR: No se pudo guardar configuración"));
+    debugSerial.println(F("ERROR: No se pudo guardar configuración"));
   }
 }
 
@@ -968,12 +1168,16 @@ void MenuManager::actionLoadConfig() {
     instance->showMessage("Cargando...", 1000);
     
     if (fileSystem.loadConfiguration(*instance->appConfig, encoders.getEncoderBanks())) {
+      encoders.invalidateDispatchIndex();
+      applyProtocolMode();
+      applyTimingMaster();
+      applyMidiPorts();
       instance->refreshFromConfig();
       instance->showMessage("Configuración cargada", 2000);
-      Serial.println(F("Configuración cargada exitosamente"));
+      debugSerial.println(F("Configuración cargada exitosamente"));
     } else {
       instance->showMessage("Error al cargar", 3000);
-      Serial.println(F("ERROR: No se pudo cargar configuración"));
+      debugSerial.println(F("ERROR: No se pudo cargar configuración"));
     }
   });
 }
@@ -996,7 +1200,7 @@ void MenuManager::actionResetConfiguration() {
     instance->refreshFromConfig();
     
     instance->showMessage("Sistema reseteado", 3000);
-    Serial.println(F("Sistema completamente reseteado"));
+    debugSerial.println(F("Sistema completamente reseteado"));
   });*/
 }
 
@@ -1014,9 +1218,9 @@ void MenuManager::actionSaveBank() {
     char msg[32];
     snprintf(msg, sizeof(msg), "Banco %d guardado", currentBank + 1);
     instance->showMessage(msg, 2000);
-    Serial.print(F("Banco "));
-    Serial.print(currentBank + 1);
-    Serial.println(F(" guardado como preset"));
+    debugSerial.print(F("Banco "));
+    debugSerial.print(currentBank + 1);
+    debugSerial.println(F(" guardado como preset"));
   } else {
     instance->showMessage("Error guardando banco", 3000);
   }
@@ -1039,11 +1243,12 @@ void MenuManager::actionLoadBank() {
     instance->showMessage("Cargando banco...", 1000);
     
     if (fileSystem.loadPreset(presetName, encoders.getEncoderBanks())) {
+      encoders.invalidateDispatchIndex();
       char msg[32];
       snprintf(msg, sizeof(msg), "Banco %d cargado", currentBank + 1);
       instance->showMessage(msg, 2000);
-      Serial.print(F("Preset cargado en banco "));
-      Serial.println(currentBank + 1);
+      debugSerial.print(F("Preset cargado en banco "));
+      debugSerial.println(currentBank + 1);
     } else {
       instance->showMessage("Preset no encontrado", 3000);
     }
@@ -1063,10 +1268,10 @@ void MenuManager::actionCalibrateMcp() {
     
     if (hardware.testAllMCPs()) {
       instance->showMessage("Calibración exitosa", 2000);
-      Serial.println(F("Calibración de MCPs completada"));
+      debugSerial.println(F("Calibración de MCPs completada"));
     } else {
       instance->showMessage("Error en calibración", 3000);
-      Serial.println(F("ERROR: Falló calibración de MCPs"));
+      debugSerial.println(F("ERROR: Falló calibración de MCPs"));
     }
   });*/
 }
@@ -1090,11 +1295,12 @@ void MenuManager::executeEncoderMenuAction(uint8_t actionIndex) {
     case 0: actionSelectEncoder(); break;
     case 1: actionToggleEncoderMode(); break;
     case 2: actionSetControlType(); break;
-    case 3: actionSetMidiChannel(); break;
-    case 4: actionSetControlNumber(); break;
-    case 5: actionSetEncoderRange(); break;
-    case 6: actionResetEncoder(); break;
-    case 7: actionBackMenu(); break;
+    case 3: actionSetOutputMode(); break;
+    case 4: actionSetMidiChannel(); break;
+    case 5: actionSetControlNumber(); break;
+    case 6: actionSetEncoderRange(); break;
+    case 7: actionResetEncoder(); break;
+    case 8: actionBackMenu(); break;
     default: break;
   }
 }
@@ -1117,7 +1323,20 @@ void MenuManager::executeMidiMenuAction(uint8_t actionIndex) {
     case 2: actionSetMtcOffset(); break;
     case 3: actionTestMidi(); break;
     case 4: actionResetMidi(); break;
-    case 5: actionBackMenu(); break;
+    case 5: actionPushSurface(); break;
+    case 6: actionSetProtocol(); break;
+    case 7: actionSetTimeDisplay(); break;
+    case 8: actionSetMasterMode(); break;
+    case 9: actionSetMasterTempo(); break;
+    case 10: actionSetMasterRate(); break;
+    case 11: actionToggleUsbMidi(); break;
+    case 12: actionSetOutputPorts(); break;
+    case 13: actionSetInputPorts(); break;
+    case 14: actionToggleMidiThru(); break;
+    case 15: actionToggleActiveSensing(); break;
+    case 16: actionToggleTrafficMonitor(); break;
+    case 17: actionSetMidiTrace(); break;
+    case 18: actionBackMenu(); break;
     default: break;
   }
 }
@@ -1147,7 +1366,7 @@ void MenuManager::confirmResetMidiCallback() {
   instance->tempMtcOffset = 0;
   
   instance->showMessage("MIDI reseteado", 2000);
-  Serial.println(F("Configuración MIDI reseteada"));
+  debugSerial.println(F("Configuración MIDI reseteada"));
 }
 
 void MenuManager::confirmResetConfigCallback() {
@@ -1159,10 +1378,13 @@ void MenuManager::confirmResetConfigCallback() {
   encoders.resetAllBanks();
   
   *instance->appConfig = AppConfig();
+  applyProtocolMode();
+  applyTimingMaster();
+  applyMidiPorts();
   instance->refreshFromConfig();
   
   instance->showMessage("Sistema reseteado", 3000);
-  Serial.println(F("Sistema completamente reseteado"));
+  debugSerial.println(F("Sistema completamente reseteado"));
 }
 
 void MenuManager::confirmCalibrateMcpCallback() {
@@ -1173,10 +1395,10 @@ void MenuManager::confirmCalibrateMcpCallback() {
   
   if (hardware.testAllMCPs()) {
     instance->showMessage("Calibración exitosa", 2000);
-    Serial.println(F("Calibración de MCPs completada"));
+    debugSerial.println(F("Calibración de MCPs completada"));
   } else {
     instance->showMessage("Error en calibración", 3000);
-    Serial.println(F("ERROR: Falló calibración de MCPs"));
+    debugSerial.println(F("ERROR: Falló calibración de MCPs"));
   }
 }
 // Añade esta función estática al final de MenuManager.cpp
@@ -1190,11 +1412,12 @@ void MenuManager::confirmLoadBankCallback() {
   instance->showMessage("Cargando banco...", 1000);
   
   if (fileSystem.loadPreset(presetName, encoders.getEncoderBanks())) {
+    encoders.invalidateDispatchIndex();
     char msg[32];
     snprintf(msg, sizeof(msg), "Banco %d cargado", currentBank + 1);
     instance->showMessage(msg, 2000);
-    Serial.print(F("Preset cargado en banco "));
-    Serial.println(currentBank + 1);
+    debugSerial.print(F("Preset cargado en banco "));
+    debugSerial.println(currentBank + 1);
   } else {
     instance->showMessage("Preset no encontrado", 3000);
   }
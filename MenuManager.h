@@ -35,6 +35,13 @@ public:
   static const char* const orientationOptions[4];
   static const char* const timeoutOptions[6];
   static const char* const controlTypeOptions[3];
+  static const char* const outputModeOptions[7];
+  static const char* const protocolOptions[3];
+  static const char* const timeDisplayOptions[3];
+  static const char* const masterModeOptions[4];
+  static const char* const masterRateOptions[4];
+  static const char* const portOptions[3];
+  static const char* const traceModeOptions[3];
   static const char* const encoderSelectOptions[16];
   
   MenuManager();
@@ -68,6 +75,7 @@ public:
   static void actionCalibrateMcp();
   
   static void actionSetControlType();
+  static void actionSetOutputMode();
   static void actionSetMidiChannel();
   static void actionSetControlNumber();
   static void actionResetEncoder();
@@ -79,6 +87,19 @@ public:
   static void actionToggleEncoderAccel();
   static void actionSetMtcOffset();
   static void actionResetMidi();
+  static void actionPushSurface();
+  static void actionSetProtocol();
+  static void actionSetTimeDisplay();
+  static void actionSetMasterMode();
+  static void actionSetMasterTempo();
+  static void actionSetMasterRate();
+  static void actionToggleUsbMidi();
+  static void actionSetOutputPorts();
+  static void actionSetInputPorts();
+  static void actionToggleMidiThru();
+  static void actionToggleActiveSensing();
+  static void actionToggleTrafficMonitor();
+  static void actionSetMidiTrace();
   static void actionSaveConfig();
   static void actionLoadConfig();
   static void actionSystemTest();
@@ -86,9 +107,9 @@ public:
 
 private:
   MenuItem mainMenu[6];
-  MenuItem encoderMenu[8];
+  MenuItem encoderMenu[9];
   MenuItem displayMenu[5];
-  MenuItem midiMenu[6];
+  MenuItem midiMenu[19];
   MenuItem globalMenu[7];
   
   bool menuActive;
@@ -104,6 +125,7 @@ private:
   int16_t tempBrightness;
   int16_t tempMidiChannel;
   int16_t tempMtcOffset;
+  int16_t tempMasterTempo;
   int16_t tempScreensaverTimeout;
   int16_t tempOrientation;
   
@@ -0,0 +1,217 @@
+#include "MidiInputStream.h"
+#include "UsbMidiPort.h"
+#include "Midi_Controller.h"
+#include "MidiThru.h"
+#include "MidiStats.h"
+#include "MidiTrace.h"
+
+MidiInputStream midiInput;
+
+MidiInputStream::MidiInputStream()
+  : sysExSink(nullptr), thruSink(nullptr),
+    channelTypeMask(MIDI_FILTER_CHANNEL_TYPES_DEFAULT),
+    systemTypeMask(MIDI_FILTER_SYSTEM_TYPES_DEFAULT),
+    channelMask(MIDI_FILTER_CHANNELS_DEFAULT),
+    inputPorts(MIDI_PORT_ALL), currentPort(INPUT_PORT_DIN), deliveredStatus(0), injectStatus(0),
+    portLocked(false), lastClockMicros(0),
+    droppedByType(0), droppedByChannel(0), droppedRealTime(0), droppedByPort(0), portSwitches(0)
+{
+  memset(ports, 0, sizeof(ports));
+}
+
+int MidiInputStream::pending() {
+  return (injectStatus ? 1 : 0) + portAvailable(INPUT_PORT_DIN) + portAvailable(INPUT_PORT_USB);
+}
+
+int MidiInputStream::portAvailable(uint8_t port) {
+  if (port == INPUT_PORT_DIN) return midiUart.available();
+  return usbMidi.isEnabled() ? usbMidi.available() : 0;
+}
+
+uint8_t MidiInputStream::portPeek(uint8_t port) {
+  return (port == INPUT_PORT_DIN) ? midiUart.peek() : usbMidi.peek();
+}
+
+uint8_t MidiInputStream::portRead(uint8_t port) {
+  // Siempre a través de read(): MidiUart empareja así cada 0xF8 con su marca
+  return (port == INPUT_PORT_DIN) ? midiUart.read() : usbMidi.read();
+}
+
+void MidiInputStream::selectPort() {
+  // Solo en frontera de mensaje; el otro puerto toma el turno si tiene datos
+  if (portLocked || !atBoundary(ports[currentPort])) return;
+  
+  uint8_t other = (currentPort == INPUT_PORT_DIN) ? INPUT_PORT_USB : INPUT_PORT_DIN;
+  if (portAvailable(other) > 0) {
+    currentPort = other;
+    portSwitches++;
+  }
+}
+
+int MidiInputStream::available() {
+  if (injectStatus) return 1;
+  
+  uint8_t consumed = 0;
+  
+  for (;;) {
+    selectPort();
+    int count = portAvailable(currentPort);
+    if (count <= 0) return 0;
+    
+    MidiInputPortState& port = ports[currentPort];
+    uint8_t data = portPeek(currentPort);
+    
+    // Frontera de SysEx del puerto (los real-time no la alteran)
+    if (data == 0xF0) {
+      port.inSysEx = true;
+    } else if (data >= 0x80 && data < 0xF8) {
+      port.inSysEx = false;
+    }
+    
+    bool accepted = inputPorts & (1u << currentPort);
+    if (!accepted) {
+      droppedByPort++;
+    } else {
+      // Los SysEx van al parser incremental; el resto pasa por el prefiltro
+      bool consumedBySysEx = sysExSink && sysExSink->parseSysExByte(data);
+      if (!consumedBySysEx) {
+        // Mensaje nuevo con running status de un puerto distinto del último
+        // entregado: la librería necesita antes el status de este puerto
+        bool runningData = !(data & 0x80) && port.dataRemaining == 0 && port.dataLength > 0;
+        if (runningData && port.dropReason == FILTER_PASS && port.runningStatus &&
+            port.runningStatus != deliveredStatus) {
+          injectStatus = port.runningStatus;
+          portLocked = true;
+          return 1;
+        }
+        if (filterByte(port, data)) return count;
+      }
+      if (thruSink) thruSink->feed(currentPort, data);
+    }
+    
+    midiStats.countIn(currentPort, data);
+    midiTrace.captureIn(currentPort, data);
+    portRead(currentPort);
+    if (++consumed >= MIDI_INPUT_SYSEX_SLICE) {
+      return 0;
+    }
+  }
+}
+
+int MidiInputStream::read() {
+  uint8_t data;
+  if (injectStatus) {
+    data = injectStatus;
+    injectStatus = 0;
+  } else {
+    data = portRead(currentPort);
+    portLocked = false;
+    if (thruSink) thruSink->feed(currentPort, data);
+    midiStats.countIn(currentPort, data);
+    midiTrace.captureIn(currentPort, data);
+    if (data == 0xF8) {
+      lastClockMicros = (currentPort == INPUT_PORT_DIN) ? midiUart.getLastClockMicros() : micros();
+    }
+  }
+  
+  // Running status que queda en la librería: lo cambia un status de canal y
+  // lo cancela un system common; los real-time no lo tocan
+  if (data >= 0x80 && data < 0xF0) {
+    deliveredStatus = data;
+  } else if (data >= 0xF0 && data < 0xF8) {
+    deliveredStatus = 0;
+  }
+  return data;
+}
+
+bool MidiInputStream::filterByte(MidiInputPortState& port, uint8_t data) {
+  // Real-time: un solo byte, no altera el mensaje en curso
+  if (data >= 0xF8) {
+    if (systemTypeMask & (1u << (data & 0x0F))) return true;
+    droppedRealTime++;
+    return false;
+  }
+  
+  if (data & 0x80) {
+    // Nuevo status: decidir para él y para su running status
+    port.dataLength = dataBytesFor(data);
+    port.dataRemaining = port.dataLength;
+    port.runningStatus = (data < 0xF0) ? data : 0;
+    
+    if (data >= 0xF0) {
+      port.dropReason = (systemTypeMask & (1u << (data & 0x0F))) ? FILTER_PASS : FILTER_DROP_TYPE;
+    } else if (!(channelTypeMask & (1u << ((data >> 4) - 8)))) {
+      port.dropReason = FILTER_DROP_TYPE;
+    } else if (!(channelMask & (1u << (data & 0x0F)))) {
+      port.dropReason = FILTER_DROP_CHANNEL;
+    } else {
+      port.dropReason = FILTER_PASS;
+    }
+    countDrop(port.dropReason);
+    return port.dropReason == FILTER_PASS;
+  }
+  
+  // Byte de datos: sigue la decisión de su status
+  if (port.dataRemaining == 0 && port.dataLength > 0) {
+    // Comienza otro mensaje con running status
+    port.dataRemaining = port.dataLength;
+    countDrop(port.dropReason);
+  }
+  if (port.dataRemaining > 0) port.dataRemaining--;
+  return port.dropReason == FILTER_PASS;
+}
+
+void MidiInputStream::countDrop(uint8_t reason) {
+  if (reason == FILTER_DROP_TYPE) {
+    droppedByType++;
+  } else if (reason == FILTER_DROP_CHANNEL) {
+    droppedByChannel++;
+  }
+}
+
+uint8_t MidiInputStream::dataBytesFor(uint8_t status) {
+  switch (status & 0xF0) {
+    case 0xC0:
+    case 0xD0:
+      return 1;
+    case 0xF0:
+      switch (status) {
+        case 0xF1: case 0xF3: return 1;
+        case 0xF2: return 2;
+        default: return 0;
+      }
+    default:
+      return 2;
+  }
+}
+
+void MidiInputStream::acceptStatus(uint8_t status, bool accept) {
+  if (status >= 0xF0) {
+    uint16_t bit = 1u << (status & 0x0F);
+    systemTypeMask = accept ? (systemTypeMask | bit) : (systemTypeMask & ~bit);
+  } else if (status >= 0x80) {
+    uint8_t bit = 1u << ((status >> 4) - 8);
+    channelTypeMask = accept ? (channelTypeMask | bit) : (channelTypeMask & ~bit);
+  }
+}
+
+void MidiInputStream::printStatistics() const {
+  debugSerial.print(F("Filtrados por tipo: "));
+  debugSerial.println(droppedByType);
+  debugSerial.print(F("Filtrados por canal: "));
+  debugSerial.println(droppedByChannel);
+  debugSerial.print(F("Filtrados real-time: "));
+  debugSerial.println(droppedRealTime);
+  debugSerial.print(F("Descartados por puerto/cambios de puerto: "));
+  debugSerial.print(droppedByPort);
+  debugSerial.print(F("/"));
+  debugSerial.println(portSwitches);
+}
+
+void MidiInputStream::resetStatistics() {
+  droppedByType = 0;
+  droppedByChannel = 0;
+  droppedRealTime = 0;
+  droppedByPort = 0;
+  portSwitches = 0;
+}
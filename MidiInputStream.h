@@ -0,0 +1,140 @@
+#ifndef MIDI_INPUT_STREAM_H
+#define MIDI_INPUT_STREAM_H
+
+#include <Arduino.h>
+#include "MidiUart.h"
+#include "UsbMidiPort.h"
+
+// Bytes SysEx consumidos como máximo por llamada a available(), para que
+// un volcado largo no se salte el presupuesto de tiempo del loop
+#define MIDI_INPUT_SYSEX_SLICE  32
+
+// Prefiltro por defecto: tipos que el controlador procesa
+// Mensajes de canal, bit (status >> 4) - 8: Note Off/On, CC, Pitch Bend
+#define MIDI_FILTER_CHANNEL_TYPES_DEFAULT  ((1 << 0) | (1 << 1) | (1 << 3) | (1 << 6))
+// Mensajes de sistema, bit (status & 0x0F): MTC, Song Position, Clock, Start, Continue, Stop,
+// Active Sensing
+#define MIDI_FILTER_SYSTEM_TYPES_DEFAULT   ((1 << 0x1) | (1 << 0x2) | (1 << 0x8) | (1 << 0xA) | (1 << 0xB) | (1 << 0xC) | \
+                                            (1 << 0xE))
+#define MIDI_FILTER_CHANNELS_DEFAULT       0xFFFF
+
+enum MidiFilterDrop {
+  FILTER_PASS = 0,
+  FILTER_DROP_TYPE,
+  FILTER_DROP_CHANNEL
+};
+
+// Estado de cada puerto de entrada: el prefiltro y la fusión necesitan
+// saber por dónde va el mensaje en curso de cada uno
+struct MidiInputPortState {
+  uint8_t dropReason;          // Motivo de descarte del mensaje en curso y su running status
+  uint8_t dataLength;          // Bytes de datos del mensaje en curso
+  uint8_t dataRemaining;
+  uint8_t runningStatus;       // Último status de canal del puerto (0: ninguno)
+  bool inSysEx;
+};
+
+enum MidiInputPort {
+  INPUT_PORT_DIN = 0,
+  INPUT_PORT_USB = 1,
+  INPUT_PORT_COUNT
+};
+
+class Midi_Controller;
+class MidiThru;
+
+// Transporte entre los puertos de entrada (MidiUart y USB) y la librería
+// MIDI. Los SysEx se entregan byte a byte al parser de Midi_Controller y
+// nunca llegan al buffer de la librería; el resto de mensajes pasa por un
+// prefiltro de bitmasks por tipo y canal antes de llegar al parser de la
+// librería.
+//
+// Las dos entradas se fusionan por mensajes completos: solo se cambia de
+// puerto en una frontera de mensaje (nunca dentro de un SysEx), alternando
+// si ambos tienen datos. La librería tiene un único running status, así que
+// al volver a un puerto que continúa con running status se le entrega antes
+// el status de ese puerto.
+//
+// Cada byte consumido de un puerto aceptado se copia también al thru, antes
+// del prefiltro: el thru tiene su propio filtro.
+class MidiInputStream {
+private:
+  Midi_Controller* sysExSink;
+  MidiThru* thruSink;
+  
+  // Prefiltro
+  uint8_t channelTypeMask;     // Tipos de mensaje de canal aceptados
+  uint16_t systemTypeMask;     // Tipos de mensaje de sistema aceptados (0xF0-0xFF)
+  uint16_t channelMask;        // Canales aceptados (bit 0 = canal 1)
+  
+  // Fusión de puertos
+  MidiInputPortState ports[INPUT_PORT_COUNT];
+  uint8_t inputPorts;          // Puertos aceptados (MIDI_PORT_*)
+  uint8_t currentPort;         // Puerto del mensaje en curso
+  uint8_t deliveredStatus;     // Running status que tiene la librería
+  uint8_t injectStatus;        // Status a entregar antes del siguiente byte (0: ninguno)
+  bool portLocked;             // Status entregado: el dato que sigue es de este puerto
+  unsigned long lastClockMicros;
+  
+  // Contadores de descartes
+  uint32_t droppedByType;
+  uint32_t droppedByChannel;
+  uint32_t droppedRealTime;
+  uint32_t droppedByPort;
+  uint32_t portSwitches;
+  
+  bool filterByte(MidiInputPortState& port, uint8_t data);
+  void countDrop(uint8_t reason);
+  void selectPort();
+  int portAvailable(uint8_t port);
+  uint8_t portPeek(uint8_t port);
+  uint8_t portRead(uint8_t port);
+  static bool atBoundary(const MidiInputPortState& port) { return !port.inSysEx && port.dataRemaining == 0; }
+
+public:
+  MidiInputStream();
+  
+  void setSysExSink(Midi_Controller* sink) { sysExSink = sink; }
+  void setThruSink(MidiThru* sink) { thruSink = sink; }
+  
+  // Bytes de datos que siguen a un status (0 para SysEx, real-time, etc.)
+  static uint8_t dataBytesFor(uint8_t status);
+  
+  // Configuración del prefiltro
+  void setChannelTypeFilter(uint8_t mask) { channelTypeMask = mask; }
+  void setSystemTypeFilter(uint16_t mask) { systemTypeMask = mask; }
+  void setChannelFilter(uint16_t mask) { channelMask = mask; }
+  void acceptStatus(uint8_t status, bool accept);
+  uint8_t getChannelTypeFilter() const { return channelTypeMask; }
+  uint16_t getSystemTypeFilter() const { return systemTypeMask; }
+  uint16_t getChannelFilter() const { return channelMask; }
+  
+  // Puertos fusionados (MIDI_PORT_*). Lo que llega por un puerto no
+  // aceptado se lee y se descarta para no bloquearlo
+  void setInputPorts(uint8_t mask) { inputPorts = mask; }
+  uint8_t getInputPorts() const { return inputPorts; }
+  
+  // Bytes sin procesar en todos los puertos (antes del prefiltro)
+  int pending();
+  
+  // Llegada del último 0xF8 entregado: marca de la ISR para DIN, lectura para USB
+  unsigned long getLastClockMicros() const { return lastClockMicros; }
+  
+  // Diagnóstico
+  uint32_t getDroppedByType() const { return droppedByType; }
+  uint32_t getDroppedByChannel() const { return droppedByChannel; }
+  uint32_t getDroppedRealTime() const { return droppedRealTime; }
+  uint32_t getDroppedByPort() const { return droppedByPort; }
+  void printStatistics() const;
+  void resetStatistics();
+  
+  // Interfaz usada por midi::SerialMIDI
+  void begin(unsigned long baud) { midiUart.begin(baud); }
+  int available();
+  int read();
+  size_t write(uint8_t data) { return midiUart.write(data); }
+};
+
+extern MidiInputStream midiInput;
+
+#endif // MIDI_INPUT_STREAM_H
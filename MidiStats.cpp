@@ -0,0 +1,306 @@
+#include "MidiStats.h"
+#include "MidiInputStream.h"
+#include "UsbMidiPort.h"
+#include "MidiUart.h"
+#include "Midi_Controller.h"
+#include "TimingGenerator.h"
+
+extern Midi_Controller midi_controller;
+
+MidiStats midiStats;
+
+static const char typeName0[] PROGMEM = "NoteOff";
+static const char typeName1[] PROGMEM = "NoteOn";
+static const char typeName2[] PROGMEM = "PolyAT";
+static const char typeName3[] PROGMEM = "CC";
+static const char typeName4[] PROGMEM = "Program";
+static const char typeName5[] PROGMEM = "ChanAT";
+static const char typeName6[] PROGMEM = "PitchBend";
+static const char typeName7[] PROGMEM = "SysEx";
+static const char typeName8[] PROGMEM = "MTC QF";
+static const char typeName9[] PROGMEM = "SongPos";
+static const char typeName10[] PROGMEM = "Common";
+static const char typeName11[] PROGMEM = "Clock";
+static const char typeName12[] PROGMEM = "Transp";
+static const char typeName13[] PROGMEM = "ActSens";
+static const char typeName14[] PROGMEM = "RealTime";
+
+static const char* const typeNames[STATS_TYPE_COUNT] = {
+  typeName0, typeName1, typeName2, typeName3, typeName4, typeName5, typeName6, typeName7,
+  typeName8, typeName9, typeName10, typeName11, typeName12, typeName13, typeName14
+};
+
+// Reenvía a debugSerial acumulando el XOR de lo escrito (checksum de la trama)
+class ChecksumPrint : public Print {
+public:
+  uint8_t checksum;
+  ChecksumPrint() : checksum(0) {}
+  virtual size_t write(uint8_t data) {
+    checksum ^= data;
+    return debugSerial.write(data);
+  }
+  using Print::write;
+};
+
+MidiStats::MidiStats()
+  : windowStart(0), lastGeneratorClocks(0), lastGeneratorQuarters(0),
+    frameIntervalMs(0), lastFrame(0)
+{
+  memset(typeIn, 0, sizeof(typeIn));
+  memset(typeOut, 0, sizeof(typeOut));
+  memset(rateIn, 0, sizeof(rateIn));
+  memset(rateOut, 0, sizeof(rateOut));
+  memset(parserIn, 0, sizeof(parserIn));
+  memset(parserOut, 0, sizeof(parserOut));
+}
+
+void MidiStats::countIn(uint8_t port, uint8_t data) {
+  if (port >= STATS_PORT_COUNT) return;
+  if (rateIn[port].windowBytes < 0xFFFF) rateIn[port].windowBytes++;
+  countByte(parserIn[port], typeIn, data);
+}
+
+void MidiStats::countOut(uint8_t port, uint8_t data) {
+  if (port >= STATS_PORT_COUNT) return;
+  if (rateOut[port].windowBytes < 0xFFFF) rateOut[port].windowBytes++;
+  countByte(parserOut[port], typeOut, data);
+}
+
+void MidiStats::countByte(MidiStatsParser& parser, uint32_t* types, uint8_t data) {
+  // Real-time: mensaje de un byte en cualquier punto del stream
+  if (data >= 0xF8) {
+    types[typeOfStatus(data)]++;
+    return;
+  }
+
+  if (data & 0x80) {
+    if (data == 0xF7) {
+      parser.inSysEx = false;
+      return;
+    }
+    types[typeOfStatus(data)]++;
+    parser.inSysEx = (data == 0xF0);
+    parser.status = (data < 0xF0) ? data : 0;  // System common cancela el running status
+    parser.remaining = MidiInputStream::dataBytesFor(data);
+    return;
+  }
+
+  if (parser.inSysEx) return;
+
+  // Byte de datos que abre otro mensaje con running status
+  if (parser.remaining == 0 && parser.status) {
+    types[typeOfStatus(parser.status)]++;
+    parser.remaining = MidiInputStream::dataBytesFor(parser.status);
+  }
+  if (parser.remaining > 0) parser.remaining--;
+}
+
+void MidiStats::update(unsigned long currentTime) {
+  unsigned long elapsed = currentTime - windowStart;
+  if (elapsed >= MIDI_STATS_WINDOW_MS) {
+    foldGenerator();
+    closeWindow(elapsed);
+    windowStart = currentTime;
+  }
+
+  if (frameIntervalMs && currentTime - lastFrame >= frameIntervalMs) {
+    lastFrame = currentTime;
+    printFrame();
+  }
+}
+
+void MidiStats::foldGenerator() {
+  // Lo que el generador inyecta desde su ISR no pasa por MidiUart::write
+  uint32_t clocks = timingGenerator.getClocksSent();
+  uint32_t quarters = timingGenerator.getQuarterFramesSent();
+  if (clocks < lastGeneratorClocks) lastGeneratorClocks = 0;      // Estadísticas del generador reiniciadas
+  if (quarters < lastGeneratorQuarters) lastGeneratorQuarters = 0;
+
+  uint32_t newClocks = clocks - lastGeneratorClocks;
+  uint32_t newQuarters = quarters - lastGeneratorQuarters;
+  typeOut[STATS_CLOCK] += newClocks;
+  typeOut[STATS_MTC_QUARTER] += newQuarters;
+
+  uint32_t bytes = rateOut[STATS_PORT_DIN].windowBytes + newClocks + 2 * newQuarters;
+  rateOut[STATS_PORT_DIN].windowBytes = (bytes > 0xFFFF) ? 0xFFFF : bytes;
+
+  lastGeneratorClocks = clocks;
+  lastGeneratorQuarters = quarters;
+}
+
+void MidiStats::closeWindow(unsigned long elapsed) {
+  for (uint8_t port = 0; port < STATS_PORT_COUNT; port++) {
+    closeRate(rateIn[port], elapsed);
+    closeRate(rateOut[port], elapsed);
+  }
+}
+
+void MidiStats::closeRate(MidiStatsRate& rate, unsigned long elapsed) {
+  // Normalizar a bytes/s: el loop puede cerrar la ventana con retraso
+  uint32_t perSecond = (uint32_t)rate.windowBytes * 1000 / elapsed;
+  rate.perSecond = (perSecond > 0xFFFF) ? 0xFFFF : perSecond;
+  rate.windowBytes = 0;
+  if (rate.perSecond > rate.peak) rate.peak = rate.perSecond;
+
+  int32_t target = (int32_t)rate.perSecond << MIDI_STATS_AVG_SHIFT;
+  rate.avgQ += (target - (int32_t)rate.avgQ) >> MIDI_STATS_AVG_SHIFT;
+}
+
+uint8_t MidiStats::utilisation(uint16_t bytesPerSecond, uint16_t capacity) {
+  uint32_t percent = (uint32_t)bytesPerSecond * 100 / capacity;
+  return (percent > 100) ? 100 : percent;
+}
+
+static uint16_t portCapacity(uint8_t port) {
+  return (port == STATS_PORT_USB) ? MIDI_USB_BYTES_PER_SECOND : MIDI_DIN_BYTES_PER_SECOND;
+}
+
+uint8_t MidiStats::getUtilisationIn(uint8_t port) const {
+  return utilisation(rateIn[port].perSecond, portCapacity(port));
+}
+
+uint8_t MidiStats::getUtilisationOut(uint8_t port) const {
+  return utilisation(rateOut[port].perSecond, portCapacity(port));
+}
+
+uint8_t MidiStats::typeOfStatus(uint8_t status) {
+  if (status < 0xF0) return (status >> 4) - 8;
+  switch (status) {
+    case 0xF0: return STATS_SYSEX;
+    case 0xF1: return STATS_MTC_QUARTER;
+    case 0xF2: return STATS_SONG_POSITION;
+    case 0xF8: return STATS_CLOCK;
+    case 0xFA: case 0xFB: case 0xFC: return STATS_TRANSPORT;
+    case 0xFE: return STATS_ACTIVE_SENSING;
+    default: return (status >= 0xF8) ? STATS_OTHER_REALTIME : STATS_OTHER_COMMON;
+  }
+}
+
+void MidiStats::printStatistics() const {
+  static const char* const portLabels[STATS_PORT_COUNT] = {"DIN", "USB"};
+
+  debugSerial.println(F("Tráfico B/s (actual/pico/media):"));
+  for (uint8_t port = 0; port < STATS_PORT_COUNT; port++) {
+    debugSerial.print(F("  "));
+    debugSerial.print(portLabels[port]);
+    debugSerial.print(F(" RX "));
+    debugSerial.print(rateIn[port].perSecond);
+    debugSerial.print(F("/"));
+    debugSerial.print(rateIn[port].peak);
+    debugSerial.print(F("/"));
+    debugSerial.print(rateIn[port].avgQ >> MIDI_STATS_AVG_SHIFT);
+    debugSerial.print(F("  TX "));
+    debugSerial.print(rateOut[port].perSecond);
+    debugSerial.print(F("/"));
+    debugSerial.print(rateOut[port].peak);
+    debugSerial.print(F("/"));
+    debugSerial.println(rateOut[port].avgQ >> MIDI_STATS_AVG_SHIFT);
+  }
+  for (uint8_t port = 0; port < STATS_PORT_COUNT; port++) {
+    debugSerial.print(F("Uso enlace "));
+    debugSerial.print(portLabels[port]);
+    debugSerial.print(F(" RX/TX: "));
+    debugSerial.print(getUtilisationIn(port));
+    debugSerial.print(F("%/"));
+    debugSerial.print(getUtilisationOut(port));
+    debugSerial.println(F("%"));
+  }
+
+  debugSerial.println(F("Mensajes por tipo (RX/TX):"));
+  for (uint8_t type = 0; type < STATS_TYPE_COUNT; type++) {
+    if (!typeIn[type] && !typeOut[type]) continue;
+    debugSerial.print(F("  "));
+    debugSerial.print(reinterpret_cast<const __FlashStringHelper*>(typeNames[type]));
+    debugSerial.print(F(": "));
+    debugSerial.print(typeIn[type]);
+    debugSerial.print(F("/"));
+    debugSerial.println(typeOut[type]);
+  }
+}
+
+// Trama de una línea para seguir la saturación en directo:
+//
+//   $MS,<s>,<rx DIN>,<rx USB>,<tx DIN>,<tx USB>,<uso RX>,<uso TX>,<cola>,<perdidos>,
+//       <SysEx>,<tipos RX>,<tipos TX>*<checksum>
+//
+// - <s>: segundos desde el arranque
+// - <rx|tx puerto>: bytes/s actual:pico:media
+// - <uso RX|TX>: DIN:USB, en % de 3125 y 11520 bytes/s
+// - <cola>: profundidad:pico:descartes de la cola TX:desbordes del thru
+// - <perdidos>: bytes de entrada perdidos (overrun, trama, ring DIN, ring USB)
+// - <SysEx>: inválidos por motivo, en el orden de SysExErrorReason
+// - <tipos RX|TX>: totales por tipo, en el orden de MidiStatsType
+// - <checksum>: XOR en hexadecimal de los caracteres entre '$' y '*'
+//
+// Los grupos separan sus campos con ':'. Los contadores son acumulados: el
+// host calcula los incrementos entre tramas.
+void MidiStats::printFrame() const {
+  ChecksumPrint out;
+  const MidiTxQueue& queue = midi_controller.getTxQueue();
+
+  debugSerial.print('$');
+  out.print(F("MS,"));
+  out.print(millis() / 1000);
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    const MidiStatsRate* rates = dir ? rateOut : rateIn;
+    for (uint8_t port = 0; port < STATS_PORT_COUNT; port++) {
+      out.print(',');
+      out.print(rates[port].perSecond);
+      out.print(':');
+      out.print(rates[port].peak);
+      out.print(':');
+      out.print(rates[port].avgQ >> MIDI_STATS_AVG_SHIFT);
+    }
+  }
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    for (uint8_t port = 0; port < STATS_PORT_COUNT; port++) {
+      out.print(port ? ':' : ',');
+      out.print(dir ? getUtilisationOut(port) : getUtilisationIn(port));
+    }
+  }
+
+  out.print(',');
+  out.print(queue.getDepth());
+  out.print(':');
+  out.print(queue.getPeakDepth());
+  out.print(':');
+  out.print(queue.getMessagesDropped());
+  out.print(':');
+  out.print(queue.getThruOverflows());
+
+  out.print(',');
+  out.print(midiUart.getRxOverruns());
+  out.print(':');
+  out.print(midiUart.getRxFramingErrors());
+  out.print(':');
+  out.print(midiUart.getRxRingOverflows());
+  out.print(':');
+  out.print(usbMidi.getRxOverflows());
+
+  out.print(',');
+  for (uint8_t reason = 0; reason < SYSEX_ERR_COUNT; reason++) {
+    if (reason) out.print(':');
+    out.print(midi_controller.getSysExErrors(reason));
+  }
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    const uint32_t* types = dir ? typeOut : typeIn;
+    out.print(',');
+    for (uint8_t type = 0; type < STATS_TYPE_COUNT; type++) {
+      if (type) out.print(':');
+      out.print(types[type]);
+    }
+  }
+
+  debugSerial.print('*');
+  if (out.checksum < 0x10) debugSerial.print('0');
+  debugSerial.println(out.checksum, HEX);
+}
+
+void MidiStats::resetStatistics() {
+  memset(typeIn, 0, sizeof(typeIn));
+  memset(typeOut, 0, sizeof(typeOut));
+  // Tasas, picos y medias: la primera ventana tras el reinicio no mezcla datos previos
+  memset(rateIn, 0, sizeof(rateIn));
+  memset(rateOut, 0, sizeof(rateOut));
+  windowStart = millis();
+}
@@ -0,0 +1,112 @@
+#ifndef MIDI_STATS_H
+#define MIDI_STATS_H
+
+#include <Arduino.h>
+
+#define MIDI_STATS_WINDOW_MS       1000   // Ventana de las tasas en bytes/s
+#define MIDI_STATS_AVG_SHIFT       3      // Media móvil exponencial de 8 ventanas
+#define MIDI_DIN_BYTES_PER_SECOND  3125   // 31250 baudios, 10 bits por byte
+#define MIDI_USB_BYTES_PER_SECOND  11520  // 115200 baudios, 10 bits por byte
+
+// Puertos de las estadísticas (mismo orden que INPUT_PORT_*)
+enum MidiStatsPort {
+  STATS_PORT_DIN = 0,
+  STATS_PORT_USB = 1,
+  STATS_PORT_COUNT
+};
+
+// Tipos de mensaje contados
+enum MidiStatsType {
+  STATS_NOTE_OFF = 0,
+  STATS_NOTE_ON,
+  STATS_POLY_PRESSURE,
+  STATS_CONTROL_CHANGE,
+  STATS_PROGRAM_CHANGE,
+  STATS_CHANNEL_PRESSURE,
+  STATS_PITCH_BEND,
+  STATS_SYSEX,
+  STATS_MTC_QUARTER,
+  STATS_SONG_POSITION,
+  STATS_OTHER_COMMON,         // Song Select, Tune Request, status indefinidos
+  STATS_CLOCK,
+  STATS_TRANSPORT,            // Start, Continue, Stop
+  STATS_ACTIVE_SENSING,
+  STATS_OTHER_REALTIME,       // Reset y status indefinidos
+  STATS_TYPE_COUNT
+};
+
+// Tasa en bytes/s de un puerto y sentido: última ventana, pico y media
+struct MidiStatsRate {
+  uint16_t windowBytes;
+  uint16_t perSecond;
+  uint16_t peak;
+  uint32_t avgQ;              // Media exponencial, bytes/s << MIDI_STATS_AVG_SHIFT
+};
+
+// Seguimiento mínimo de mensajes en un stream de bytes (por puerto y sentido)
+struct MidiStatsParser {
+  uint8_t status;             // Running status (0: ninguno)
+  uint8_t remaining;          // Bytes de datos que faltan del mensaje en curso
+  bool inSysEx;
+};
+
+// Contadores de tráfico por tipo de mensaje y tasas por puerto en los dos
+// sentidos. Los mensajes se cuentan por cable: uno que sale por DIN y USB
+// cuenta dos veces. Se alimenta con los bytes de entrada consumidos por
+// MidiInputStream y los de salida escritos en MidiUart y UsbMidiPort; el
+// clock y los quarter frames que el generador maestro inyecta desde su ISR
+// se suman en update() a partir de sus contadores.
+class MidiStats {
+private:
+  uint32_t typeIn[STATS_TYPE_COUNT];
+  uint32_t typeOut[STATS_TYPE_COUNT];
+  MidiStatsRate rateIn[STATS_PORT_COUNT];
+  MidiStatsRate rateOut[STATS_PORT_COUNT];
+  MidiStatsParser parserIn[STATS_PORT_COUNT];
+  MidiStatsParser parserOut[STATS_PORT_COUNT];
+
+  unsigned long windowStart;
+  uint32_t lastGeneratorClocks;
+  uint32_t lastGeneratorQuarters;
+
+  // Trama periódica por Serial (0 = desactivada)
+  uint16_t frameIntervalMs;
+  unsigned long lastFrame;
+
+  void countByte(MidiStatsParser& parser, uint32_t* types, uint8_t data);
+  void closeWindow(unsigned long elapsed);
+  void foldGenerator();
+  static void closeRate(MidiStatsRate& rate, unsigned long elapsed);
+  static uint8_t typeOfStatus(uint8_t status);
+  static uint8_t utilisation(uint16_t bytesPerSecond, uint16_t capacity);
+
+public:
+  MidiStats();
+
+  // Desde los puntos de consumo/escritura de cada puerto (nunca desde ISR)
+  void countIn(uint8_t port, uint8_t data);
+  void countOut(uint8_t port, uint8_t data);
+
+  // Llamar desde loop: cierra ventanas y emite la trama si toca
+  void update(unsigned long currentTime);
+
+  void setFrameInterval(uint16_t intervalMs) { frameIntervalMs = intervalMs; }
+  uint16_t getFrameInterval() const { return frameIntervalMs; }
+
+  // Consulta
+  uint32_t getTypeIn(uint8_t type) const { return (type < STATS_TYPE_COUNT) ? typeIn[type] : 0; }
+  uint32_t getTypeOut(uint8_t type) const { return (type < STATS_TYPE_COUNT) ? typeOut[type] : 0; }
+  const MidiStatsRate& getRateIn(uint8_t port) const { return rateIn[port]; }
+  const MidiStatsRate& getRateOut(uint8_t port) const { return rateOut[port]; }
+  uint8_t getUtilisationIn(uint8_t port) const;
+  uint8_t getUtilisationOut(uint8_t port) const;
+
+  // Informe legible y trama compacta de una línea
+  void printStatistics() const;
+  void printFrame() const;
+  void resetStatistics();
+};
+
+extern MidiStats midiStats;
+
+#endif // MIDI_STATS_H
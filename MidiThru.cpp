@@ -0,0 +1,135 @@
+#include "MidiThru.h"
+#include "UsbMidiPort.h"
+#include "MidiInputStream.h"
+
+MidiThru::MidiThru()
+  : output(nullptr), enabled(false),
+    channelTypeMask(THRU_FILTER_CHANNEL_TYPES_DEFAULT),
+    systemTypeMask(THRU_FILTER_SYSTEM_TYPES_DEFAULT),
+    channelMask(THRU_FILTER_CHANNELS_DEFAULT),
+    messagesForwarded(0), messagesFiltered(0)
+{
+  resetParsers();
+}
+
+void MidiThru::setEnabled(bool enable) {
+  if (enable == enabled) return;
+  enabled = enable;
+  // Un SysEx thru que quede abierto lo cierra la cola por timeout
+  resetParsers();
+}
+
+void MidiThru::resetParsers() {
+  memset(parsers, 0, sizeof(parsers));
+}
+
+void MidiThru::acceptStatus(uint8_t status, bool accept) {
+  if (status >= 0xF0) {
+    uint16_t bit = 1u << (status & 0x0F);
+    systemTypeMask = accept ? (systemTypeMask | bit) : (systemTypeMask & ~bit);
+  } else if (status >= 0x80) {
+    uint8_t bit = 1u << ((status >> 4) - 8);
+    channelTypeMask = accept ? (channelTypeMask | bit) : (channelTypeMask & ~bit);
+  }
+}
+
+bool MidiThru::hasDestination(uint8_t skipPorts) const {
+  // Sin ningún puerto de salida no se encola ni se cuenta como reenviado
+  return output->getOutputPorts() & ~skipPorts;
+}
+
+bool MidiThru::passes(uint8_t status) const {
+  if (status >= 0xF0) return systemTypeMask & (1u << (status & 0x0F));
+  if (!(channelTypeMask & (1u << ((status >> 4) - 8)))) return false;
+  return channelMask & (1u << (status & 0x0F));
+}
+
+void MidiThru::feed(uint8_t port, uint8_t data) {
+  if (!enabled || !output || port >= INPUT_PORT_COUNT) return;
+
+  PortParser& parser = parsers[port];
+  uint8_t skipPorts = (1u << port) & THRU_NO_ECHO_PORTS;
+
+  // Real-time: pasa al momento, también dentro de un SysEx o de un mensaje
+  if (data >= 0xF8) {
+    if (passes(data)) {
+      if (hasDestination(skipPorts) && output->enqueueRealTime(data, skipPorts)) messagesForwarded++;
+    } else {
+      messagesFiltered++;
+    }
+    return;
+  }
+
+  if (parser.inSysEx) {
+    if (!(data & 0x80)) {
+      if (!parser.dropping && !output->enqueueThruSysEx(skipPorts, data, 0)) parser.dropping = true;
+      return;
+    }
+
+    // F7, o un status que trunca el SysEx: en ambos casos la salida se cierra con F7
+    if (!parser.dropping) output->enqueueThruSysEx(skipPorts, 0xF7, 0);
+    parser.inSysEx = false;
+    if (data == 0xF7) return;
+  }
+
+  if (data == 0xF0) {
+    parser.status = 0;  // SysEx cancela el running status
+    parser.inSysEx = true;
+    if (!passes(0xF0)) {
+      parser.dropping = true;
+      messagesFiltered++;
+    } else if (!hasDestination(skipPorts)) {
+      parser.dropping = true;
+    } else {
+      parser.dropping = !output->enqueueThruSysEx(skipPorts, 0xF0, micros());
+      if (!parser.dropping) messagesForwarded++;
+    }
+    return;
+  }
+
+  if (data & 0x80) {
+    parser.status = (data == 0xF7 || data == 0xF4 || data == 0xF5) ? 0 : data;
+    parser.expected = MidiInputStream::dataBytesFor(data);
+    parser.count = 0;
+    if (parser.status && parser.expected == 0) {
+      emit(parser, skipPorts);  // Tune Request
+      parser.status = 0;
+    }
+    return;
+  }
+
+  // Byte de datos (sin status previo: se descarta)
+  if (!parser.status) return;
+  parser.data[parser.count++] = data;
+  if (parser.count >= parser.expected) {
+    emit(parser, skipPorts);
+    parser.count = 0;
+    if (parser.status >= 0xF0) parser.status = 0;  // System common no admite running status
+  }
+}
+
+void MidiThru::emit(PortParser& parser, uint8_t skipPorts) {
+  if (!passes(parser.status)) {
+    messagesFiltered++;
+    return;
+  }
+  if (!hasDestination(skipPorts)) return;
+  // Marca al completar el mensaje: la latencia medida es la del merge, no la de recepción
+  if (output->enqueueThru(skipPorts, parser.status, parser.data[0], parser.data[1], micros())) {
+    messagesForwarded++;
+  }
+}
+
+void MidiThru::printStatistics() const {
+  debugSerial.print(F("Thru: "));
+  debugSerial.println(enabled ? F("activo") : F("inactivo"));
+  debugSerial.print(F("Thru mensajes reenviados/filtrados: "));
+  debugSerial.print(messagesForwarded);
+  debugSerial.print(F("/"));
+  debugSerial.println(messagesFiltered);
+}
+
+void MidiThru::resetStatistics() {
+  messagesForwarded = 0;
+  messagesFiltered = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef MIDI_THRU_H
+#define MIDI_THRU_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "MidiTxQueue.h"
+
+// Filtro por defecto del thru: todos los mensajes de canal y de sistema
+// salvo Active Sensing y Reset, que solo tienen sentido punto a punto
+#define THRU_FILTER_CHANNEL_TYPES_DEFAULT  0x7F
+#define THRU_FILTER_SYSTEM_TYPES_DEFAULT   (0xFFFF & ~((1u << 0xE) | (1u << 0xF)))
+#define THRU_FILTER_CHANNELS_DEFAULT       0xFFFF
+
+// Puertos que no reciben de vuelta lo que entra por ellos mismos. El host
+// USB reenviaría su propio tráfico en bucle; el DIN sí se devuelve (DIN -> DIN
+// es el thru clásico con un solo puerto de salida)
+#define THRU_NO_ECHO_PORTS                 MIDI_PORT_USB
+
+// Motor de merge del MIDI thru. Recibe cada byte consumido de los puertos
+// de entrada, reconstruye mensajes completos (con running status propio de
+// cada puerto) y los entrega a la cola TX, que es quien decide el running
+// status de salida y los intercala con la salida local sin partir mensajes.
+// Los SysEx se reenvían byte a byte: no caben enteros en RAM.
+class MidiThru {
+private:
+  struct PortParser {
+    uint8_t status;        // Status en curso (0: ninguno)
+    uint8_t expected;      // Bytes de datos del mensaje
+    uint8_t count;
+    uint8_t data[2];
+    bool inSysEx;
+    bool dropping;         // SysEx filtrado o truncado: ignorar hasta F7
+  };
+
+  MidiTxQueue* output;
+  bool enabled;
+
+  uint8_t channelTypeMask;
+  uint16_t systemTypeMask;
+  uint16_t channelMask;
+
+  PortParser parsers[2];
+
+  // Estadísticas
+  uint32_t messagesForwarded;
+  uint32_t messagesFiltered;
+
+  bool passes(uint8_t status) const;
+  bool hasDestination(uint8_t skipPorts) const;
+  void emit(PortParser& parser, uint8_t skipPorts);
+  void resetParsers();
+
+public:
+  MidiThru();
+
+  void setOutput(MidiTxQueue* queue) { output = queue; }
+  void setEnabled(bool enable);
+  bool isEnabled() const { return enabled; }
+
+  // Filtro por tipo (mismos bits que el prefiltro de entrada) y canal
+  void setChannelTypeFilter(uint8_t mask) { channelTypeMask = mask; }
+  void setSystemTypeFilter(uint16_t mask) { systemTypeMask = mask; }
+  void setChannelFilter(uint16_t mask) { channelMask = mask; }
+  void acceptStatus(uint8_t status, bool accept);
+
+  // Un byte consumido del puerto de entrada (INPUT_PORT_*)
+  void feed(uint8_t port, uint8_t data);
+
+  // Diagnóstico
+  uint32_t getMessagesForwarded() const { return messagesForwarded; }
+  uint32_t getMessagesFiltered() const { return messagesFiltered; }
+  void printStatistics() const;
+  void resetStatistics();
+};
+
+#endif // MIDI_THRU_H
@@ -0,0 +1,293 @@
+#include "MidiTrace.h"
+#include "Config.h"
+#include "UsbMidiPort.h"
+#include "MidiInputStream.h"
+#include "FileManager.h"
+
+extern FileManager fileSystem;
+
+MidiTrace midiTrace;
+
+MidiTrace::MidiTrace()
+  : fillBlock(0), writeBlock(0), readyBlocks(0), fillPos(0),
+    blockOpenedAt(0), lastStamp(0), sequence(0), droppedPending(0),
+    mode(TRACE_MODE_OFF), stopPending(false), stopAt(0),
+    recordsCaptured(0), recordsDropped(0), blocksWritten(0),
+    maxWriteMicros(0), writeErrors(0)
+{
+  memset(wires, 0, sizeof(wires));
+  fileName[0] = '\0';
+}
+
+void MidiTrace::captureByte(uint8_t wire, uint8_t data) {
+  MidiTraceWire& w = wires[wire];
+
+  // Real-time: registro propio, sin tocar el mensaje que interrumpen
+  if (data >= 0xF8) {
+    appendRecord(wire, micros(), &data, 1);
+    return;
+  }
+
+  if (data & 0x80) {
+    // Un status cierra el SysEx o el mensaje incompleto en curso, que sale tal cual
+    bool endsSysEx = w.inSysEx && data == 0xF7;
+    if (endsSysEx) w.data[w.length++] = data;
+    flushWire(wire);
+    w.inSysEx = false;
+    if (endsSysEx) return;
+
+    w.start = micros();
+    w.data[0] = data;
+    w.length = 1;
+    w.inSysEx = (data == 0xF0);
+    w.status = (data < 0xF0) ? data : 0;  // Los system common cancelan el running status
+    w.remaining = w.inSysEx ? 0 : MidiInputStream::dataBytesFor(data);
+    if (!w.inSysEx && w.remaining == 0) flushWire(wire);
+    return;
+  }
+
+  if (w.length == 0) {
+    w.start = micros();
+    if (!w.inSysEx) {
+      if (!w.status) {
+        appendRecord(wire, w.start, &data, 1);  // Dato sin status
+        return;
+      }
+      w.remaining = MidiInputStream::dataBytesFor(w.status);
+    }
+  }
+
+  w.data[w.length++] = data;
+  if (w.inSysEx) {
+    if (w.length == TRACE_MAX_DATA) flushWire(wire);
+  } else if (--w.remaining == 0) {
+    flushWire(wire);
+  }
+}
+
+void MidiTrace::flushWire(uint8_t wire) {
+  MidiTraceWire& w = wires[wire];
+  if (w.length) appendRecord(wire, w.start, w.data, w.length);
+  w.length = 0;
+}
+
+bool MidiTrace::needsAbsolute(unsigned long stamp) const {
+  // Mensajes de otro cable que se completan tarde pueden llevar marcas anteriores
+  return fillPos <= TRACE_BLOCK_HEADER || stamp - lastStamp > 0xFFFF;
+}
+
+void MidiTrace::appendRecord(uint8_t wire, unsigned long stamp, const uint8_t* data, uint8_t length) {
+  uint8_t size = (needsAbsolute(stamp) ? 5 : 3) + length;
+  if (fillPos && fillPos + size > TRACE_BLOCK_SIZE) closeBlock();
+  if (!fillPos && !openBlock()) {
+    // Ring lleno y la escritura del bloque pendiente ha fallado
+    recordsDropped++;
+    if (droppedPending < 0xFFFF) droppedPending++;
+    return;
+  }
+
+  uint8_t* p = blocks[fillBlock] + fillPos;
+  uint8_t flags = ((wire & 2) ? TRACE_FLAG_TX : 0) | ((wire & 1) ? TRACE_FLAG_USB : 0) | length;
+  if (needsAbsolute(stamp)) {
+    *p++ = flags | TRACE_FLAG_ABSOLUTE;
+    *p++ = stamp;
+    *p++ = stamp >> 8;
+    *p++ = stamp >> 16;
+    *p++ = stamp >> 24;
+  } else {
+    uint16_t delta = stamp - lastStamp;
+    *p++ = flags;
+    *p++ = delta;
+    *p++ = delta >> 8;
+  }
+  memcpy(p, data, length);
+
+  fillPos = (p + length) - blocks[fillBlock];
+  lastStamp = stamp;
+  recordsCaptured++;
+}
+
+bool MidiTrace::openBlock() {
+  // Ring lleno: escribir el bloque más antiguo antes que perder registros
+  if (readyBlocks >= TRACE_BLOCKS && !writeReadyBlock()) return false;
+
+  uint8_t* block = blocks[fillBlock];
+  block[0] = 'M';
+  block[1] = 'T';
+  block[2] = sequence;
+  block[3] = sequence >> 8;
+  block[4] = droppedPending;
+  block[5] = droppedPending >> 8;
+  block[6] = TRACE_FORMAT_VERSION;
+  block[7] = 0;
+
+  sequence++;
+  droppedPending = 0;
+  blockOpenedAt = millis();
+  fillPos = TRACE_BLOCK_HEADER;
+  return true;
+}
+
+void MidiTrace::closeBlock() {
+  memset(blocks[fillBlock] + fillPos, 0, TRACE_BLOCK_SIZE - fillPos);
+  readyBlocks++;
+  fillBlock = (fillBlock + 1) % TRACE_BLOCKS;
+  fillPos = 0;
+}
+
+bool MidiTrace::writeReadyBlock() {
+  unsigned long startMicros = micros();
+  size_t written = traceFile.write(blocks[writeBlock], TRACE_BLOCK_SIZE);
+
+  // El tamaño del fichero en el directorio solo se actualiza con flush()
+  if (written == TRACE_BLOCK_SIZE && ++blocksWritten % TRACE_SYNC_BLOCKS == 0) {
+    traceFile.flush();
+  }
+
+  unsigned long elapsed = micros() - startMicros;
+  if (elapsed > maxWriteMicros) maxWriteMicros = elapsed;
+
+  writeBlock = (writeBlock + 1) % TRACE_BLOCKS;
+  readyBlocks--;
+  if (written != TRACE_BLOCK_SIZE) {
+    writeErrors++;
+    return false;
+  }
+  return true;
+}
+
+void MidiTrace::update(unsigned long currentTime) {
+  if (!mode) return;
+
+  if (stopPending && (long)(currentTime - stopAt) >= 0) {
+    debugSerial.println(F("Captura MIDI: DAW desconectado"));
+    stop();
+    return;
+  }
+
+  // Con poco tráfico el bloque tardaría en llenarse: no dejarlo solo en RAM
+  if (fillPos > TRACE_BLOCK_HEADER && readyBlocks == 0 &&
+      (long)(currentTime - blockOpenedAt) >= TRACE_IDLE_FLUSH_MS) {
+    closeBlock();
+  }
+
+  // Un sector por pasada: el resto espera al siguiente loop. Un fallo en la
+  // escritura forzada desde openBlock() también cierra la captura
+  if ((readyBlocks && !writeReadyBlock()) || writeErrors) {
+    debugSerial.println(F("ERROR: Escritura de la captura MIDI"));
+    finish(false);
+  }
+}
+
+bool MidiTrace::openFile() {
+  for (uint8_t i = 0; i < TRACE_MAX_FILES; i++) {
+    snprintf(fileName, sizeof(fileName), "%s/TRACE%02u.MTR", LOG_DIRECTORY, i);
+    if (SD.exists(fileName)) continue;
+
+    traceFile = SD.open(fileName, FILE_WRITE);
+    if (traceFile) return true;
+    break;
+  }
+  fileName[0] = '\0';
+  return false;
+}
+
+bool MidiTrace::start(uint8_t newMode) {
+  if (newMode == TRACE_MODE_OFF || newMode >= TRACE_MODE_COUNT) {
+    stop();
+    return true;
+  }
+
+  // Ya capturando: solo cambia el disparador de parada
+  if (mode) {
+    mode = newMode;
+    stopPending = false;
+    return true;
+  }
+
+  if (!fileSystem.isInitialized() || !openFile()) {
+    debugSerial.println(F("ERROR: No se pudo crear el fichero de captura MIDI"));
+    return false;
+  }
+
+  fillBlock = 0;
+  writeBlock = 0;
+  readyBlocks = 0;
+  fillPos = 0;
+  sequence = 0;
+  droppedPending = 0;
+  memset(wires, 0, sizeof(wires));
+
+  recordsCaptured = 0;
+  recordsDropped = 0;
+  blocksWritten = 0;
+  maxWriteMicros = 0;
+  writeErrors = 0;
+
+  stopPending = false;
+  mode = newMode;
+
+  debugSerial.print(F("Captura MIDI: "));
+  debugSerial.println(fileName);
+  return true;
+}
+
+void MidiTrace::stop() {
+  if (!mode) return;
+  finish(true);
+}
+
+void MidiTrace::finish(bool flushData) {
+  if (flushData) {
+    for (uint8_t i = 0; i < 4; i++) {
+      flushWire(i);
+    }
+    if (fillPos > TRACE_BLOCK_HEADER) closeBlock();
+
+    // Al parar sí se espera a la SD: como mucho TRACE_BLOCKS sectores
+    while (readyBlocks && writeReadyBlock()) {}
+  }
+
+  traceFile.close();
+  mode = TRACE_MODE_OFF;
+  stopPending = false;
+
+  debugSerial.print(F("Captura MIDI cerrada: "));
+  debugSerial.print(fileName);
+  debugSerial.print(F(", "));
+  debugSerial.print(blocksWritten);
+  debugSerial.println(F(" bloques"));
+}
+
+void MidiTrace::onDawLinkChanged(uint8_t state) {
+  // Se sigue capturando un momento para ver también qué pasó después
+  if (mode == TRACE_MODE_UNTIL_LOST && state == DAW_LINK_LOST && !stopPending) {
+    stopPending = true;
+    stopAt = millis() + TRACE_POST_TRIGGER_MS;
+  }
+}
+
+void MidiTrace::printStatistics() const {
+  debugSerial.print(F("Captura MIDI: "));
+  if (!fileName[0]) {
+    debugSerial.println(F("ninguna"));
+    return;
+  }
+
+  debugSerial.print(fileName);
+  switch (mode) {
+    case TRACE_MODE_MANUAL:     debugSerial.println(F(" (manual)")); break;
+    case TRACE_MODE_UNTIL_LOST: debugSerial.println(F(" (hasta desconexión)")); break;
+    default:                    debugSerial.println(F(" (cerrada)")); break;
+  }
+  debugSerial.print(F("Registros capturados/perdidos: "));
+  debugSerial.print(recordsCaptured);
+  debugSerial.print(F("/"));
+  debugSerial.println(recordsDropped);
+  debugSerial.print(F("Bloques escritos/errores: "));
+  debugSerial.print(blocksWritten);
+  debugSerial.print(F("/"));
+  debugSerial.println(writeErrors);
+  debugSerial.print(F("Escritura SD max (us): "));
+  debugSerial.println(maxWriteMicros);
+}
@@ -0,0 +1,122 @@
+#ifndef MIDI_TRACE_H
+#define MIDI_TRACE_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define TRACE_BLOCK_SIZE        512   // Un sector de la SD por escritura
+#define TRACE_BLOCKS            1     // Era 2 → 1 (512 bytes ahorrados): la librería SD ya tiene su caché
+#define TRACE_BLOCK_HEADER      8
+#define TRACE_MAX_DATA          16    // Los SysEx se parten en trozos de este tamaño
+#define TRACE_FORMAT_VERSION    1
+#define TRACE_IDLE_FLUSH_MS     2000  // Bloque a medias con poco tráfico: escribirlo igualmente
+#define TRACE_SYNC_BLOCKS       16    // Actualizar el tamaño del fichero cada 8 KB
+#define TRACE_POST_TRIGGER_MS   1000  // Cola capturada tras perder el DAW
+#define TRACE_MAX_FILES         100
+
+// Flags de cada registro
+#define TRACE_FLAG_TX           0x80  // 0: recibido, 1: enviado
+#define TRACE_FLAG_USB          0x40  // 0: DIN, 1: USB
+#define TRACE_FLAG_ABSOLUTE     0x20  // Marca de 32 bits en vez de delta de 16
+#define TRACE_LENGTH_MASK       0x1F
+
+// Formato del fichero /logs/TRACEnn.MTR (little endian), bloques de 512 bytes:
+//   Cabecera de bloque (8 bytes):
+//     0-1  "MT"
+//     2-3  número de secuencia del bloque (desde 0)
+//     4-5  registros perdidos justo antes de este bloque (la SD no pudo vaciar el anterior)
+//     6    versión del formato (TRACE_FORMAT_VERSION)
+//     7    reservado (0)
+//   Registros, hasta un flags a 0 que rellena el resto del bloque:
+//     flags: TX, USB, ABSOLUTE y longitud de datos (1..TRACE_MAX_DATA)
+//     marca: ABSOLUTE ? micros() de 32 bits : micros desde el registro anterior (16 bits)
+//     datos: los bytes tal como van por el cable (con running status, sin status repetido)
+// El primer registro de cada bloque lleva siempre marca absoluta. La marca es la
+// del primer byte del mensaje; los real-time intercalados salen antes que el
+// mensaje que interrumpen. Un SysEx ocupa varios registros consecutivos que el
+// decodificador concatena por sentido y puerto hasta el F7.
+enum MidiTraceMode {
+  TRACE_MODE_OFF = 0,
+  TRACE_MODE_MANUAL,          // Hasta pararla desde el menú
+  TRACE_MODE_UNTIL_LOST,      // Se para sola al perder el DAW (+TRACE_POST_TRIGGER_MS)
+  TRACE_MODE_COUNT
+};
+
+// Reensamblado de mensajes de un cable (sentido y puerto)
+struct MidiTraceWire {
+  uint8_t status;             // Running status (0: ninguno)
+  uint8_t remaining;          // Bytes de datos que faltan del mensaje en curso
+  uint8_t length;
+  bool inSysEx;
+  unsigned long start;
+  uint8_t data[TRACE_MAX_DATA];
+};
+
+// Captura con marca de tiempo de todo el MIDI de entrada y salida a la SD.
+// Se alimenta en los mismos puntos que MidiStats y solo desde el loop; la
+// escritura en la SD se hace desde update(), un sector como mucho por pasada,
+// salvo que llegue un registro con el ring lleno: entonces se escribe ya.
+// El clock y los quarter frames que el generador maestro inyecta desde su ISR
+// no pasan por aquí y no aparecen en la captura.
+class MidiTrace {
+private:
+  uint8_t blocks[TRACE_BLOCKS][TRACE_BLOCK_SIZE];
+  uint8_t fillBlock;
+  uint8_t writeBlock;
+  uint8_t readyBlocks;
+  uint16_t fillPos;           // 0: bloque sin abrir
+  unsigned long blockOpenedAt;
+  unsigned long lastStamp;
+  uint16_t sequence;
+  uint16_t droppedPending;
+
+  MidiTraceWire wires[4];     // RX DIN, RX USB, TX DIN, TX USB
+
+  uint8_t mode;
+  bool stopPending;
+  unsigned long stopAt;
+  File traceFile;
+  char fileName[20];
+
+  // Estadísticas de la última captura
+  uint32_t recordsCaptured;
+  uint32_t recordsDropped;
+  uint32_t blocksWritten;
+  uint32_t maxWriteMicros;
+  uint16_t writeErrors;
+
+  void captureByte(uint8_t wire, uint8_t data);
+  void flushWire(uint8_t wire);
+  void appendRecord(uint8_t wire, unsigned long stamp, const uint8_t* data, uint8_t length);
+  bool needsAbsolute(unsigned long stamp) const;
+  bool openBlock();
+  void closeBlock();
+  bool writeReadyBlock();
+  bool openFile();
+  void finish(bool flushData);
+
+public:
+  MidiTrace();
+
+  // Desde los puntos de consumo/escritura de cada puerto (nunca desde ISR)
+  void captureIn(uint8_t port, uint8_t data) { if (mode) captureByte(port, data); }
+  void captureOut(uint8_t port, uint8_t data) { if (mode) captureByte(2 + port, data); }
+
+  // Llamar desde loop: escribe un bloque lleno y atiende la parada diferida
+  void update(unsigned long currentTime);
+
+  // Disparadores
+  bool start(uint8_t newMode);
+  void stop();
+  void onDawLinkChanged(uint8_t state);
+
+  uint8_t getMode() const { return mode; }
+  bool isCapturing() const { return mode != TRACE_MODE_OFF; }
+  const char* getFileName() const { return fileName; }
+
+  void printStatistics() const;
+};
+
+extern MidiTrace midiTrace;
+
+#endif // MIDI_TRACE_H
@@ -0,0 +1,518 @@
+#include "MidiTxQueue.h"
+#include "Config.h"
+#include "MidiUart.h"
+#include "UsbMidiPort.h"
+
+#define REALTIME_MASK (TX_REALTIME_QUEUE_SIZE - 1)
+#define SYSEX_MASK    (TX_SYSEX_BUFFER_SIZE - 1)
+#define THRU_MASK     (TX_THRU_BUFFER_SIZE - 1)
+#define THRU_MARK_MASK (TX_THRU_MESSAGES - 1)
+
+MidiTxQueue::MidiTxQueue()
+  : realTimeHead(0), realTimeCount(0), sysExHead(0), sysExCount(0), sysExInProgress(false),
+    thruHead(0), thruCount(0), thruMarkHead(0), thruMarkCount(0), thruSysExReceiving(false),
+    thruSysExSending(false), thruSysExDiscarding(false), thruSysExPorts(0), thruLastByteTime(0),
+    outputPorts(MIDI_PORT_DIN), requestedPorts(MIDI_PORT_DIN), runningStatusEnabled(true), lastStatusSent(0), lastStatusRefresh(0), bytesSent(0), bytesSaved(0),
+    messagesCoalesced(0), messagesDropped(0), thruMessagesSent(0), thruOverflows(0),
+    thruSysExTruncated(0), thruLatencyLastUs(0), thruLatencyMaxUs(0), thruLatencyAvgQ4(0),
+    bytesThisSecond(0), bytesPerSecond(0),
+    rateWindowStart(0)
+{
+  userRing = {userSlots, TX_USER_QUEUE_SIZE, 0, 0, 0};
+  feedbackRing = {feedbackSlots, TX_FEEDBACK_QUEUE_SIZE, 0, 0, 0};
+}
+
+bool MidiTxQueue::enqueueRealTime(uint8_t status, uint8_t skipPorts) {
+  if (realTimeCount >= TX_REALTIME_QUEUE_SIZE) {
+    messagesDropped++;
+    return false;
+  }
+  uint8_t slot = (realTimeHead + realTimeCount) & REALTIME_MASK;
+  realTimeBuffer[slot] = status;
+  realTimeSkip[slot] = skipPorts;
+  realTimeCount++;
+  return true;
+}
+
+bool MidiTxQueue::enqueueChannel(uint8_t priority, uint8_t status, uint8_t data1, uint8_t data2) {
+  data1 &= 0x7F;
+  data2 &= 0x7F;
+  bool coalesce = !(priority & TX_NO_COALESCE) && isCoalescable(status);
+  priority &= ~TX_NO_COALESCE;
+  
+  if (priority == TX_PRIO_FEEDBACK) {
+    return pushChannel(feedbackRing, status, data1, data2, coalesce);
+  }
+  
+  // Un movimiento del usuario deja obsoleto el feedback pendiente del mismo
+  // destino: quitarlo de la cola para que no salga un valor viejo (ni el
+  // nuevo por duplicado)
+  if (coalesce) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < feedbackRing.count; i++) {
+      const TxChannelMessage& msg = feedbackRing.slots[(feedbackRing.head + i) % feedbackRing.capacity];
+      if (isSameTarget(msg, status, data1)) {
+        messagesCoalesced++;
+        continue;
+      }
+      if (kept != i) feedbackRing.slots[(feedbackRing.head + kept) % feedbackRing.capacity] = msg;
+      kept++;
+    }
+    feedbackRing.count = kept;
+  }
+  return pushChannel(userRing, status, data1, data2, coalesce);
+}
+
+bool MidiTxQueue::isSameTarget(const TxChannelMessage& msg, uint8_t status, uint8_t data1) {
+  // Pitch Bend: un destino por canal; CC: canal y número
+  return msg.status == status && (msg.data1 == data1 || (status & 0xF0) == 0xE0);
+}
+
+bool MidiTxQueue::pushChannel(TxChannelRing& ring, uint8_t status, uint8_t data1, uint8_t data2, bool coalesce) {
+  // Último valor gana: un CC/Pitch Bend pendiente para el mismo destino se actualiza
+  if (coalesce) {
+    for (uint8_t i = 0; i < ring.count; i++) {
+      TxChannelMessage& msg = ring.slots[(ring.head + i) % ring.capacity];
+      if (isSameTarget(msg, status, data1)) {
+        msg.data1 = data1;
+        msg.data2 = data2;
+        messagesCoalesced++;
+        return true;
+      }
+    }
+  }
+  
+  if (ring.count >= ring.capacity) {
+    messagesDropped++;
+    return false;
+  }
+  
+  TxChannelMessage& slot = ring.slots[(ring.head + ring.count) % ring.capacity];
+  slot.status = status;
+  slot.data1 = data1;
+  slot.data2 = data2;
+  ring.count++;
+  if (ring.count > ring.peak) ring.peak = ring.count;
+  return true;
+}
+
+bool MidiTxQueue::enqueueSysEx(const uint8_t* data, uint16_t length) {
+  if (!data || length == 0) return false;
+  
+  // Añadir delimitadores si el llamador no los incluye
+  bool addStart = data[0] != 0xF0;
+  bool addEnd = data[length - 1] != 0xF7;
+  uint16_t total = length + addStart + addEnd;
+  
+  // Todo o nada: un SysEx parcial corrompería el stream
+  if (total > TX_SYSEX_BUFFER_SIZE - sysExCount) {
+    messagesDropped++;
+    return false;
+  }
+  
+  uint8_t tail = (sysExHead + sysExCount) & SYSEX_MASK;
+  if (addStart) {
+    sysExBuffer[tail] = 0xF0;
+    tail = (tail + 1) & SYSEX_MASK;
+  }
+  for (uint16_t i = 0; i < length; i++) {
+    sysExBuffer[tail] = data[i];
+    tail = (tail + 1) & SYSEX_MASK;
+  }
+  if (addEnd) {
+    sysExBuffer[tail] = 0xF7;
+  }
+  sysExCount += total;
+  return true;
+}
+
+bool MidiTxQueue::enqueueThru(uint8_t skipPorts, uint8_t status, uint8_t data1, uint8_t data2, unsigned long stampUs) {
+  uint8_t length = thruMessageLength(status);
+  
+  // Un status trunca el SysEx thru que siga abierto (ya tiene reservado su F7)
+  if (thruSysExReceiving) {
+    closeThruSysEx();
+    thruSysExTruncated++;
+  }
+  if (TX_THRU_BUFFER_SIZE - thruCount < length || thruMarkCount >= TX_THRU_MESSAGES) {
+    thruOverflows++;
+    return false;
+  }
+  
+  pushThruMark(skipPorts, stampUs);
+  pushThruByte(status);
+  if (length > 1) pushThruByte(data1 & 0x7F);
+  if (length > 2) pushThruByte(data2 & 0x7F);
+  return true;
+}
+
+bool MidiTxQueue::enqueueThruSysEx(uint8_t skipPorts, uint8_t data, unsigned long stampUs) {
+  if (data == 0xF0) {
+    if (thruSysExReceiving) closeThruSysEx();
+    
+    // F0 más un byte de reserva: el F7 de cierre siempre cabe
+    if (TX_THRU_BUFFER_SIZE - thruCount < 2 || thruMarkCount >= TX_THRU_MESSAGES) {
+      thruOverflows++;
+      return false;
+    }
+    pushThruMark(skipPorts, stampUs);
+    pushThruByte(0xF0);
+    thruSysExReceiving = true;
+    thruLastByteTime = millis();
+    return true;
+  }
+  
+  if (!thruSysExReceiving) return false;
+  
+  if (data == 0xF7) {
+    pushThruByte(0xF7);
+    thruSysExReceiving = false;
+    return true;
+  }
+  
+  if (TX_THRU_BUFFER_SIZE - thruCount < 2) {
+    // La entrada va más rápida que la salida (USB -> DIN): cortar el SysEx
+    // con su F7 antes que dejarlo sin cerrar
+    closeThruSysEx();
+    thruSysExTruncated++;
+    return false;
+  }
+  pushThruByte(data);
+  thruLastByteTime = millis();
+  return true;
+}
+
+void MidiTxQueue::closeThruSysEx() {
+  pushThruByte(0xF7);
+  thruSysExReceiving = false;
+}
+
+void MidiTxQueue::pushThruByte(uint8_t data) {
+  thruBuffer[(thruHead + thruCount) & THRU_MASK] = data;
+  thruCount++;
+}
+
+void MidiTxQueue::pushThruMark(uint8_t skipPorts, unsigned long stampUs) {
+  TxThruMark& mark = thruMarks[(thruMarkHead + thruMarkCount) & THRU_MARK_MASK];
+  mark.stampUs = stampUs;
+  mark.skipPorts = skipPorts;
+  thruMarkCount++;
+}
+
+void MidiTxQueue::service() {
+  unsigned long now = millis();
+  
+  if (now - rateWindowStart >= 1000) {
+    bytesPerSecond = bytesThisSecond;
+    bytesThisSecond = 0;
+    rateWindowStart = now;
+  }
+  
+  // Reenviar status completo de vez en cuando para receptores recién conectados
+  if (now - lastStatusRefresh >= TX_RUNNING_STATUS_REFRESH_MS) {
+    lastStatusSent = 0;
+    lastStatusRefresh = now;
+  }
+  
+  if (requestedPorts != outputPorts && !sysExInProgress && !thruSysExSending) {
+    outputPorts = requestedPorts;
+    lastStatusSent = 0;
+  }
+  
+  // La entrada dejó un SysEx thru sin terminar: cerrarlo para no retener la salida local
+  if (thruSysExReceiving && now - thruLastByteTime >= TX_THRU_SYSEX_TIMEOUT_MS) {
+    closeThruSysEx();
+    thruSysExTruncated++;
+  }
+  
+  // 1. Real-time: puede intercalarse en cualquier punto, incluso dentro de un SysEx
+  while (realTimeCount > 0) {
+    uint8_t ports = outputPorts & ~realTimeSkip[realTimeHead];
+    if (!portsHaveRoom(ports, 1, 1)) break;
+    
+    uint8_t status = realTimeBuffer[realTimeHead];
+    realTimeHead = (realTimeHead + 1) & REALTIME_MASK;
+    realTimeCount--;
+    if (!ports) continue;  // Thru sin destino tras un cambio de puertos
+    
+    writePorts(ports, status);
+    if ((ports & MIDI_PORT_DIN) && !sysExInProgress && !thruSysExSending) midiUart.endMessage();
+    bytesSent++;
+    bytesThisSecond++;
+  }
+  
+  // 2. Un SysEx a medias debe completarse antes de cualquier otro mensaje
+  if (sysExInProgress) {
+    sendSysExBytes();
+    if (sysExInProgress) return;
+  }
+  
+  // 3. Thru: los mensajes ya están ordenados; un SysEx thru abierto retiene lo local
+  if (!sendThru()) return;
+  
+  // 4. Movimientos del usuario, 5. feedback de canal, 6. SysEx
+  while (sendChannelFromRing(userRing)) {}
+  if (userRing.count > 0) return;
+  while (sendChannelFromRing(feedbackRing)) {}
+  if (feedbackRing.count > 0) return;
+  sendSysExBytes();
+}
+
+bool MidiTxQueue::sendChannelFromRing(TxChannelRing& ring) {
+  if (ring.count == 0) return false;
+  
+  const TxChannelMessage& msg = ring.slots[ring.head];
+  uint8_t length = messageLength(msg.status);
+  bool useRunningStatus = runningStatusEnabled && (msg.status == lastStatusSent);
+  uint8_t needed = useRunningStatus ? length - 1 : length;
+  
+  if (!portsHaveRoom(outputPorts, needed, length)) return false;
+  
+  if (outputPorts & MIDI_PORT_DIN) {
+    if (useRunningStatus) {
+      bytesSaved++;
+    } else {
+      midiUart.write(msg.status);
+      lastStatusSent = msg.status;
+    }
+    midiUart.write(msg.data1);
+    if (length == 3) midiUart.write(msg.data2);
+    midiUart.endMessage();
+  }
+  if (outputPorts & MIDI_PORT_USB) {
+    usbMidi.write(msg.status);
+    usbMidi.write(msg.data1);
+    if (length == 3) usbMidi.write(msg.data2);
+  }
+  
+  bytesSent += needed;
+  bytesThisSecond += needed;
+  ring.head = (ring.head + 1) % ring.capacity;
+  ring.count--;
+  return true;
+}
+
+void MidiTxQueue::sendSysExBytes() {
+  while (sysExCount > 0 && portsHaveRoom(outputPorts, 1, 1)) {
+    uint8_t data = sysExBuffer[sysExHead];
+    writePorts(outputPorts, data);
+    sysExHead = (sysExHead + 1) & SYSEX_MASK;
+    sysExCount--;
+    bytesSent++;
+    bytesThisSecond++;
+    
+    if (data == 0xF0) {
+      sysExInProgress = true;
+      lastStatusSent = 0;  // SysEx cancela el running status
+    } else if (data == 0xF7) {
+      if (outputPorts & MIDI_PORT_DIN) midiUart.endMessage();
+      sysExInProgress = false;
+      return;
+    }
+  }
+}
+
+bool MidiTxQueue::sendThru() {
+  while (thruCount > 0) {
+    uint8_t status = thruBuffer[thruHead];
+    
+    if (thruSysExDiscarding) {
+      // SysEx sin destino: consumirlo sin retener la salida local
+      thruHead = (thruHead + 1) & THRU_MASK;
+      thruCount--;
+      if (status == 0xF7) thruSysExDiscarding = false;
+      continue;
+    }
+    
+    if (thruSysExSending || status == 0xF0) {
+      // SysEx en streaming, con los puertos fijados al enviar su F0
+      if (!thruSysExSending) {
+        thruSysExPorts = outputPorts & ~thruMarks[thruMarkHead].skipPorts;
+        if (!thruSysExPorts) {
+          dropThruMark();
+          thruSysExDiscarding = true;
+          continue;
+        }
+        if (!portsHaveRoom(thruSysExPorts, 1, 1)) return false;
+      }
+      while (thruCount > 0 && portsHaveRoom(thruSysExPorts, 1, 1)) {
+        uint8_t data = thruBuffer[thruHead];
+        writePorts(thruSysExPorts, data);
+        thruHead = (thruHead + 1) & THRU_MASK;
+        thruCount--;
+        bytesSent++;
+        bytesThisSecond++;
+        
+        if (data == 0xF0) {
+          thruSysExSending = true;
+          lastStatusSent = 0;
+          recordThruLatency();
+        } else if (data == 0xF7) {
+          if (thruSysExPorts & MIDI_PORT_DIN) midiUart.endMessage();
+          thruSysExSending = false;
+          break;
+        }
+      }
+      if (thruSysExSending) return false;
+      continue;
+    }
+    
+    // Mensaje completo, a todos los puertos de salida salvo los excluidos
+    uint8_t length = thruMessageLength(status);
+    uint8_t ports = outputPorts & ~thruMarks[thruMarkHead].skipPorts;
+    if (!ports) {
+      thruHead = (thruHead + length) & THRU_MASK;
+      thruCount -= length;
+      dropThruMark();
+      continue;
+    }
+    bool useRunningStatus = runningStatusEnabled && status < 0xF0 && status == lastStatusSent;
+    uint8_t dinBytes = useRunningStatus ? length - 1 : length;
+    if (!portsHaveRoom(ports, dinBytes, length)) return false;
+    
+    for (uint8_t i = 0; i < length; i++) {
+      uint8_t data = thruBuffer[(thruHead + i) & THRU_MASK];
+      if ((ports & MIDI_PORT_DIN) && !(i == 0 && useRunningStatus)) midiUart.write(data);
+      if (ports & MIDI_PORT_USB) usbMidi.write(data);
+    }
+    if (ports & MIDI_PORT_DIN) {
+      midiUart.endMessage();
+      if (useRunningStatus) bytesSaved++;
+      lastStatusSent = (status < 0xF0) ? status : 0;  // System common cancela el running status
+      bytesSent += dinBytes;
+      bytesThisSecond += dinBytes;
+    }
+    thruHead = (thruHead + length) & THRU_MASK;
+    thruCount -= length;
+    recordThruLatency();
+  }
+  // Buffer vacío con un SysEx thru abierto: lo local sigue esperando al F7
+  return !thruSysExSending;
+}
+
+void MidiTxQueue::dropThruMark() {
+  // Los puertos de salida cambiaron con el mensaje en cola: ni se envía ni cuenta
+  thruMarkHead = (thruMarkHead + 1) & THRU_MARK_MASK;
+  thruMarkCount--;
+}
+
+void MidiTxQueue::recordThruLatency() {
+  const TxThruMark& mark = thruMarks[thruMarkHead];
+  thruMarkHead = (thruMarkHead + 1) & THRU_MARK_MASK;
+  thruMarkCount--;
+  thruMessagesSent++;
+  
+  unsigned long elapsed = micros() - mark.stampUs;
+  uint16_t latency = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+  thruLatencyLastUs = latency;
+  if (latency > thruLatencyMaxUs) thruLatencyMaxUs = latency;
+  if (thruMessagesSent == 1) {
+    thruLatencyAvgQ4 = (uint32_t)latency << 4;
+  } else {
+    thruLatencyAvgQ4 += (int32_t)(((uint32_t)latency << 4) - thruLatencyAvgQ4) / 16;
+  }
+}
+
+bool MidiTxQueue::portsHaveRoom(uint8_t ports, uint8_t dinBytes, uint8_t usbBytes) {
+  // El puerto más lento marca el ritmo: un mensaje sale entero por todos o por ninguno
+  if ((ports & MIDI_PORT_DIN) && midiUart.availableForWrite() < dinBytes) return false;
+  if ((ports & MIDI_PORT_USB) && usbMidi.isEnabled() && usbMidi.availableForWrite() < usbBytes) return false;
+  return true;
+}
+
+void MidiTxQueue::writePorts(uint8_t ports, uint8_t data) {
+  if (ports & MIDI_PORT_DIN) midiUart.write(data);
+  if (ports & MIDI_PORT_USB) usbMidi.write(data);
+}
+
+void MidiTxQueue::setOutputPorts(uint8_t ports) {
+  ports &= MIDI_PORT_ALL;
+  requestedPorts = ports ? ports : MIDI_PORT_DIN;
+}
+
+void MidiTxQueue::clear() {
+  realTimeCount = 0;
+  userRing.count = 0;
+  feedbackRing.count = 0;
+  // Un SysEx ya empezado se deja terminar para no corromper el stream
+  if (!sysExInProgress) {
+    sysExCount = 0;
+  }
+  if (!thruSysExSending && !thruSysExReceiving) {
+    thruCount = 0;
+    thruMarkCount = 0;
+    thruSysExDiscarding = false;
+  }
+}
+
+bool MidiTxQueue::isIdle() const {
+  return realTimeCount == 0 && userRing.count == 0 && feedbackRing.count == 0 && sysExCount == 0 &&
+         thruCount == 0;
+}
+
+uint8_t MidiTxQueue::getDepth() const {
+  return realTimeCount + userRing.count + feedbackRing.count;
+}
+
+bool MidiTxQueue::isCoalescable(uint8_t status) {
+  uint8_t type = status & 0xF0;
+  return type == 0xB0 || type == 0xE0;
+}
+
+uint8_t MidiTxQueue::messageLength(uint8_t status) {
+  uint8_t type = status & 0xF0;
+  return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+}
+
+uint8_t MidiTxQueue::thruMessageLength(uint8_t status) {
+  if (status < 0xF0) return messageLength(status);
+  switch (status) {
+    case 0xF1: case 0xF3: return 2;
+    case 0xF2: return 3;
+    default: return 1;
+  }
+}
+
+void MidiTxQueue::printStatistics() const {
+  debugSerial.print(F("Cola TX (actual/pico): "));
+  debugSerial.print(getDepth());
+  debugSerial.print(F("/"));
+  debugSerial.println(getPeakDepth());
+  debugSerial.print(F("SysEx TX pendiente: "));
+  debugSerial.println(sysExCount);
+  debugSerial.print(F("Mensajes TX descartados: "));
+  debugSerial.println(messagesDropped);
+  debugSerial.print(F("Mensajes TX fusionados: "));
+  debugSerial.println(messagesCoalesced);
+  debugSerial.print(F("Bytes TX (total/ahorrados): "));
+  debugSerial.print(bytesSent);
+  debugSerial.print(F("/"));
+  debugSerial.println(bytesSaved);
+  debugSerial.print(F("Bytes TX/s: "));
+  debugSerial.println(bytesPerSecond);
+  debugSerial.print(F("Thru TX mensajes/desbordes/SysEx cortados: "));
+  debugSerial.print(thruMessagesSent);
+  debugSerial.print(F("/"));
+  debugSerial.print(thruOverflows);
+  debugSerial.print(F("/"));
+  debugSerial.println(thruSysExTruncated);
+  debugSerial.print(F("Thru latencia us (ult/media/max): "));
+  debugSerial.print(thruLatencyLastUs);
+  debugSerial.print(F("/"));
+  debugSerial.print(thruLatencyAvgQ4 >> 4);
+  debugSerial.print(F("/"));
+  debugSerial.println(thruLatencyMaxUs);
+}
+
+void MidiTxQueue::resetStatistics() {
+  bytesSent = 0;
+  bytesSaved = 0;
+  messagesCoalesced = 0;
+  messagesDropped = 0;
+  thruMessagesSent = 0;
+  thruOverflows = 0;
+  thruSysExTruncated = 0;
+  thruLatencyMaxUs = 0;
+  userRing.peak = userRing.count;
+  feedbackRing.peak = feedbackRing.count;
+}
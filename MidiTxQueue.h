@@ -0,0 +1,162 @@
+#ifndef MIDI_TX_QUEUE_H
+#define MIDI_TX_QUEUE_H
+
+#include <Arduino.h>
+
+// Tamaños de las colas de transmisión
+#define TX_REALTIME_QUEUE_SIZE   8     // Bytes real-time (potencia de 2)
+#define TX_USER_QUEUE_SIZE       32    // Mensajes de canal de usuario
+#define TX_FEEDBACK_QUEUE_SIZE   16    // Mensajes de canal de feedback
+#define TX_SYSEX_BUFFER_SIZE     128   // Bytes SysEx pendientes (potencia de 2)
+#define TX_RUNNING_STATUS_REFRESH_MS 1000  // Reenviar status completo periódicamente
+#define TX_THRU_BUFFER_SIZE      64    // Bytes de thru pendientes (potencia de 2)
+#define TX_THRU_MESSAGES         16    // Mensajes de thru pendientes (potencia de 2)
+#define TX_THRU_SYSEX_TIMEOUT_MS 500   // SysEx thru sin bytes nuevos: cerrarlo y liberar la salida
+
+// Clases de prioridad (menor = antes)
+enum TxPriority {
+  TX_PRIO_REALTIME = 0,   // Transporte y mensajes real-time
+  TX_PRIO_USER = 1,       // Movimientos del usuario
+  TX_PRIO_FEEDBACK = 2    // Peticiones SysEx y feedback
+};
+
+// Combinable con la prioridad: mensajes relativos (deltas) que no pueden
+// fusionarse con otro pendiente del mismo destino sin perder movimiento
+#define TX_NO_COALESCE   0x80
+
+struct TxChannelMessage {
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+};
+
+// Cola circular de mensajes de canal con reemplazo "último valor gana"
+struct TxChannelRing {
+  TxChannelMessage* slots;
+  uint8_t capacity;
+  uint8_t head;
+  uint8_t count;
+  uint8_t peak;
+};
+
+// Un mensaje thru pendiente: llegada y puertos que no deben recibirlo
+struct TxThruMark {
+  unsigned long stampUs;
+  uint8_t skipPorts;
+};
+
+class MidiTxQueue {
+private:
+  uint8_t realTimeBuffer[TX_REALTIME_QUEUE_SIZE];
+  uint8_t realTimeSkip[TX_REALTIME_QUEUE_SIZE];  // Puertos excluidos (thru)
+  uint8_t realTimeHead;
+  uint8_t realTimeCount;
+  
+  TxChannelMessage userSlots[TX_USER_QUEUE_SIZE];
+  TxChannelMessage feedbackSlots[TX_FEEDBACK_QUEUE_SIZE];
+  TxChannelRing userRing;
+  TxChannelRing feedbackRing;
+  
+  uint8_t sysExBuffer[TX_SYSEX_BUFFER_SIZE];
+  uint8_t sysExHead;
+  uint8_t sysExCount;
+  bool sysExInProgress;      // F0 enviado, F7 pendiente
+  
+  // Thru: mensajes completos con status explícito y SysEx en streaming.
+  // Mientras un SysEx thru está abierto en la salida, solo pasan real-time
+  uint8_t thruBuffer[TX_THRU_BUFFER_SIZE];
+  uint8_t thruHead;
+  uint8_t thruCount;
+  TxThruMark thruMarks[TX_THRU_MESSAGES];
+  uint8_t thruMarkHead;
+  uint8_t thruMarkCount;
+  bool thruSysExReceiving;   // F0 encolado, F7 aún no
+  bool thruSysExSending;     // F0 enviado, F7 aún no
+  bool thruSysExDiscarding;  // SysEx sin puertos de salida: se consume hasta F7
+  uint8_t thruSysExPorts;
+  unsigned long thruLastByteTime;
+  
+  // Puertos de salida (MIDI_PORT_*): cada mensaje sale por todos a la vez
+  uint8_t outputPorts;
+  uint8_t requestedPorts;    // Se aplica fuera de un SysEx a medias
+  
+  // Running status (solo DIN: el enlace USB va sobrado de ancho de banda)
+  bool runningStatusEnabled;
+  uint8_t lastStatusSent;
+  unsigned long lastStatusRefresh;
+  
+  // Estadísticas
+  uint32_t bytesSent;
+  uint32_t bytesSaved;       // Ahorrados por running status
+  uint32_t messagesCoalesced;
+  uint32_t messagesDropped;
+  uint32_t thruMessagesSent;
+  uint32_t thruOverflows;
+  uint32_t thruSysExTruncated;
+  uint16_t thruLatencyLastUs;
+  uint16_t thruLatencyMaxUs;
+  uint32_t thruLatencyAvgQ4;   // Media exponencial 1/16, us * 16
+  uint32_t bytesThisSecond;
+  uint16_t bytesPerSecond;
+  unsigned long rateWindowStart;
+  
+  bool pushChannel(TxChannelRing& ring, uint8_t status, uint8_t data1, uint8_t data2, bool coalesce);
+  bool sendChannelFromRing(TxChannelRing& ring);
+  void sendSysExBytes();
+  bool sendThru();
+  void pushThruByte(uint8_t data);
+  void pushThruMark(uint8_t skipPorts, unsigned long stampUs);
+  void closeThruSysEx();
+  void recordThruLatency();
+  void dropThruMark();
+  bool portsHaveRoom(uint8_t ports, uint8_t dinBytes, uint8_t usbBytes);
+  void writePorts(uint8_t ports, uint8_t data);
+  static bool isCoalescable(uint8_t status);
+  static bool isSameTarget(const TxChannelMessage& msg, uint8_t status, uint8_t data1);
+  static uint8_t messageLength(uint8_t status);
+  static uint8_t thruMessageLength(uint8_t status);
+
+public:
+  MidiTxQueue();
+  
+  // Encolado (nunca bloquea; devuelve false si se descarta)
+  bool enqueueRealTime(uint8_t status, uint8_t skipPorts = 0);
+  bool enqueueChannel(uint8_t priority, uint8_t status, uint8_t data1, uint8_t data2 = 0);
+  bool enqueueSysEx(const uint8_t* data, uint16_t length);
+  
+  // Thru: mensajes de canal/system common completos y SysEx byte a byte.
+  // skipPorts (MIDI_PORT_*) no lo reciben (eco al puerto de origen)
+  bool enqueueThru(uint8_t skipPorts, uint8_t status, uint8_t data1, uint8_t data2, unsigned long stampUs);
+  bool enqueueThruSysEx(uint8_t skipPorts, uint8_t data, unsigned long stampUs);
+  bool isThruSysExActive() const { return thruSysExSending; }
+  
+  // Transmisión: escribe solo lo que cabe en el buffer del UART
+  void service();
+  void clear();
+  
+  // Sin running status cada mensaje lleva su status: necesario si otro
+  // emisor (quarter frames del generador MTC) intercala system common
+  void setRunningStatus(bool enable) { runningStatusEnabled = enable; lastStatusSent = 0; }
+  bool isRunningStatusEnabled() const { return runningStatusEnabled; }
+  
+  // Un SysEx empezado se termina por los mismos puertos antes de cambiarlos
+  void setOutputPorts(uint8_t ports);
+  uint8_t getOutputPorts() const { return outputPorts; }
+  bool isIdle() const;
+  
+  // Diagnóstico
+  uint8_t getDepth() const;
+  uint8_t getPeakDepth() const { return userRing.peak + feedbackRing.peak; }
+  uint32_t getBytesSent() const { return bytesSent; }
+  uint32_t getBytesSaved() const { return bytesSaved; }
+  uint32_t getMessagesCoalesced() const { return messagesCoalesced; }
+  uint32_t getMessagesDropped() const { return messagesDropped; }
+  uint32_t getThruOverflows() const { return thruOverflows; }
+  uint16_t getBytesPerSecond() const { return bytesPerSecond; }
+  uint16_t getThruLatencyMaxUs() const { return thruLatencyMaxUs; }
+  uint16_t getThruLatencyAvgUs() const { return thruLatencyAvgQ4 >> 4; }
+  void printStatistics() const;
+  void resetStatistics();
+};
+
+#endif // MIDI_TX_QUEUE_H
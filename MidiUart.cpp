@@ -0,0 +1,252 @@
+#include "MidiUart.h"
+#include "MidiStats.h"
+#include "MidiTrace.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#define RX_MASK (MIDI_RX_BUFFER_SIZE - 1)
+#define TX_MASK (MIDI_TX_BUFFER_SIZE - 1)
+
+MidiUart midiUart;
+
+MidiUart::MidiUart()
+  : rxHead(0), rxTail(0), txHead(0), txTail(0), rxHighWater(0),
+    rxOverruns(0), rxFramingErrors(0), rxRingOverflows(0), pingDetect(false),
+    pingRequests(0), rxRunningStatus(0), rxDataIndex(0), rxFirstData(0),
+    clockStampCount(0), clockReadCount(0), lastClockMicros(0), clockStampsLost(0),
+    injectRealTimeCount(0), injectCommonCount(0), txOpenBytes(0), txSysEx(false),
+    txHold(TX_HOLD_NONE)
+{
+}
+
+void MidiUart::begin(unsigned long baud) {
+  // Modo doble velocidad: divisor exacto para 31250 baud a 16 MHz
+  uint16_t ubrr = (F_CPU / 8 / baud) - 1;
+  
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rxHead = rxTail = 0;
+    txHead = txTail = 0;
+    UBRR1 = ubrr;
+    UCSR1A = _BV(U2X1);
+    UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);  // 8N1
+    UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+  }
+}
+
+void MidiUart::end() {
+  // Esperar a vaciar la transmisión pendiente
+  while (txHead != txTail) {
+    pollTransmit();
+  }
+  UCSR1B = 0;
+}
+
+int MidiUart::available() {
+  return (uint8_t)(rxHead - rxTail) & RX_MASK;
+}
+
+int MidiUart::peek() {
+  if (rxHead == rxTail) return -1;
+  return rxBuffer[rxTail];
+}
+
+int MidiUart::read() {
+  if (rxHead == rxTail) return -1;
+  uint8_t data = rxBuffer[rxTail];
+  rxTail = (rxTail + 1) & RX_MASK;
+  
+  if (data == 0xF8) {
+    uint8_t slot = clockReadCount++;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      // Más de MIDI_CLOCK_STAMPS clocks sin leer: la marca ya se sobrescribió
+      if ((uint8_t)(clockStampCount - slot) <= MIDI_CLOCK_STAMPS) {
+        lastClockMicros = clockStamps[slot & (MIDI_CLOCK_STAMPS - 1)];
+      } else {
+        lastClockMicros = micros();
+        clockStampsLost++;
+      }
+    }
+  }
+  return data;
+}
+
+size_t MidiUart::write(uint8_t data) {
+  midiStats.countOut(STATS_PORT_DIN, data);
+  midiTrace.captureOut(STATS_PORT_DIN, data);
+  
+  // Antes de publicar el byte, para que la ISR nunca vea una frontera falsa
+  if (txOpenBytes < 0xFF) txOpenBytes++;
+  
+  // Ring vacío, sin retención ni inyecciones y registro libre: escribir directamente.
+  // Atómico: la ISR del generador también escribe en UDR1 si lo ve libre, y un
+  // segundo byte con el registro ocupado se perdería sin aviso
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (txHead == txTail && txHold == TX_HOLD_NONE && injectRealTimeCount == 0 &&
+        injectCommonCount == 0 && (UCSR1A & _BV(UDRE1))) {
+      trackSysEx(data);
+      UDR1 = data;
+      return 1;
+    }
+  }
+  
+  uint8_t next = (txHead + 1) & TX_MASK;
+  while (next == txTail) {
+    pollTransmit();  // Ring lleno: bloquea como HardwareSerial
+  }
+  
+  txBuffer[txHead] = data;
+  txHead = next;
+  UCSR1B |= _BV(UDRIE1);
+  return 1;
+}
+
+uint8_t MidiUart::availableForWrite() {
+  return TX_MASK - ((uint8_t)(txHead - txTail) & TX_MASK);
+}
+
+void MidiUart::pollTransmit() {
+  // Con interrupciones deshabilitadas la ISR UDRE no corre: atenderla a mano
+  if (!(SREG & 0x80) && (UCSR1A & _BV(UDRE1))) {
+    handleTxInterrupt();
+  }
+}
+
+inline void MidiUart::handleRxInterrupt() {
+  uint8_t status = UCSR1A;  // Leer estado antes que el dato
+  uint8_t data = UDR1;
+  
+  if (status & _BV(DOR1)) rxOverruns++;
+  if (status & _BV(FE1)) {
+    rxFramingErrors++;
+    return;
+  }
+  
+  uint8_t next = (rxHead + 1) & RX_MASK;
+  if (next == rxTail) {
+    rxRingOverflows++;
+    return;
+  }
+  
+  rxBuffer[rxHead] = data;
+  rxHead = next;
+  
+  uint8_t used = (uint8_t)(rxHead - rxTail) & RX_MASK;
+  if (used > rxHighWater) rxHighWater = used;
+  
+  if (data == 0xF8) {
+    clockStamps[clockStampCount & (MIDI_CLOCK_STAMPS - 1)] = micros();
+    clockStampCount++;
+  }
+  
+  if (pingDetect) detectPing(data);
+}
+
+inline void MidiUart::detectPing(uint8_t data) {
+  // Seguimiento mínimo del running status: solo interesa Note On canal 1
+  if (data >= 0xF8) return;
+  if (data & 0x80) {
+    rxRunningStatus = data;
+    rxDataIndex = 0;
+    return;
+  }
+  if (rxRunningStatus != 0x90) return;
+  
+  if (rxDataIndex == 0) {
+    rxFirstData = data;
+    rxDataIndex = 1;
+  } else {
+    if (rxFirstData == 0x00 && data == 0x00 && pingRequests < 0xFF) pingRequests++;
+    rxDataIndex = 0;
+  }
+}
+
+void MidiUart::setPingDetect(bool enable) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pingDetect = enable;
+    pingRequests = 0;
+    rxRunningStatus = 0;
+    rxDataIndex = 0;
+  }
+}
+
+uint8_t MidiUart::takePingRequests() {
+  uint8_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    value = pingRequests;
+    pingRequests = 0;
+  }
+  return value;
+}
+
+inline void MidiUart::handleTxInterrupt() {
+  // 1. Real-time del generador: válido entre dos bytes cualesquiera
+  if (injectRealTimeCount) {
+    UDR1 = injectRealTime[0];
+    injectRealTime[0] = injectRealTime[1];
+    injectRealTimeCount--;
+    return;
+  }
+  
+  bool boundary = atMessageBoundary();
+  
+  // 2. System common del generador (quarter frame) en cuanto hay frontera
+  if (injectCommonCount && boundary) {
+    UDR1 = injectCommon[2 - injectCommonCount];
+    injectCommonCount--;
+    return;
+  }
+  
+  // 3. Retención previa a un evento, o nada que enviar
+  if (txHead == txTail || txHold == TX_HOLD_BYTE ||
+      (txHold == TX_HOLD_MESSAGE && boundary)) {
+    UCSR1B &= ~_BV(UDRIE1);
+    return;
+  }
+  
+  uint8_t data = txBuffer[txTail];
+  trackSysEx(data);
+  UDR1 = data;
+  txTail = (txTail + 1) & TX_MASK;
+}
+
+uint16_t MidiUart::getRxHighWater() {
+  uint16_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = rxHighWater; }
+  return value;
+}
+
+uint32_t MidiUart::getRxOverruns() {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = rxOverruns; }
+  return value;
+}
+
+uint32_t MidiUart::getRxFramingErrors() {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = rxFramingErrors; }
+  return value;
+}
+
+uint32_t MidiUart::getRxRingOverflows() {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = rxRingOverflows; }
+  return value;
+}
+
+void MidiUart::resetStatistics() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rxHighWater = 0;
+    rxOverruns = 0;
+    rxFramingErrors = 0;
+    rxRingOverflows = 0;
+  }
+  clockStampsLost = 0;
+}
+
+ISR(USART1_RX_vect) {
+  midiUart.handleRxInterrupt();
+}
+
+ISR(USART1_UDRE_vect) {
+  midiUart.handleTxInterrupt();
+}
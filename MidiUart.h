@@ -0,0 +1,159 @@
+#ifndef MIDI_UART_H
+#define MIDI_UART_H
+
+#include <Arduino.h>
+
+// Driver propio de USART1 para MIDI. Sustituye a Serial1: no referenciar
+// Serial1 en el sketch, o sus ISR entrarían en conflicto con las de aquí.
+#define MIDI_RX_BUFFER_SIZE   256   // Potencia de 2, máximo 256
+#define MIDI_TX_BUFFER_SIZE   64    // Potencia de 2, máximo 256
+#define MIDI_CLOCK_STAMPS     16    // Marcas de tiempo de MIDI clock pendientes (potencia de 2)
+
+#if (MIDI_RX_BUFFER_SIZE & (MIDI_RX_BUFFER_SIZE - 1)) || MIDI_RX_BUFFER_SIZE > 256
+#error "MIDI_RX_BUFFER_SIZE debe ser potencia de 2 y <= 256"
+#endif
+#if (MIDI_TX_BUFFER_SIZE & (MIDI_TX_BUFFER_SIZE - 1)) || MIDI_TX_BUFFER_SIZE > 256
+#error "MIDI_TX_BUFFER_SIZE debe ser potencia de 2 y <= 256"
+#endif
+#if (MIDI_CLOCK_STAMPS & (MIDI_CLOCK_STAMPS - 1)) || MIDI_CLOCK_STAMPS > 128
+#error "MIDI_CLOCK_STAMPS debe ser potencia de 2 y <= 128"
+#endif
+
+// Retención de la transmisión antes de un evento del generador de timing
+enum MidiTxHold {
+  TX_HOLD_NONE = 0,
+  TX_HOLD_BYTE,        // No cargar más bytes: línea libre para un real-time
+  TX_HOLD_MESSAGE      // Terminar el mensaje en curso y parar: hueco para un system common
+};
+
+class MidiUart {
+private:
+  // Índices de 8 bits: lectura/escritura atómica en AVR
+  volatile uint8_t rxBuffer[MIDI_RX_BUFFER_SIZE];
+  volatile uint8_t rxHead;
+  volatile uint8_t rxTail;
+  volatile uint8_t txBuffer[MIDI_TX_BUFFER_SIZE];
+  volatile uint8_t txHead;
+  volatile uint8_t txTail;
+  
+  // Contadores actualizados desde la ISR
+  volatile uint16_t rxHighWater;
+  volatile uint32_t rxOverruns;        // DOR1: byte perdido en el hardware
+  volatile uint32_t rxFramingErrors;   // FE1: byte descartado
+  volatile uint32_t rxRingOverflows;   // Ring lleno: byte descartado
+  
+  // Detector del ping HUI (90 00 00) en la propia ISR
+  volatile bool pingDetect;
+  volatile uint8_t pingRequests;
+  uint8_t rxRunningStatus;             // Solo lo usa la ISR
+  uint8_t rxDataIndex;
+  uint8_t rxFirstData;
+  
+  // Instante de llegada de cada MIDI clock, tomado en la ISR: el loop puede
+  // tardar milisegundos en leerlos y el estimador de tempo necesita la
+  // llegada real. La marca k corresponde al k-ésimo 0xF8 leído con read().
+  volatile unsigned long clockStamps[MIDI_CLOCK_STAMPS];
+  volatile uint8_t clockStampCount;    // Clocks recibidos (ISR)
+  uint8_t clockReadCount;              // Clocks leídos
+  unsigned long lastClockMicros;
+  uint32_t clockStampsLost;
+  
+  // Inyección temporizada desde otras ISR (generador de clock/MTC). Los
+  // real-time pueden ir entre dos bytes cualesquiera; los system common
+  // solo en una frontera de mensaje: fuera de SysEx y con un byte de estado
+  // como siguiente byte del ring (el generador de MTC desactiva el running
+  // status), o con el ring vacío y ningún mensaje a medio escribir.
+  volatile uint8_t injectRealTime[2];  // Clock seguido de Start/Continue/Stop
+  volatile uint8_t injectRealTimeCount;
+  volatile uint8_t injectCommon[2];
+  volatile uint8_t injectCommonCount;  // Bytes de injectCommon por enviar
+  volatile uint8_t txOpenBytes;        // Bytes escritos desde el último endMessage()
+  volatile bool txSysEx;               // Último status enviado fue F0
+  volatile uint8_t txHold;             // MidiTxHold
+  
+  void pollTransmit();
+  inline void detectPing(uint8_t data);
+  inline bool atMessageBoundary() const;
+  inline void trackSysEx(uint8_t data);
+
+public:
+  MidiUart();
+  
+  // Interfaz usada por midi::SerialMIDI
+  void begin(unsigned long baud);
+  void end();
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t data);
+  uint8_t availableForWrite();
+  
+  // Diagnóstico
+  uint16_t getRxHighWater();
+  uint32_t getRxOverruns();
+  uint32_t getRxFramingErrors();
+  uint32_t getRxRingOverflows();
+  uint16_t getRxCapacity() const { return MIDI_RX_BUFFER_SIZE - 1; }
+  uint32_t getClockStampsLost() const { return clockStampsLost; }
+  void resetStatistics();
+  
+  // Ping HUI: la ISR cuenta los recibidos y el loop los contesta por la cola TX
+  void setPingDetect(bool enable);
+  uint8_t takePingRequests();
+  
+  // Fronteras de mensaje y camino de inyección del generador de timing
+  void endMessage() { txOpenBytes = 0; }
+  inline void injectRealTimeFromIsr(uint8_t status);
+  inline void injectCommonFromIsr(uint8_t status, uint8_t data);
+  inline void setTxHoldFromIsr(uint8_t level);
+  inline bool isCommonPending() const { return injectCommonCount != 0; }
+  
+  // Llegada del último 0xF8 devuelto por read()
+  unsigned long getLastClockMicros() const { return lastClockMicros; }
+  
+  // Llamados desde las ISR de USART1
+  inline void handleRxInterrupt();
+  inline void handleTxInterrupt();
+};
+
+extern MidiUart midiUart;
+
+// ==================== INYECCIÓN DESDE ISR ====================
+// Inline para que la ISR del timer no pague una llamada por evento
+
+inline bool MidiUart::atMessageBoundary() const {
+  if (txSysEx) return false;
+  if (txHead == txTail) return txOpenBytes == 0;
+  return txBuffer[txTail] & 0x80;
+}
+
+inline void MidiUart::trackSysEx(uint8_t data) {
+  if (data == 0xF0) {
+    txSysEx = true;
+  } else if (data >= 0x80 && data < 0xF8) {
+    txSysEx = false;
+  }
+}
+
+inline void MidiUart::injectRealTimeFromIsr(uint8_t status) {
+  if (injectRealTimeCount == 0 && (UCSR1A & _BV(UDRE1))) {
+    UDR1 = status;
+  } else if (injectRealTimeCount < 2) {
+    injectRealTime[injectRealTimeCount++] = status;
+    UCSR1B |= _BV(UDRIE1);
+  }
+}
+
+inline void MidiUart::injectCommonFromIsr(uint8_t status, uint8_t data) {
+  injectCommon[0] = status;
+  injectCommon[1] = data;
+  injectCommonCount = 2;
+  UCSR1B |= _BV(UDRIE1);
+}
+
+inline void MidiUart::setTxHoldFromIsr(uint8_t level) {
+  if (level > txHold || level == TX_HOLD_NONE) txHold = level;
+  if (level == TX_HOLD_NONE) UCSR1B |= _BV(UDRIE1);
+}
+
+#endif // MIDI_UART_H
@@ -1,21 +1,30 @@
 #include "Midi_Controller.h"
+#include "UsbMidiPort.h"
+#include "SurfaceProtocol.h"
+#include "TimingGenerator.h"
+#include "DawMonitor.h"
+#include "MidiStats.h"
+#include "MidiTrace.h"
 
 // Inicializar la instancia estática
 Midi_Controller* Midi_Controller::instance = nullptr;
 
-// Instancia MIDI global
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI);
+// Instancia MIDI global: USART1 con buffer grande, SysEx filtrados por MidiInputStream
+MIDI_CREATE_CUSTOM_INSTANCE(MidiInputStream, midiInput, MIDI, MidiLibSettings);
 
 Midi_Controller::Midi_Controller()
   : currentMidiChannel(MIDI_CHANNEL_DEFAULT), mtcSync(true),
-    sysExIndex(0), receivingSysEx(false), mtcQuarterFrame(0),
-    lastMtcTime(0), mtcTimebaseValid(false),
+    sysExState(SYSEX_IDLE), sysExIndex(0), sysExHeaderMatch(0), sysExCommand(0), sysExFieldCount(0),
+    sysExNameLength(0), sysExRecord(0), sysExRecordPos(0), sysExErrors(0),
     midiMessagesReceived(0), midiMessagesSent(0),
     sysExMessagesProcessed(0), mtcFramesReceived(0), errorCount(0),
-    midiThruEnabled(false), sysExAutoResponse(true), lastActivityTime(0)
+    drainBudgetUs(MIDI_DRAIN_BUDGET_US), lastDrainMessages(0), lastDrainMicros(0),
+    maxDrainMessages(0), maxDrainMicros(0), drainBudgetExceeded(0), surface(nullptr),
+    midiThruEnabled(false), sysExAutoResponse(true), lastActivityTime(0),
+    lastReceiveTime(0), lastActiveSensingTime(0)
 {
+  memset(sysExErrorsByReason, 0, sizeof(sysExErrorsByReason));
   instance = this;
-  uint8_t sysExBuffer[24];  // Era 64 → 24 (40 bytes ahorrados)
 }
 
 Midi_Controller::~Midi_Controller() {
@@ -26,89 +35,133 @@ Midi_Controller::~Midi_Controller() {
 void Midi_Controller::setMidiChannel(uint8_t channel) {
   if (channel >= 1 && channel <= 16) {
     currentMidiChannel = channel;
-    Serial.print(F("Canal MIDI cambiado a: "));
-    Serial.println(channel);
+    debugSerial.print(F("Canal MIDI cambiado a: "));
+    debugSerial.println(channel);
   }
 }
 
 bool Midi_Controller::initialize(uint8_t midiChannel) {
-  Serial.println(F("Inicializando controlador MIDI..."));
+  debugSerial.println(F("Inicializando controlador MIDI..."));
   
   currentMidiChannel = midiChannel;
   
   // Configurar MIDI
+  midiInput.setSysExSink(this);
+  thru.setOutput(&txQueue);
+  midiInput.setThruSink(&thru);
   MIDI.begin(MIDI_CHANNEL_OMNI);
-  MIDI.turnThruOff();
+  MIDI.turnThruOff();  // El thru de la librería reenvía byte a byte: lo hace MidiThru
   
   // Configurar callbacks
   MIDI.setHandleNoteOn(handleNoteOn);
   MIDI.setHandleNoteOff(handleNoteOff);
   MIDI.setHandleControlChange(handleControlChange);
   MIDI.setHandlePitchBend(handlePitchBend);
-  MIDI.setHandleSystemExclusive(handleSystemExclusive);
+  MIDI.setHandleAfterTouchChannel(handleAfterTouchChannel);
+  MIDI.setHandleAfterTouchPoly(handleAfterTouchPoly);
   MIDI.setHandleTimeCodeQuarterFrame(handleTimeCodeQuarterFrame);
   MIDI.setHandleClock(handleClock);
   MIDI.setHandleStart(handleStart);
   MIDI.setHandleStop(handleStop);
   MIDI.setHandleContinue(handleContinue);
+  MIDI.setHandleSongPosition(handleSongPosition);
+  MIDI.setHandleActiveSensing(handleActiveSensing);
   
-  Serial.println(F("Controlador MIDI inicializado"));
+  debugSerial.println(F("Controlador MIDI inicializado"));
   return true;
 }
 
 // ... resto del código existente de Midi_Controller.cpp
 
-void Midi_Controller::processMidiInput() {
-  MIDI.read();
+uint16_t Midi_Controller::processMidiInput() {
+  unsigned long start = micros();
+  uint16_t messages = 0;
+  
+  if (midiInput.pending() > 0) {
+    lastReceiveTime = millis();
+  }
+  
+  // Procesar todos los bytes pendientes; cada read() puede consumir un solo byte
+  while (midiInput.pending() > 0) {
+    if (MIDI.read()) {
+      messages++;
+    }
+    if (micros() - start >= drainBudgetUs) {
+      drainBudgetExceeded++;
+      break;
+    }
+  }
+  
+  uint16_t elapsed = micros() - start;
+  lastDrainMessages = messages;
+  lastDrainMicros = elapsed;
+  if (messages > maxDrainMessages) maxDrainMessages = messages;
+  if (elapsed > maxDrainMicros) maxDrainMicros = elapsed;
+  
+  return messages;
 }
 
-void Midi_Controller::sendControlChange(uint8_t channel, uint8_t cc, uint8_t value) {
+void Midi_Controller::sendControlChange(uint8_t channel, uint8_t cc, uint8_t value, uint8_t priority) {
   if (!isValidMidiChannel(channel) || !isValidControlNumber(cc)) return;
   
-  MIDI.sendControlChange(cc, value, channel);
+  txQueue.enqueueChannel(priority, 0xB0 | (channel - 1), cc, value);
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
-void Midi_Controller::sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+void Midi_Controller::sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity, uint8_t priority) {
   if (!isValidMidiChannel(channel) || !isValidNoteNumber(note)) return;
   
-  MIDI.sendNoteOn(note, velocity, channel);
+  txQueue.enqueueChannel(priority, 0x90 | (channel - 1), note, velocity);
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
-void Midi_Controller::sendNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+void Midi_Controller::sendNoteOff(uint8_t channel, uint8_t note, uint8_t velocity, uint8_t priority) {
   if (!isValidMidiChannel(channel) || !isValidNoteNumber(note)) return;
   
-  MIDI.sendNoteOff(note, velocity, channel);
+  txQueue.enqueueChannel(priority, 0x80 | (channel - 1), note, velocity);
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
-void Midi_Controller::sendPitchBend(uint8_t channel, int16_t value) {
+void Midi_Controller::sendPitchBend(uint8_t channel, int16_t value, uint8_t priority) {
   if (!isValidMidiChannel(channel)) return;
   
-  MIDI.sendPitchBend(value, channel);
+  uint16_t bend = (uint16_t)(constrain(value, -8192, 8191) + 8192);
+  txQueue.enqueueChannel(priority, 0xE0 | (channel - 1), bend & 0x7F, (bend >> 7) & 0x7F);
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
+void Midi_Controller::sendActiveSensing() {
+  // Sin contar como actividad ni como mensaje del usuario
+  txQueue.enqueueRealTime(MIDI_ACTIVE_SENSING);
+}
+
 void Midi_Controller::sendTransportCommand(uint8_t command) {
-  MIDI.sendRealTime(command);
+  txQueue.enqueueRealTime(command);
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
 void Midi_Controller::sendJogWheel(int8_t direction) {
+  if (direction == 0) return;
   uint8_t cc = (direction > 0) ? MIDI_JOG_FORWARD : MIDI_JOG_BACKWARD;
-  sendControlChange(currentMidiChannel, cc, abs(direction));
+  sendControlChange(currentMidiChannel, cc, constrain(abs(direction), 1, 127),
+                    TX_PRIO_USER | TX_NO_COALESCE);
 }
 
 void Midi_Controller::sendAllNotesOff(uint8_t channel) {
   if (!isValidMidiChannel(channel)) return;
   
-  MIDI.sendControlChange(123, 0, channel); // All Notes Off
+  txQueue.enqueueChannel(TX_PRIO_USER, 0xB0 | (channel - 1), 123, 0); // All Notes Off
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
@@ -133,20 +186,70 @@ void Midi_Controller::sendStudioOneValueRequest(uint8_t track, uint8_t bank) {
   sendCustomSysEx(sysexData, sizeof(sysexData));
 }
 
+void Midi_Controller::sendStudioOneSwitchState(uint8_t function, uint8_t bank, uint8_t state) {
+  uint8_t sysexData[] = {
+    0xF0, 0x00, 0x21, 0x7B,  // Header Studio One
+    SYSEX_SWITCH_STATE,       // Switch State
+    (uint8_t)(function & 0x7F), (uint8_t)(bank & 0x7F),
+    (uint8_t)(state & 0x7F),
+    0xF7                      // End of SysEx
+  };
+  sendCustomSysEx(sysexData, sizeof(sysexData));
+}
+
+void Midi_Controller::sendStudioOnePushComplete(uint8_t bank, uint8_t count, uint16_t mute, uint16_t solo, uint8_t checksum) {
+  uint8_t sysexData[7 + 2 * SYSEX_MASK_BYTES + 2] = {
+    0xF0, 0x00, 0x21, 0x7B,  // Header Studio One
+    SYSEX_PUSH_COMPLETE,      // Push Complete
+    (uint8_t)(bank & 0x7F), (uint8_t)(count & 0x7F)
+  };
+  
+  // Máscaras empaquetadas igual que en SYSEX_BULK_MIX: 7 tracks por byte
+  uint8_t pos = 7;
+  for (uint8_t i = 0; i < SYSEX_MASK_BYTES; i++) {
+    sysexData[pos++] = (mute >> (i * 7)) & 0x7F;
+  }
+  for (uint8_t i = 0; i < SYSEX_MASK_BYTES; i++) {
+    sysexData[pos++] = (solo >> (i * 7)) & 0x7F;
+  }
+  sysexData[pos++] = checksum & 0x7F;
+  sysexData[pos++] = 0xF7;  // End of SysEx
+  sendCustomSysEx(sysexData, pos);
+}
+
+void Midi_Controller::sendStudioOneBulkRequest(uint8_t bank, uint8_t firstTrack, uint8_t count, uint8_t fields) {
+  uint8_t sysexData[] = {
+    0xF0, 0x00, 0x21, 0x7B,  // Header Studio One
+    SYSEX_BULK_REQUEST,       // Bulk Request
+    (uint8_t)(bank & 0x7F), (uint8_t)(firstTrack & 0x7F),
+    (uint8_t)(count & 0x7F), (uint8_t)(fields & 0x7F),
+    0xF7                      // End of SysEx
+  };
+  sendCustomSysEx(sysexData, sizeof(sysexData));
+}
+
 void Midi_Controller::sendCustomSysEx(const uint8_t* data, uint16_t length) {
   if (!data || length == 0) return;
   
-  MIDI.sendSysEx(length, data, true);
+  if (!txQueue.enqueueSysEx(data, length)) {
+    errorCount++;
+    return;
+  }
+  txQueue.service();
   midiMessagesSent++;
   lastActivityTime = millis();
 }
 
+void Midi_Controller::processMidiOutput() {
+  txQueue.service();
+}
+
 // Callbacks estáticos
 void Midi_Controller::handleNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
   if (instance) {
     instance->midiMessagesReceived++;
     instance->lastActivityTime = millis();
-    // Procesar Note On según sea necesario
+    instance->dispatchChannelMessage(channel, CT_NOTE, note, velocity);
   }
 }
 
@@ -154,7 +257,7 @@ void Midi_Controller::handleNoteOff(uint8_t channel, uint8_t note, uint8_t veloc
   if (instance) {
     instance->midiMessagesReceived++;
     instance->lastActivityTime = millis();
-    // Procesar Note Off según sea necesario
+    instance->dispatchChannelMessage(channel, CT_NOTE, note, 0);
   }
 }
 
@@ -162,7 +265,7 @@ void Midi_Controller::handleControlChange(uint8_t channel, uint8_t number, uint8
   if (instance) {
     instance->midiMessagesReceived++;
     instance->lastActivityTime = millis();
-    // Procesar Control Change según sea necesario
+    instance->dispatchChannelMessage(channel, CT_CC, number, value);
   }
 }
 
@@ -170,16 +273,26 @@ void Midi_Controller::handlePitchBend(uint8_t channel, int bend) {
   if (instance) {
     instance->midiMessagesReceived++;
     instance->lastActivityTime = millis();
-    // Procesar Pitch Bend según sea necesario
+    // 14 bits -> 0-127, la resolución de los encoders
+    instance->dispatchChannelMessage(channel, CT_PITCH, 0, (uint8_t)((bend + 8192) >> 7));
   }
 }
 
-void Midi_Controller::handleSystemExclusive(uint8_t* data, unsigned size) {
-  if (instance) {
+void Midi_Controller::handleAfterTouchChannel(uint8_t channel, uint8_t pressure) {
+  // Solo llega con el prefiltro abierto (medidores del modo Mackie)
+  if (instance && instance->surface) {
     instance->midiMessagesReceived++;
-    instance->sysExMessagesProcessed++;
     instance->lastActivityTime = millis();
-    instance->processSysExMessage(data, size);
+    instance->surface->handleChannelPressure(pressure);
+  }
+}
+
+void Midi_Controller::handleAfterTouchPoly(uint8_t channel, uint8_t note, uint8_t pressure) {
+  // Solo llega con el prefiltro abierto (medidores del modo HUI)
+  if (instance && instance->surface) {
+    instance->midiMessagesReceived++;
+    instance->lastActivityTime = millis();
+    instance->surface->handlePolyPressure(note, pressure);
   }
 }
 
@@ -188,7 +301,7 @@ void Midi_Controller::handleTimeCodeQuarterFrame(uint8_t data) {
     instance->midiMessagesReceived++;
     instance->mtcFramesReceived++;
     instance->lastActivityTime = millis();
-    instance->updateMtcFromQuarterFrame(data);
+    instance->mtcEngine.handleQuarterFrame(data, micros());
   }
 }
 
@@ -196,21 +309,31 @@ void Midi_Controller::handleClock() {
   if (instance) {
     instance->midiMessagesReceived++;
     instance->lastActivityTime = millis();
+    instance->clockEngine.handleClock(midiInput.getLastClockMicros());
   }
 }
 
 void Midi_Controller::handleStart() {
   if (instance) {
     instance->midiMessagesReceived++;
+    instance->clockEngine.handleStart();
     instance->currentTransport.isPlaying = true;
     instance->currentTransport.isPaused = false;
     instance->lastActivityTime = millis();
   }
 }
 
+void Midi_Controller::handleActiveSensing() {
+  // Solo marca de tiempo: la presencia del DAW la decide DawMonitor
+  if (instance) {
+    instance->lastActiveSensingTime = millis();
+  }
+}
+
 void Midi_Controller::handleStop() {
   if (instance) {
     instance->midiMessagesReceived++;
+    instance->clockEngine.handleStop();
     instance->currentTransport.isPlaying = false;
     instance->currentTransport.isPaused = false;
     instance->lastActivityTime = millis();
@@ -220,57 +343,270 @@ void Midi_Controller::handleStop() {
 void Midi_Controller::handleContinue() {
   if (instance) {
     instance->midiMessagesReceived++;
+    instance->clockEngine.handleContinue();
     instance->currentTransport.isPlaying = true;
     instance->currentTransport.isPaused = false;
     instance->lastActivityTime = millis();
   }
 }
 
-void Midi_Controller::processSysExMessage(const uint8_t* data, uint16_t length) {
-  // Verificar header de Studio One
-  if (length >= 5 && data[0] == 0xF0 && data[1] == 0x00 && 
-      data[2] == 0x21 && data[3] == 0x7B) {
-    processStudioOneMessage(data, length);
+void Midi_Controller::handleSongPosition(unsigned beats) {
+  if (instance) {
+    instance->midiMessagesReceived++;
+    instance->lastActivityTime = millis();
+    instance->clockEngine.handleSongPosition(beats);
   }
 }
 
-void Midi_Controller::processStudioOneMessage(const uint8_t* data, uint16_t length) {
-  if (length < 6) return; // Mínimo: header + command + track + bank
+bool Midi_Controller::parseSysExByte(uint8_t data) {
+  if (data == 0xF0) {
+    // Un F0 dentro de otro SysEx indica que el anterior no terminó
+    if (sysExState != SYSEX_IDLE) countSysExError(SYSEX_ERR_UNTERMINATED);
+    sysExState = SYSEX_HEADER;
+    sysExIndex = 0;
+    sysExHeaderMatch = SYSEX_MATCH_STUDIO_ONE | SYSEX_MATCH_MTC;
+    if (surface) sysExHeaderMatch |= SYSEX_MATCH_MACKIE;
+    return true;
+  }
   
-  uint8_t command = data[4];
-  uint8_t track = data[5];
-  uint8_t bank = (length > 6) ? data[6] : 0;
+  if (sysExState == SYSEX_IDLE) return false;
   
-  switch (command) {
-    case SYSEX_COLOR_UPDATE:
-      if (length >= 10) { // header + command + track + bank + 3 bytes color + end
-        processColorUpdate(track, bank, data + 7);
+  // Real-time puede aparecer en medio de un SysEx: lo procesa la librería
+  if (data >= 0xF8) return false;
+  
+  if (data == 0xF7) {
+    finishSysExMessage();
+    sysExState = SYSEX_IDLE;
+    return true;
+  }
+  
+  if (data & 0x80) {
+    // Status inesperado: trama truncada. El byte se entrega a la librería
+    countSysExError(SYSEX_ERR_TRUNCATED);
+    sysExState = SYSEX_IDLE;
+    return false;
+  }
+  
+  parseSysExField(data);
+  return true;
+}
+
+void Midi_Controller::parseSysExField(uint8_t data) {
+  static const uint8_t studioOneHeader[] = {0x00, 0x21, STUDIO_ONE_DEVICE_ID};
+  static const uint8_t mackieHeader[] = {0x00, 0x00, 0x66};
+  static const uint8_t mtcHeader[] = {0x7F, 0x7F, 0x01};  // El byte 1 (dispositivo) no se compara
+  
+  switch (sysExState) {
+    case SYSEX_HEADER:
+      // Todos los headers miden 3 bytes: descartar los que dejan de coincidir
+      if (data != studioOneHeader[sysExIndex]) sysExHeaderMatch &= ~SYSEX_MATCH_STUDIO_ONE;
+      if (data != mackieHeader[sysExIndex]) sysExHeaderMatch &= ~SYSEX_MATCH_MACKIE;
+      if (sysExIndex != 1 && data != mtcHeader[sysExIndex]) sysExHeaderMatch &= ~SYSEX_MATCH_MTC;
+      
+      if (!sysExHeaderMatch) {
+        sysExState = SYSEX_SKIP;
+      } else if (++sysExIndex >= sizeof(studioOneHeader)) {
+        if (sysExHeaderMatch & SYSEX_MATCH_MACKIE) {
+          surface->beginSysEx();
+          sysExState = SYSEX_SURFACE;
+        } else {
+          sysExState = SYSEX_COMMAND;
+        }
       }
       break;
-    case SYSEX_VALUE_UPDATE:
-      if (length >= 8) { // header + command + track + bank + value + end
-        processValueUpdate(track, bank, data[7]);
+      
+    case SYSEX_SURFACE:
+      surface->handleSysExByte(data);
+      break;
+      
+    case SYSEX_COMMAND:
+      sysExCommand = data;
+      sysExFieldCount = 0;
+      sysExNameLength = 0;
+      sysExRecord = 0;
+      sysExRecordPos = 0;
+      sysExState = SYSEX_FIELDS;
+      break;
+      
+    case SYSEX_FIELDS:
+      if (isStreamedBulkCommand(sysExCommand) && sysExFieldCount >= 3) {
+        // Bulk: cada registro se aplica en cuanto está completo
+        parseBulkRecordByte(data);
+      } else if (sysExCommand == SYSEX_NAME_UPDATE && sysExFieldCount >= 2) {
+        // Nombre: se guarda lo que cabe y el resto se descarta
+        if (sysExNameLength < TRACK_NAME_SIZE - 1) {
+          sysExName[sysExNameLength++] = (char)data;
+        }
+      } else if (sysExFieldCount < SYSEX_MAX_FIELDS) {
+        sysExFields[sysExFieldCount++] = data;
+      } else {
+        sysExState = SYSEX_MALFORMED;
       }
       break;
-    case SYSEX_VU_UPDATE:
-      if (length >= 8) { // header + command + track + level + end
-        processVUUpdate(track, data[6]);
+      
+    default:
+      // SYSEX_SKIP / SYSEX_MALFORMED: ignorar hasta F7
+      break;
+  }
+}
+
+void Midi_Controller::parseBulkRecordByte(uint8_t data) {
+  uint8_t bank = sysExFields[0];
+  uint8_t track = sysExFields[1] + sysExRecord;
+  
+  // Más datos de los anunciados en la cabecera
+  if (sysExRecord >= sysExFields[2]) {
+    sysExState = SYSEX_MALFORMED;
+    return;
+  }
+  
+  switch (sysExCommand) {
+    case SYSEX_BULK_COLOR:
+      sysExFields[3 + sysExRecordPos++] = data;
+      if (sysExRecordPos == 3) {
+        processColorUpdate(track, bank, sysExFields + 3);
+        sysExRecordPos = 0;
+        sysExRecord++;
       }
       break;
-    case SYSEX_NAME_UPDATE:
-      if (length > 8) { // header + command + track + bank + name + end
-        processNameUpdate(track, bank, (const char*)(data + 7));
+      
+    case SYSEX_BULK_VALUE:
+      processValueUpdate(track, bank, data);
+      sysExRecord++;
+      break;
+      
+    case SYSEX_BULK_NAME:
+      if (data == 0x00) {
+        // Un nombre vacío también es respuesta: el track no tiene nombre
+        sysExName[sysExNameLength] = '\0';
+        processNameUpdate(track, bank, sysExName);
+        sysExNameLength = 0;
+        sysExRecord++;
+      } else if (sysExNameLength < TRACK_NAME_SIZE - 1) {
+        sysExName[sysExNameLength++] = (char)data;
       }
       break;
-    case SYSEX_TRANSPORT:
-      if (length >= 7) { // header + command + state + end
-        uint8_t state = data[5];
-        currentTransport.isPlaying = (state & 0x01);
-        currentTransport.isRecording = (state & 0x02);
-        currentTransport.isPaused = (state & 0x04);
+  }
+}
+
+bool Midi_Controller::isStreamedBulkCommand(uint8_t command) {
+  return command == SYSEX_BULK_COLOR || command == SYSEX_BULK_VALUE ||
+         command == SYSEX_BULK_NAME;
+}
+
+void Midi_Controller::finishSysExMessage() {
+  switch (sysExState) {
+    case SYSEX_FIELDS:
+      if (sysExHeaderMatch & SYSEX_MATCH_MTC) {
+        dispatchMtcMessage();
+      } else {
+        dispatchStudioOneMessage();
       }
       break;
+    case SYSEX_SURFACE:
+      sysExMessagesProcessed++;
+      surface->endSysEx();
+      break;
+    case SYSEX_COMMAND:
+      countSysExError(SYSEX_ERR_NO_COMMAND);
+      break;
+    case SYSEX_MALFORMED:
+      countSysExError(SYSEX_ERR_OVERFLOW);
+      break;
+    default:
+      // SysEx ajeno o header incompleto: no es para nosotros
+      break;
+  }
+}
+
+void Midi_Controller::countSysExError(uint8_t reason) {
+  sysExErrors++;
+  if (sysExErrorsByReason[reason] < 0xFFFF) sysExErrorsByReason[reason]++;
+}
+
+void Midi_Controller::dispatchStudioOneMessage() {
+  // Campos de cada comando (sin contar header ni comando). Nombres y bulk
+  // guardan aparte lo que sigue a su cabecera, así que el número es exacto
+  uint8_t required;
+  switch (sysExCommand) {
+    case SYSEX_COLOR_UPDATE: required = 5; break;  // track, bank, R, G, B
+    case SYSEX_VALUE_UPDATE: required = 3; break;  // track, bank, valor
+    case SYSEX_VU_UPDATE:    required = 2; break;  // track, nivel
+    case SYSEX_NAME_UPDATE:  required = 2; break;  // track, bank (+ nombre)
+    case SYSEX_TRANSPORT:    required = 1; break;  // estado
+    case SYSEX_BULK_COLOR:
+    case SYSEX_BULK_VALUE:
+    case SYSEX_BULK_NAME:    required = 3; break;  // bank, primer track, nº tracks
+    case SYSEX_BULK_MIX:                           // + máscaras mute y solo
+      required = (sysExFieldCount >= 3) ? 3 + 2 * ((sysExFields[2] + 6) / 7) : 3;
+      break;
+    default:
+      return;  // Comando desconocido: se ignora
+  }
+  
+  if (sysExFieldCount < required ||
+      (sysExCommand == SYSEX_NAME_UPDATE && sysExNameLength == 0)) {
+    countSysExError(SYSEX_ERR_SHORT);
+    return;
+  }
+  if (sysExFieldCount > required) {
+    countSysExError(SYSEX_ERR_OVERFLOW);
+    return;
+  }
+  
+  // Bulk truncado: los registros completos ya se aplicaron
+  if (isStreamedBulkCommand(sysExCommand) && sysExRecord < sysExFields[2]) {
+    countSysExError(SYSEX_ERR_BULK_INCOMPLETE);
+  }
+  
+  midiMessagesReceived++;
+  sysExMessagesProcessed++;
+  lastActivityTime = millis();
+  
+  uint8_t track = sysExFields[0];
+  uint8_t bank = sysExFields[1];
+  
+  switch (sysExCommand) {
+    case SYSEX_COLOR_UPDATE:
+      processColorUpdate(track, bank, sysExFields + 2);
+      break;
+    case SYSEX_VALUE_UPDATE:
+      processValueUpdate(track, bank, sysExFields[2]);
+      break;
+    case SYSEX_VU_UPDATE:
+      processVUUpdate(track, sysExFields[1]);
+      break;
+    case SYSEX_NAME_UPDATE:
+      sysExName[sysExNameLength] = '\0';
+      processNameUpdate(track, bank, sysExName);
+      break;
+    case SYSEX_TRANSPORT: {
+      uint8_t state = sysExFields[0];
+      currentTransport.isPlaying = (state & 0x01);
+      currentTransport.isRecording = (state & 0x02);
+      currentTransport.isPaused = (state & 0x04);
+      break;
+    }
+    case SYSEX_BULK_MIX:
+      processMixUpdate(sysExFields[0], sysExFields[1], sysExFields[2], sysExFields + 3);
+      break;
+  }
+}
+
+void Midi_Controller::dispatchChannelMessage(uint8_t channel, uint8_t type, uint8_t number, uint8_t value) {
+  // Protocolo de superficie: el significado de cada mensaje es fijo
+  if (surface) {
+    switch (type) {
+      case CT_NOTE:  surface->handleNote(number, value); break;
+      case CT_CC:    surface->handleControlChange(number, value); break;
+      case CT_PITCH: surface->handlePitchBend(channel, value); break;
+    }
+    return;
   }
+  
+  // Feedback del DAW hacia encoders y mute/solo mediante el índice inverso
+  extern void syncChannelMessageFromDAW(uint8_t channel, uint8_t type, uint8_t number, uint8_t value);
+  syncChannelMessageFromDAW(channel, type, number, value);
 }
 
 void Midi_Controller::processColorUpdate(uint8_t track, uint8_t bank, const uint8_t* colorData) {
@@ -301,48 +637,50 @@ void Midi_Controller::processNameUpdate(uint8_t track, uint8_t bank, const char*
   syncEncoderNameFromDAW(track, bank, name);
 }
 
-void Midi_Controller::updateMtcFromQuarterFrame(uint8_t data) {
-  uint8_t pieceType = (data >> 4) & 0x07;
-  uint8_t pieceValue = data & 0x0F;
-  
-  switch (pieceType) {
-    case 0: currentMtc.frames = (currentMtc.frames & 0xF0) | pieceValue; break;
-    case 1: currentMtc.frames = (currentMtc.frames & 0x0F) | (pieceValue << 4); break;
-    case 2: currentMtc.seconds = (currentMtc.seconds & 0xF0) | pieceValue; break;
-    case 3: currentMtc.seconds = (currentMtc.seconds & 0x0F) | (pieceValue << 4); break;
-    case 4: currentMtc.minutes = (currentMtc.minutes & 0xF0) | pieceValue; break;
-    case 5: currentMtc.minutes = (currentMtc.minutes & 0x0F) | (pieceValue << 4); break;
-    case 6: currentMtc.hours = (currentMtc.hours & 0xF0) | pieceValue; break;
-    case 7: 
-      currentMtc.hours = (currentMtc.hours & 0x0F) | (pieceValue << 4);
-      currentMtc.isRunning = (pieceValue & 0x06) != 0; // Bit 1-2: running state
-      break;
-  }
+void Midi_Controller::processMixUpdate(uint8_t bank, uint8_t firstTrack, uint8_t count, const uint8_t* masks) {
+  if (firstTrack >= NUM_ENCODERS || count == 0) return;
   
-  mtcQuarterFrame = pieceType;
-  lastMtcTime = millis();
-  
-  // Reconstruir tiempo completo cada frame completo
-  if (pieceType == 7) {
-    reconstructMtcTime();
+  // Desempaquetar 7 tracks por byte: primero la máscara de mute, luego la de solo.
+  // El tamaño de cada máscara es el del mensaje; solo se recortan los tracks leídos
+  uint8_t maskBytes = (count + 6) / 7;
+  if (count > NUM_ENCODERS - firstTrack) count = NUM_ENCODERS - firstTrack;
+  uint16_t mute = 0;
+  uint16_t solo = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t bit = 1 << (i % 7);
+    if (masks[i / 7] & bit) mute |= 1u << i;
+    if (masks[maskBytes + i / 7] & bit) solo |= 1u << i;
   }
+  
+  uint16_t rangeMask = (uint16_t)(((1UL << count) - 1) << firstTrack);
+  extern void syncMixStateFromDAW(uint8_t bank, uint16_t rangeMask, uint16_t mute, uint16_t solo);
+  syncMixStateFromDAW(bank, rangeMask, mute << firstTrack, solo << firstTrack);
 }
 
-void Midi_Controller::reconstructMtcTime() {
-  // Validar datos MTC
-  if (validateMtcData()) {
-    mtcTimebaseValid = true;
-  } else {
-    mtcTimebaseValid = false;
-    errorCount++;
+void Midi_Controller::dispatchMtcMessage() {
+  // Full frame: locate del DAW (hr lleva el frame rate en los bits 5-6)
+  if (sysExCommand != SYSEX_MTC_FULL_FRAME) return;
+  if (sysExFieldCount < 4) {
+    countSysExError(SYSEX_ERR_SHORT);
+    return;
   }
+  sysExMessagesProcessed++;
+  mtcEngine.handleFullFrame(sysExFields[0], sysExFields[1], sysExFields[2], sysExFields[3], micros());
 }
 
-bool Midi_Controller::validateMtcData() {
-  return (currentMtc.frames < 30 && 
-          currentMtc.seconds < 60 && 
-          currentMtc.minutes < 60 && 
-          currentMtc.hours < 24);
+void Midi_Controller::updateTimecode() {
+  unsigned long now = micros();
+  
+  // Como maestro de clock, la posición y el tempo mostrados son los propios
+  if (timingGenerator.getMode() & MASTER_CLOCK) {
+    timingGenerator.getClockData(currentClock);
+  } else {
+    clockEngine.update(now, currentClock);
+  }
+  
+  // Sin posición MTC se conserva la hora que pongan otros protocolos (MCU/HUI)
+  if (!mtcSync) return;
+  mtcEngine.update(now, appConfig.mtcOffset, currentMtc);
 }
 
 uint16_t Midi_Controller::rgb24ToRgb565(uint32_t rgb24) {
@@ -362,36 +700,91 @@ uint32_t Midi_Controller::rgb565ToRgb24(uint16_t rgb565) {
 }
 
 void Midi_Controller::resetMtcTimebase() {
-  memset(&currentMtc, 0, sizeof(currentMtc));
-  mtcQuarterFrame = 0;
-  mtcTimebaseValid = false;
+  currentMtc = MtcData();
+  mtcEngine.reset();
+  currentClock = ClockData();
+  clockEngine.reset();
 }
 
 void Midi_Controller::printMidiStatistics() const {
-  Serial.println(F("\n=== ESTADÍSTICAS MIDI ==="));
-  Serial.print(F("Mensajes recibidos: "));
-  Serial.println(midiMessagesReceived);
-  Serial.print(F("Mensajes enviados: "));
-  Serial.println(midiMessagesSent);
-  Serial.print(F("Mensajes SysEx: "));
-  Serial.println(sysExMessagesProcessed);
-  Serial.print(F("Frames MTC: "));
-  Serial.println(mtcFramesReceived);
-  Serial.print(F("Errores: "));
-  Serial.println(errorCount);
-  Serial.println(F("========================\n"));
+  debugSerial.println(F("\n=== ESTADÍSTICAS MIDI ==="));
+  debugSerial.print(F("Mensajes recibidos: "));
+  debugSerial.println(midiMessagesReceived);
+  debugSerial.print(F("Mensajes enviados: "));
+  debugSerial.println(midiMessagesSent);
+  debugSerial.print(F("Mensajes SysEx: "));
+  debugSerial.println(sysExMessagesProcessed);
+  debugSerial.print(F("SysEx inválidos: "));
+  debugSerial.print(sysExErrors);
+  debugSerial.print(F(" (sin F7/truncados/sin comando/largos/cortos/bulk incompleto: "));
+  for (uint8_t i = 0; i < SYSEX_ERR_COUNT; i++) {
+    debugSerial.print(sysExErrorsByReason[i]);
+    debugSerial.print((i < SYSEX_ERR_COUNT - 1) ? F("/") : F(")\n"));
+  }
+  midiStats.printStatistics();
+  debugSerial.print(F("Frames MTC: "));
+  debugSerial.println(mtcFramesReceived);
+  mtcEngine.printStatistics();
+  clockEngine.printStatistics();
+  debugSerial.print(F("Errores: "));
+  debugSerial.println(errorCount);
+  debugSerial.print(F("Drenado (ult/max msgs): "));
+  debugSerial.print(lastDrainMessages);
+  debugSerial.print(F("/"));
+  debugSerial.println(maxDrainMessages);
+  debugSerial.print(F("Drenado (ult/max us): "));
+  debugSerial.print(lastDrainMicros);
+  debugSerial.print(F("/"));
+  debugSerial.println(maxDrainMicros);
+  debugSerial.print(F("Presupuesto agotado: "));
+  debugSerial.println(drainBudgetExceeded);
+  debugSerial.print(F("Buffer RX (max/cap): "));
+  debugSerial.print(midiUart.getRxHighWater());
+  debugSerial.print(F("/"));
+  debugSerial.println(midiUart.getRxCapacity());
+  debugSerial.print(F("Overruns RX: "));
+  debugSerial.println(midiUart.getRxOverruns());
+  debugSerial.print(F("Errores de trama RX: "));
+  debugSerial.println(midiUart.getRxFramingErrors());
+  debugSerial.print(F("Desbordes buffer RX: "));
+  debugSerial.println(midiUart.getRxRingOverflows());
+  debugSerial.print(F("Marcas de clock perdidas: "));
+  debugSerial.println(midiUart.getClockStampsLost());
+  midiInput.printStatistics();
+  usbMidi.printStatistics();
+  txQueue.printStatistics();
+  thru.printStatistics();
+  if (timingGenerator.isActive()) timingGenerator.printStatistics();
+  dawMonitor.printStatistics();
+  midiTrace.printStatistics();
+  debugSerial.println(F("========================\n"));
 }
 
 void Midi_Controller::resetStatistics() {
   midiMessagesReceived = 0;
   midiMessagesSent = 0;
   sysExMessagesProcessed = 0;
+  sysExErrors = 0;
+  memset(sysExErrorsByReason, 0, sizeof(sysExErrorsByReason));
   mtcFramesReceived = 0;
+  mtcEngine.resetStatistics();
+  clockEngine.resetStatistics();
   errorCount = 0;
+  maxDrainMessages = 0;
+  maxDrainMicros = 0;
+  drainBudgetExceeded = 0;
+  midiUart.resetStatistics();
+  midiInput.resetStatistics();
+  usbMidi.resetStatistics();
+  txQueue.resetStatistics();
+  thru.resetStatistics();
+  timingGenerator.resetStatistics();
+  dawMonitor.resetStatistics();
+  midiStats.resetStatistics();
 }
 
 bool Midi_Controller::testMidiConnection() {
-  Serial.println(F("Probando conexión MIDI..."));
+  debugSerial.println(F("Probando conexión MIDI..."));
   
   // Enviar mensaje de test
   sendControlChange(currentMidiChannel, 7, 64);
@@ -400,7 +793,7 @@ bool Midi_Controller::testMidiConnection() {
   delay(100);
   sendControlChange(currentMidiChannel, 7, 64);
   
-  Serial.println(F("Test MIDI completado"));
+  debugSerial.println(F("Test MIDI completado"));
   return true;
 }
 
@@ -418,11 +811,7 @@ void Midi_Controller::sendTestSequence() {
 
 void Midi_Controller::setMidiThru(bool enable) {
   midiThruEnabled = enable;
-  if (enable) {
-    MIDI.turnThruOn();
-  } else {
-    MIDI.turnThruOff();
-  }
+  thru.setEnabled(enable);
 }
 
 void Midi_Controller::setSysExAutoResponse(bool enable) {
@@ -443,6 +832,6 @@ bool Midi_Controller::isValidNoteNumber(uint8_t note) const {
 
 void Midi_Controller::logMidiError(const char* error) {
   errorCount++;
-  Serial.print(F("ERROR MIDI: "));
-  Serial.println(error);
+  debugSerial.print(F("ERROR MIDI: "));
+  debugSerial.println(error);
 }
\ No newline at end of file
@@ -2,14 +2,22 @@
 #define MIDI_CONTROLLER_H
 
 #include "Config.h"
+#include "MidiUart.h"
+#include "MidiTxQueue.h"
+#include "MidiInputStream.h"
+#include "MidiThru.h"
+#include "MtcEngine.h"
+#include "ClockEngine.h"
 #include <MIDI.h>
 #include <Arduino.h>
 
+class SurfaceProtocol;
+
 // Definiciones específicas MIDI
-#define SYSEX_BUFFER_SIZE     128
 #define MTC_QUARTER_FRAME     0xF1
 #define MTC_FRAMES_PER_SEC    30
 #define STUDIO_ONE_DEVICE_ID  0x7B
+#define MIDI_DRAIN_BUDGET_US  1000  // Tiempo máximo de lectura MIDI por loop
 
 // Tipos de mensajes SysEx Studio One
 #define SYSEX_COLOR_UPDATE    0x01
@@ -17,24 +25,89 @@
 #define SYSEX_NAME_UPDATE     0x03
 #define SYSEX_VU_UPDATE       0x04
 #define SYSEX_TRANSPORT       0x05
+#define SYSEX_SWITCH_STATE    0x06
+
+// Mensajes en bloque: F0 00 21 7B [cmd] [bank] [primer track] [nº tracks] [registros...] F7
+#define SYSEX_BULK_COLOR      0x10  // 3 bytes (R, G, B) por track
+#define SYSEX_BULK_VALUE      0x11  // 1 byte por track
+#define SYSEX_BULK_NAME       0x12  // Nombre terminado en 0x00 por track
+#define SYSEX_BULK_MIX        0x13  // Máscaras mute y solo, 7 tracks por byte
+#define SYSEX_BULK_REQUEST    0x14  // Petición: bank, primer track, nº tracks, campos
+#define SYSEX_PUSH_COMPLETE   0x15  // Fin de volcado: bank, nº tracks, mute, solo, checksum
+
+// Campos pedidos en SYSEX_BULK_REQUEST
+#define SYSEX_FIELD_COLOR     0x01
+#define SYSEX_FIELD_NAME      0x02
+#define SYSEX_FIELD_VALUE     0x04
+#define SYSEX_FIELD_MIX       0x08
+#define SYSEX_FIELD_ALL       0x0F
+
+#define SYSEX_MASK_BYTES      ((NUM_ENCODERS + 6) / 7)   // Bytes por máscara de tracks
+#define SYSEX_MAX_FIELDS      (3 + 2 * SYSEX_MASK_BYTES) // Campos fijos más largos (bulk mix)
+
+// Estados del parser SysEx incremental
+enum SysExParseState {
+  SYSEX_IDLE = 0,        // Fuera de SysEx
+  SYSEX_HEADER,          // Validando 00 21 7B (Studio One), 00 00 66 (Mackie) o 7F xx 01 (MTC) tras F0
+  SYSEX_COMMAND,         // Esperando el byte de comando
+  SYSEX_FIELDS,          // Recibiendo campos del comando
+  SYSEX_SKIP,            // SysEx ajeno: descartar hasta F7
+  SYSEX_MALFORMED,       // Trama inválida: descartar hasta F7
+  SYSEX_SURFACE          // SysEx Mackie/HUI: se reenvía byte a byte al protocolo activo
+};
+
+// Motivos de SysEx inválido (estadísticas)
+enum SysExErrorReason {
+  SYSEX_ERR_UNTERMINATED = 0,   // F0 antes del F7 del anterior
+  SYSEX_ERR_TRUNCATED,          // Status dentro del SysEx
+  SYSEX_ERR_NO_COMMAND,         // F7 justo tras el header
+  SYSEX_ERR_OVERFLOW,           // Más campos o registros de los anunciados
+  SYSEX_ERR_SHORT,              // Menos campos de los que pide el comando
+  SYSEX_ERR_BULK_INCOMPLETE,    // Bulk con menos registros de los anunciados
+  SYSEX_ERR_COUNT
+};
+
+// Candidatos de header aún posibles durante SYSEX_HEADER
+#define SYSEX_MATCH_STUDIO_ONE  0x01
+#define SYSEX_MATCH_MACKIE      0x02
+#define SYSEX_MATCH_MTC         0x04    // Universal real-time, sub-ID 01 (MIDI Time Code)
+
+#define SYSEX_MTC_FULL_FRAME    0x01    // F0 7F [dispositivo] 01 01 hr mn sc fr F7
+
+// La librería ya no recibe SysEx (los consume MidiInputStream),
+// así que su buffer interno puede ser mínimo
+struct MidiLibSettings : public midi::DefaultSettings {
+  static const unsigned SysExMaxSize = 16;
+};
 
 class Midi_Controller {
 private:
   // Estados MIDI
   MtcData currentMtc;
+  ClockData currentClock;
   TransportState currentTransport;
   uint8_t currentMidiChannel;
   bool mtcSync;
   
-  // Buffer para SysEx
-  uint8_t sysExBuffer[32];//SYSEX_BUFFER_SIZE
-  uint16_t sysExIndex;
-  bool receivingSysEx;
+  // Parser SysEx incremental (RAM constante, sin buffer del mensaje)
+  uint8_t sysExState;
+  uint8_t sysExIndex;                      // Posición dentro del header
+  uint8_t sysExHeaderMatch;                // SYSEX_MATCH_* compatibles con lo recibido
+  uint8_t sysExCommand;
+  uint8_t sysExFields[SYSEX_MAX_FIELDS];
+  uint8_t sysExFieldCount;
+  char sysExName[TRACK_NAME_SIZE];
+  uint8_t sysExNameLength;
+  uint8_t sysExRecord;                     // Registros completos de un bulk
+  uint8_t sysExRecordPos;                  // Byte dentro del registro actual
+  uint32_t sysExErrors;
+  uint16_t sysExErrorsByReason[SYSEX_ERR_COUNT];
+  
+  // Motor MTC (quarter frames, full frames e interpolación)
+  MtcEngine mtcEngine;
   
-  // Variables MTC
-  uint8_t mtcQuarterFrame;
-  uint32_t lastMtcTime;
-  bool mtcTimebaseValid;
+  // Tempo y posición musical a partir del MIDI clock y SPP
+  ClockEngine clockEngine;
   
   // Estadísticas y diagnóstico
   uint32_t midiMessagesReceived;
@@ -43,30 +116,53 @@ private:
   uint32_t mtcFramesReceived;
   uint32_t errorCount;
   
+  // Drenado de la entrada MIDI
+  uint16_t drainBudgetUs;
+  uint16_t lastDrainMessages;
+  uint16_t lastDrainMicros;
+  uint16_t maxDrainMessages;
+  uint16_t maxDrainMicros;
+  uint32_t drainBudgetExceeded;
+  
+  // Protocolo de superficie activo (nullptr: Studio One / mapeo configurable)
+  SurfaceProtocol* surface;
+  
+  // Cola de salida priorizada (no bloqueante, con running status)
+  MidiTxQueue txQueue;
+  
+  // Thru por mensajes completos, fusionado con la salida local en txQueue
+  MidiThru thru;
+  
   // Callbacks privados de MIDI
   static void handleNoteOn(uint8_t channel, uint8_t note, uint8_t velocity);
   static void handleNoteOff(uint8_t channel, uint8_t note, uint8_t velocity);
   static void handleControlChange(uint8_t channel, uint8_t number, uint8_t value);
   static void handlePitchBend(uint8_t channel, int bend);
-  static void handleSystemExclusive(uint8_t* data, unsigned size);
+  static void handleAfterTouchChannel(uint8_t channel, uint8_t pressure);
+  static void handleAfterTouchPoly(uint8_t channel, uint8_t note, uint8_t pressure);
   static void handleTimeCodeQuarterFrame(uint8_t data);
   static void handleClock();
   static void handleStart();
   static void handleStop();
   static void handleContinue();
+  static void handleSongPosition(unsigned beats);
+  static void handleActiveSensing();
   
   // Procesamiento interno
-  void processSysExMessage(const uint8_t* data, uint16_t length);
-  void processStudioOneMessage(const uint8_t* data, uint16_t length);
+  void parseSysExField(uint8_t data);
+  void parseBulkRecordByte(uint8_t data);
+  static bool isStreamedBulkCommand(uint8_t command);
+  void finishSysExMessage();
+  void countSysExError(uint8_t reason);
+  void dispatchStudioOneMessage();
+  void dispatchMtcMessage();
+  void dispatchChannelMessage(uint8_t channel, uint8_t type, uint8_t number, uint8_t value);
   void processColorUpdate(uint8_t track, uint8_t bank, const uint8_t* colorData);
   void processValueUpdate(uint8_t track, uint8_t bank, uint8_t value);
   void processVUUpdate(uint8_t track, uint8_t level);
   void processNameUpdate(uint8_t track, uint8_t bank, const char* name);
+  void processMixUpdate(uint8_t bank, uint8_t firstTrack, uint8_t count, const uint8_t* masks);
   
-  // Procesamiento MTC
-  void updateMtcFromQuarterFrame(uint8_t data);
-  void reconstructMtcTime();
-  bool validateMtcData();
   
   // Utilidades
   uint16_t rgb24ToRgb565(uint32_t rgb24);
@@ -83,38 +179,68 @@ public:
   uint8_t getMidiChannel() const { return currentMidiChannel; }
   
   // Procesamiento principal
-  void processMidiInput();
+  uint16_t processMidiInput();
+  bool parseSysExByte(uint8_t data);  // true si el byte pertenece a un SysEx
+  void setDrainBudget(uint16_t budgetUs) { drainBudgetUs = budgetUs; }
+  uint16_t getDrainBudget() const { return drainBudgetUs; }
+  uint16_t getLastDrainMessages() const { return lastDrainMessages; }
+  uint16_t getLastDrainMicros() const { return lastDrainMicros; }
+  void processMidiOutput();  // Vaciar la cola TX sin bloquear
+  const MidiTxQueue& getTxQueue() const { return txQueue; }
+  MidiThru& getThru() { return thru; }
   
   // Envío de mensajes MIDI
-  void sendControlChange(uint8_t channel, uint8_t cc, uint8_t value);
-  void sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity);
-  void sendNoteOff(uint8_t channel, uint8_t note, uint8_t velocity);
-  void sendPitchBend(uint8_t channel, int16_t value);
+  void sendControlChange(uint8_t channel, uint8_t cc, uint8_t value, uint8_t priority = TX_PRIO_USER);
+  void sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity, uint8_t priority = TX_PRIO_USER);
+  void sendNoteOff(uint8_t channel, uint8_t note, uint8_t velocity, uint8_t priority = TX_PRIO_USER);
+  void sendPitchBend(uint8_t channel, int16_t value, uint8_t priority = TX_PRIO_USER);
   void sendTransportCommand(uint8_t command);
+  void sendActiveSensing();
   void sendJogWheel(int8_t direction);
   void sendAllNotesOff(uint8_t channel);
   
   // Envío de SysEx personalizado
   void sendStudioOneColorRequest(uint8_t track, uint8_t bank);
   void sendStudioOneValueRequest(uint8_t track, uint8_t bank);
+  void sendStudioOneSwitchState(uint8_t function, uint8_t bank, uint8_t state);
+  void sendStudioOnePushComplete(uint8_t bank, uint8_t count, uint16_t mute, uint16_t solo, uint8_t checksum);
+  void sendStudioOneBulkRequest(uint8_t bank, uint8_t firstTrack, uint8_t count, uint8_t fields = SYSEX_FIELD_ALL);
   void sendCustomSysEx(const uint8_t* data, uint16_t length);
   
   // Getters de estado
   const MtcData& getMtcData() const { return currentMtc; }
   const TransportState& getTransportState() const { return currentTransport; }
-  bool isMtcSynced() const { return mtcSync && mtcTimebaseValid; }
+  bool isMtcSynced() const { return mtcSync && mtcEngine.isLocked(); }
+  const MtcEngine& getMtcEngine() const { return mtcEngine; }
+  const ClockData& getClockData() const { return currentClock; }
+  const ClockEngine& getClockEngine() const { return clockEngine; }
+  
+  // Estado decodificado de protocolos externos (displays Mackie)
+  void setTransportState(const TransportState& state) { currentTransport = state; }
+  void setMtcData(const MtcData& mtc) { currentMtc = mtc; }
+  void setSurfaceProtocol(SurfaceProtocol* protocol) { surface = protocol; }
+  SurfaceProtocol* getSurfaceProtocol() const { return surface; }
   
   // Control MTC
   void enableMtcSync(bool enable) { mtcSync = enable; }
   bool isMtcSyncEnabled() const { return mtcSync; }
   void resetMtcTimebase();
+  void updateTimecode();  // Hora MTC interpolada y compás del clock (llamar desde loop)
+  
+  // El MTC generado no admite running status: un quarter frame lo cancelaría
+  void setTxRunningStatus(bool enable) { txQueue.setRunningStatus(enable); }
+  void setOutputPorts(uint8_t ports) { txQueue.setOutputPorts(ports); }
   
   // Diagnóstico y estadísticas
   void printMidiStatistics() const;
   void resetStatistics();
   uint32_t getMessagesReceived() const { return midiMessagesReceived; }
+  unsigned long getLastReceiveTime() const { return lastReceiveTime; }
+  unsigned long getLastActiveSensingTime() const { return lastActiveSensingTime; }
   uint32_t getMessagesSent() const { return midiMessagesSent; }
   uint32_t getErrorCount() const { return errorCount; }
+  uint32_t getSysExErrors() const { return sysExErrors; }
+  uint16_t getSysExErrors(uint8_t reason) const { return (reason < SYSEX_ERR_COUNT) ? sysExErrorsByReason[reason] : 0; }
   
   // Test y calibración
   bool testMidiConnection();
@@ -132,6 +258,8 @@ private:
   bool midiThruEnabled;
   bool sysExAutoResponse;
   unsigned long lastActivityTime;
+  unsigned long lastReceiveTime;     // Último byte recibido del DAW
+  unsigned long lastActiveSensingTime;  // Último 0xFE recibido (0 = nunca)
   
   // Validación de datos
   bool isValidMidiChannel(uint8_t channel) const;
@@ -140,6 +268,6 @@ private:
 };
 
 // Instancia global MIDI
-extern midi::MidiInterface<midi::SerialMIDI<HardwareSerial>> MIDI;
+extern midi::MidiInterface<midi::SerialMIDI<MidiInputStream>, MidiLibSettings> MIDI;
 
 #endif // MIDI_CONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "MtcEngine.h"
+#include "UsbMidiPort.h"
+
+#define DF_FRAMES_PER_10MIN   17982     // 10 minutos de 29.97 drop-frame
+#define DF_FRAMES_PER_MIN     1798      // Minuto con los frames 0 y 1 suprimidos
+
+MtcEngine::MtcEngine()
+  : quarterFrames(0), fullFrames(0), sequenceErrors(0), invalidTimes(0), dropouts(0)
+{
+  reset();
+}
+
+void MtcEngine::reset() {
+  memset(pieces, 0, sizeof(pieces));
+  lastPiece = 0;
+  piecesInSequence = 0;
+  direction = 1;
+  anchorQuarters = 0;
+  anchorMicros = 0;
+  lastQuarterMicros = 0;
+  rate = MTC_RATE_30;
+  locked = false;
+  running = false;
+}
+
+void MtcEngine::handleQuarterFrame(uint8_t data, unsigned long nowUs) {
+  uint8_t piece = (data >> 4) & 0x07;
+  pieces[piece] = data & 0x0F;
+  quarterFrames++;
+  
+  // Secuencia 0..7 hacia delante o 7..0 hacia atrás
+  int8_t step = 0;
+  if (piecesInSequence > 0) {
+    if (piece == ((lastPiece + 1) & 0x07)) step = 1;
+    else if (piece == ((lastPiece - 1) & 0x07)) step = -1;
+  }
+  
+  if (step == 0 || step != direction) {
+    if (piecesInSequence > 0 && step == 0) sequenceErrors++;
+    if (step != 0) direction = step;
+    piecesInSequence = 1;
+  } else if (piecesInSequence < 8) {
+    piecesInSequence++;
+  }
+  lastPiece = piece;
+  lastQuarterMicros = nowUs;
+  
+  // Con posición conocida cada pieza avanza un cuarto de frame
+  if (locked && step != 0) {
+    anchorQuarters += step;
+    anchorMicros = nowUs;
+    running = true;
+  }
+  
+  // Ciclo completo: la hora ensamblada corrige cualquier deriva acumulada
+  uint8_t lastOfCycle = (direction > 0) ? 7 : 0;
+  if (piecesInSequence >= 8 && piece == lastOfCycle) {
+    completeCycle(nowUs);
+  }
+}
+
+void MtcEngine::completeCycle(unsigned long nowUs) {
+  uint8_t frames = pieces[0] | ((pieces[1] & 0x01) << 4);
+  uint8_t seconds = pieces[2] | ((pieces[3] & 0x03) << 4);
+  uint8_t minutes = pieces[4] | ((pieces[5] & 0x03) << 4);
+  uint8_t hours = pieces[6] | ((pieces[7] & 0x01) << 4);
+  uint8_t newRate = (pieces[7] >> 1) & 0x03;
+  
+  if (!isValidTime(newRate, hours, minutes, seconds, frames)) {
+    invalidTimes++;
+    return;
+  }
+  
+  // La hora corresponde a la pieza 0: al recibir la 7 han pasado 7 cuartos.
+  // Hacia atrás se toma la hora tal cual (aproximación de un frame).
+  rate = newRate;
+  anchorQuarters = timeToFrames(rate, hours, minutes, seconds, frames) * 4;
+  if (direction > 0) anchorQuarters += 7;
+  anchorMicros = nowUs;
+  locked = true;
+  running = true;
+}
+
+void MtcEngine::handleFullFrame(uint8_t hoursAndRate, uint8_t minutes, uint8_t seconds, uint8_t frames, unsigned long nowUs) {
+  uint8_t newRate = (hoursAndRate >> 5) & 0x03;
+  uint8_t hours = hoursAndRate & 0x1F;
+  fullFrames++;
+  
+  if (!isValidTime(newRate, hours, minutes, seconds, frames)) {
+    invalidTimes++;
+    return;
+  }
+  
+  // Locate: posición nueva con el transporte parado hasta que vuelvan los quarter frames
+  rate = newRate;
+  anchorQuarters = timeToFrames(rate, hours, minutes, seconds, frames) * 4;
+  anchorMicros = nowUs;
+  piecesInSequence = 0;
+  locked = true;
+  running = false;
+}
+
+bool MtcEngine::update(unsigned long nowUs, int8_t offsetFrames, MtcData& out) {
+  if (!locked) return false;
+  
+  if (running && nowUs - lastQuarterMicros > MTC_DROPOUT_US) {
+    // Caída o stop: congelar en la última posición recibida
+    running = false;
+    piecesInSequence = 0;
+    dropouts++;
+  }
+  
+  int32_t quarters = anchorQuarters;
+  uint8_t fraction = 0;  // Centésimas de cuarto de frame
+  
+  if (running) {
+    uint16_t period = quarterPeriodMicros(rate);
+    unsigned long elapsed = nowUs - anchorMicros;
+    unsigned long steps = elapsed / period;
+    if (steps >= MTC_MAX_EXTRAPOLATION) {
+      steps = MTC_MAX_EXTRAPOLATION;
+    } else if (direction > 0) {
+      fraction = (elapsed - steps * period) * 25 / period;
+    }
+    quarters += direction * (int32_t)steps;
+  }
+  
+  int32_t day = framesPerDay(rate);
+  if (quarters < 0) quarters = 0;
+  int32_t frames = (quarters >> 2) + offsetFrames;
+  frames %= day;
+  if (frames < 0) frames += day;
+  
+  framesToTime(rate, frames, out);
+  out.subFrame = (quarters & 0x03) * 25 + fraction;
+  out.rate = rate;
+  out.isRunning = running;
+  return true;
+}
+
+// ==================== CONVERSIONES ====================
+
+uint8_t MtcEngine::framesPerSecond(uint8_t rate) {
+  switch (rate) {
+    case MTC_RATE_24: return 24;
+    case MTC_RATE_25: return 25;
+    default: return 30;  // 29.97 DF numera 30 frames por segundo
+  }
+}
+
+uint16_t MtcEngine::quarterPeriodMicros(uint8_t rate) {
+  switch (rate) {
+    case MTC_RATE_24: return 10417;
+    case MTC_RATE_25: return 10000;
+    case MTC_RATE_2997_DF: return 8342;
+    default: return 8333;
+  }
+}
+
+int32_t MtcEngine::framesPerDay(uint8_t rate) {
+  if (rate == MTC_RATE_2997_DF) return 24L * 6 * DF_FRAMES_PER_10MIN;
+  return (int32_t)framesPerSecond(rate) * 86400L;
+}
+
+bool MtcEngine::isValidTime(uint8_t rate, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames) {
+  if (hours >= 24 || minutes >= 60 || seconds >= 60 || frames >= framesPerSecond(rate)) return false;
+  // Drop-frame: los frames 0 y 1 no existen al empezar cada minuto salvo los múltiplos de 10
+  if (rate == MTC_RATE_2997_DF && seconds == 0 && frames < 2 && minutes % 10 != 0) return false;
+  return true;
+}
+
+int32_t MtcEngine::timeToFrames(uint8_t rate, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames) {
+  int32_t totalMinutes = (int32_t)hours * 60 + minutes;
+  int32_t result = (totalMinutes * 60 + seconds) * framesPerSecond(rate) + frames;
+  if (rate == MTC_RATE_2997_DF) {
+    result -= 2 * (totalMinutes - totalMinutes / 10);
+  }
+  return result;
+}
+
+void MtcEngine::framesToTime(uint8_t rate, int32_t frames, MtcData& out) {
+  if (rate == MTC_RATE_2997_DF) {
+    // Reinsertar los números de frame suprimidos para obtener la etiqueta
+    int32_t tens = frames / DF_FRAMES_PER_10MIN;
+    int32_t rest = frames % DF_FRAMES_PER_10MIN;
+    frames += 18 * tens;
+    if (rest > 1) frames += 2 * ((rest - 2) / DF_FRAMES_PER_MIN);
+  }
+  
+  uint8_t fps = framesPerSecond(rate);
+  out.frames = frames % fps;
+  int32_t totalSeconds = frames / fps;
+  out.seconds = totalSeconds % 60;
+  out.minutes = (totalSeconds / 60) % 60;
+  out.hours = (totalSeconds / 3600) % 24;
+}
+
+// ==================== DIAGNÓSTICO ====================
+
+void MtcEngine::printStatistics() const {
+  static const char* const rateNames[4] = {"24", "25", "29.97DF", "30"};
+  
+  debugSerial.print(F("MTC: "));
+  debugSerial.print(locked ? (running ? F("en marcha") : F("parado")) : F("sin posición"));
+  debugSerial.print(F(" @ "));
+  debugSerial.print(rateNames[rate & 0x03]);
+  debugSerial.println(F(" fps"));
+  debugSerial.print(F("MTC quarter/full frames: "));
+  debugSerial.print(quarterFrames);
+  debugSerial.print(F("/"));
+  debugSerial.println(fullFrames);
+  debugSerial.print(F("MTC errores secuencia/hora inválida: "));
+  debugSerial.print(sequenceErrors);
+  debugSerial.print(F("/"));
+  debugSerial.println(invalidTimes);
+  debugSerial.print(F("MTC caídas: "));
+  debugSerial.println(dropouts);
+}
+
+void MtcEngine::resetStatistics() {
+  quarterFrames = 0;
+  fullFrames = 0;
+  sequenceErrors = 0;
+  invalidTimes = 0;
+  dropouts = 0;
+}
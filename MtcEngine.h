@@ -0,0 +1,67 @@
+#ifndef MTC_ENGINE_H
+#define MTC_ENGINE_H
+
+#include "Config.h"
+#include <Arduino.h>
+
+#define MTC_DROPOUT_US          120000UL  // Sin quarter frames: transporte parado
+#define MTC_MAX_EXTRAPOLATION   4         // Quarter frames interpolados sin recibir nada
+
+// Motor MTC: ensambla quarter frames, detecta el frame rate y mantiene la
+// posición en quarter frames para interpolar la hora mostrada entre mensajes.
+class MtcEngine {
+private:
+  // Ensamblado de las 8 piezas
+  uint8_t pieces[8];
+  uint8_t lastPiece;
+  uint8_t piecesInSequence;          // Piezas consecutivas recibidas (hasta 8)
+  int8_t direction;                  // +1 hacia delante, -1 hacia atrás
+  
+  // Posición de referencia (quarter frames desde 00:00:00:00) y su instante
+  int32_t anchorQuarters;
+  unsigned long anchorMicros;
+  unsigned long lastQuarterMicros;
+  uint8_t rate;
+  bool locked;                       // Posición conocida (ciclo completo o full frame)
+  bool running;
+  
+  // Estadísticas
+  uint32_t quarterFrames;
+  uint32_t fullFrames;
+  uint32_t sequenceErrors;
+  uint32_t invalidTimes;
+  uint32_t dropouts;
+  
+  void completeCycle(unsigned long nowUs);
+  
+public:
+  MtcEngine();
+  
+  void reset();
+  void handleQuarterFrame(uint8_t data, unsigned long nowUs);
+  void handleFullFrame(uint8_t hoursAndRate, uint8_t minutes, uint8_t seconds, uint8_t frames, unsigned long nowUs);
+  
+  // Detectar caídas y calcular la hora actual interpolada con el offset.
+  // Devuelve false si todavía no hay posición conocida.
+  bool update(unsigned long nowUs, int8_t offsetFrames, MtcData& out);
+  
+  bool isLocked() const { return locked; }
+  bool isRunning() const { return running; }
+  uint8_t getRate() const { return rate; }
+  
+  // Conversión hh:mm:ss:ff <-> frames (con drop-frame en 29.97)
+  static uint8_t framesPerSecond(uint8_t rate);
+  static uint16_t quarterPeriodMicros(uint8_t rate);
+  static int32_t framesPerDay(uint8_t rate);
+  static bool isValidTime(uint8_t rate, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames);
+  static int32_t timeToFrames(uint8_t rate, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames);
+  static void framesToTime(uint8_t rate, int32_t frames, MtcData& out);
+  
+  // Diagnóstico
+  void printStatistics() const;
+  void resetStatistics();
+  uint32_t getQuarterFrames() const { return quarterFrames; }
+  uint32_t getDropouts() const { return dropouts; }
+};
+
+#endif // MTC_ENGINE_H
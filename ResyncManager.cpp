@@ -0,0 +1,295 @@
+#include "ResyncManager.h"
+#include "UsbMidiPort.h"
+#include "Midi_Controller.h"
+#include "EncoderManager.h"
+
+extern Midi_Controller midi_controller;
+extern EncoderManager encoders;
+
+#define ALL_TRACKS_MASK ((uint16_t)((1UL << NUM_ENCODERS) - 1))
+
+ResyncManager::ResyncManager()
+  : bank(0), staleColor(0), staleValue(0), staleName(0), failedMask(0),
+    pushMask(0), pushBank(0), pushActive(false), dawLost(false),
+    budget(RESYNC_BURST_BYTES), lastRefill(0),
+    requestsSent(0), timeouts(0), tracksFailed(0), pushesCompleted(0)
+{
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    slots[i].first = RESYNC_SLOT_FREE;
+  }
+  for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+    confirmedAt[i] = 0;
+  }
+}
+
+void ResyncManager::invalidateBank(uint8_t newBank) {
+  // Las respuestas pendientes del banco anterior ya no interesan
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    slots[i].first = RESYNC_SLOT_FREE;
+  }
+  for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+    confirmedAt[i] = 0;
+  }
+  bank = newBank;
+  staleColor = ALL_TRACKS_MASK;
+  staleValue = ALL_TRACKS_MASK;
+  staleName = ALL_TRACKS_MASK;
+  failedMask = 0;
+}
+
+void ResyncManager::invalidateTrack(uint8_t track) {
+  if (track >= NUM_ENCODERS) return;
+  uint16_t bit = 1u << track;
+  staleColor |= bit;
+  staleValue |= bit;
+  staleName |= bit;
+  failedMask &= ~bit;
+}
+
+void ResyncManager::startPush(uint8_t newBank) {
+  if (newBank >= NUM_BANKS) return;
+  pushBank = newBank;
+  pushMask = ALL_TRACKS_MASK;
+  pushActive = true;
+  
+  // Los valores que enviamos pasan a ser la referencia: no pedirlos de vuelta
+  if (newBank == bank) staleValue = 0;
+}
+
+void ResyncManager::onDawReconnected() {
+  debugSerial.println(F("DAW reconectado: enviando estado de la superficie"));
+  startPush(bank);
+  // Un DAW reiniciado puede tener otros colores y nombres
+  staleColor = ALL_TRACKS_MASK;
+  staleName = ALL_TRACKS_MASK;
+  failedMask = 0;
+}
+
+void ResyncManager::onDawLinkChanged(uint8_t state) {
+  if (state == DAW_LINK_LOST) {
+    dawLost = true;
+    // Lo que estaba en vuelo no va a responderse: reenviarlo al volver, sin gastar reintentos
+    for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+      slots[i].sentAt = 0;
+      slots[i].retries = 0;
+    }
+  } else if (state == DAW_LINK_CONNECTED && dawLost) {
+    dawLost = false;
+    onDawReconnected();
+  }
+}
+
+void ResyncManager::onColorReceived(uint8_t track, uint8_t fromBank) {
+  if (fromBank != bank || track >= NUM_ENCODERS) return;
+  staleColor &= ~(1u << track);
+  confirm(track);
+}
+
+void ResyncManager::onValueReceived(uint8_t track, uint8_t fromBank) {
+  if (fromBank != bank || track >= NUM_ENCODERS) return;
+  staleValue &= ~(1u << track);
+  confirm(track);
+}
+
+void ResyncManager::onNameReceived(uint8_t track, uint8_t fromBank) {
+  if (fromBank != bank || track >= NUM_ENCODERS) return;
+  staleName &= ~(1u << track);
+  confirm(track);
+}
+
+void ResyncManager::confirm(uint8_t track) {
+  confirmedAt[track] = nowSeconds();
+  failedMask &= ~(1u << track);
+  
+  // Las respuestas en bloque confirman track a track: la petición se cierra
+  // cuando no queda nada pendiente en su rango
+  uint16_t stale = getStaleMask();
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    ResyncSlot& slot = slots[i];
+    if (slot.first == RESYNC_SLOT_FREE) continue;
+    if (!(rangeMask(slot.first, slot.count) & stale)) slot.first = RESYNC_SLOT_FREE;
+  }
+}
+
+void ResyncManager::update(unsigned long currentTime) {
+  // Recargar presupuesto a ritmo fijo
+  if (currentTime - lastRefill >= RESYNC_REFILL_MS) {
+    budget += (int16_t)((unsigned long)RESYNC_BUDGET_BYTES_S * RESYNC_REFILL_MS / 1000);
+    if (budget > RESYNC_BURST_BYTES) budget = RESYNC_BURST_BYTES;
+    lastRefill = currentTime;
+  }
+  
+  // Sin DAW no hay quien responda: ni timeouts ni peticiones nuevas
+  if (dawLost) return;
+  
+  // Timeouts: reintentar o dar el track por fallido
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    ResyncSlot& slot = slots[i];
+    if (slot.first == RESYNC_SLOT_FREE || slot.sentAt == 0) continue;
+    if (currentTime - slot.sentAt < RESYNC_TIMEOUT_MS) continue;
+    
+    timeouts++;
+    if (slot.retries >= RESYNC_MAX_RETRIES) {
+      uint16_t missing = rangeMask(slot.first, slot.count) & getStaleMask();
+      failedMask |= missing;
+      for (; missing; missing &= missing - 1) tracksFailed++;
+      slot.first = RESYNC_SLOT_FREE;
+    } else {
+      slot.retries++;
+      slot.sentAt = 0;
+    }
+  }
+  
+  // Los movimientos del usuario van primero: solo pedir con la cola TX vacía
+  if (!midi_controller.getTxQueue().isIdle()) return;
+  
+  // El volcado al DAW va antes que las peticiones de resincronización
+  if (pushActive) {
+    while (pushMask && pushNextTrack()) {}
+    if (pushMask) return;
+    if (budget < 2 * RESYNC_REQUEST_BYTES) return;
+    finishPush();
+    return;
+  }
+  
+  // Reenvíos pendientes
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    ResyncSlot& slot = slots[i];
+    if (slot.first != RESYNC_SLOT_FREE && slot.sentAt == 0) {
+      if (!sendRequest(slot, currentTime)) return;
+    }
+  }
+  
+  // Nuevas peticiones: una por cada rango contiguo de tracks obsoletos
+  uint16_t candidates = getStaleMask() & ~failedMask & ~getInFlightMask();
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT && candidates; i++) {
+    ResyncSlot& slot = slots[i];
+    if (slot.first != RESYNC_SLOT_FREE) continue;
+    
+    uint8_t first = 0;
+    while (!(candidates & (1u << first))) first++;
+    uint8_t count = 0;
+    while (first + count < NUM_ENCODERS && (candidates & (1u << (first + count)))) count++;
+    candidates &= ~rangeMask(first, count);
+    
+    slot.first = first;
+    slot.count = count;
+    slot.retries = 0;
+    slot.sentAt = 0;
+    if (!sendRequest(slot, currentTime)) return;
+  }
+}
+
+bool ResyncManager::pushNextTrack() {
+  // Primero los tracks con mute o solo (afectan a lo que se oye), luego el resto
+  const BankMixState& mix = encoders.getMixState(pushBank);
+  uint16_t candidates = pushMask & (mix.mute | mix.solo);
+  if (!candidates) candidates = pushMask;
+  
+  uint8_t track = 0;
+  while (!(candidates & (1u << track))) track++;
+  
+  // Coste real según el mapeo (NRPN, switches SysEx...), sin pasar de la ráfaga
+  int16_t bytes = encoders.getPushTrackBytes(track, pushBank);
+  if (budget < min(bytes, (int16_t)RESYNC_BURST_BYTES)) return false;
+  
+  encoders.pushTrackState(track, pushBank);
+  pushMask &= ~(1u << track);
+  budget -= bytes;
+  return true;
+}
+
+void ResyncManager::finishPush() {
+  // Checksum de valores para que el DAW confirme que recibió el volcado completo.
+  // Los tracks en modo relativo no enviaron valor y no cuentan.
+  uint8_t checksum = 0;
+  for (uint8_t track = 0; track < NUM_ENCODERS; track++) {
+    if (!encoders.pushesTrackValue(track, pushBank)) continue;
+    checksum += encoders.getEncoderConfig(track, pushBank).value;
+  }
+  
+  const BankMixState& mix = encoders.getMixState(pushBank);
+  midi_controller.sendStudioOnePushComplete(pushBank, NUM_ENCODERS, mix.mute, mix.solo, checksum);
+  budget -= 2 * RESYNC_REQUEST_BYTES;
+  pushActive = false;
+  pushesCompleted++;
+}
+
+bool ResyncManager::sendRequest(ResyncSlot& slot, unsigned long currentTime) {
+  uint16_t missing = rangeMask(slot.first, slot.count) & getStaleMask();
+  if (!missing) {
+    slot.first = RESYNC_SLOT_FREE;
+    return true;
+  }
+  if (budget < RESYNC_REQUEST_BYTES) return false;  // Queda en el slot hasta recargar
+  
+  // En un reintento el rango se recorta a los tracks que siguen sin respuesta
+  while (!(missing & (1u << slot.first))) {
+    slot.first++;
+    slot.count--;
+  }
+  while (!(missing & (1u << (slot.first + slot.count - 1)))) slot.count--;
+  
+  // Todos los campos en un solo frame; el DAW responde con un bulk por campo
+  midi_controller.sendStudioOneBulkRequest(bank, slot.first, slot.count, SYSEX_FIELD_ALL);
+  budget -= RESYNC_REQUEST_BYTES;
+  requestsSent++;
+  slot.sentAt = currentTime ? currentTime : 1;
+  return true;
+}
+
+uint16_t ResyncManager::getInFlightMask() const {
+  uint16_t mask = 0;
+  for (uint8_t i = 0; i < RESYNC_MAX_IN_FLIGHT; i++) {
+    if (slots[i].first != RESYNC_SLOT_FREE) mask |= rangeMask(slots[i].first, slots[i].count);
+  }
+  return mask;
+}
+
+uint16_t ResyncManager::rangeMask(uint8_t first, uint8_t count) {
+  return (uint16_t)(((1UL << count) - 1) << first);
+}
+
+uint16_t ResyncManager::nowSeconds() {
+  // +1 para reservar el 0 como "nunca"
+  return (uint16_t)(millis() / 1000) + 1;
+}
+
+uint16_t ResyncManager::getTrackAge(uint8_t track) const {
+  if (track >= NUM_ENCODERS || confirmedAt[track] == 0) return 0xFFFF;
+  return nowSeconds() - confirmedAt[track];
+}
+
+void ResyncManager::printStatistics() const {
+  debugSerial.println(F("\n=== RESINCRONIZACIÓN DAW ==="));
+  debugSerial.print(F("Banco: "));
+  debugSerial.println(bank + 1);
+  debugSerial.print(F("Peticiones enviadas: "));
+  debugSerial.println(requestsSent);
+  debugSerial.print(F("Timeouts: "));
+  debugSerial.println(timeouts);
+  debugSerial.print(F("Tracks fallidos: "));
+  debugSerial.println(tracksFailed);
+  debugSerial.print(F("Volcados al DAW: "));
+  debugSerial.print(pushesCompleted);
+  debugSerial.println(pushActive ? F(" (en curso)") : F(""));
+  if (dawLost) debugSerial.println(F("En pausa: DAW desconectado"));
+  
+  // Antigüedad por track: segundos desde la última respuesta
+  for (uint8_t track = 0; track < NUM_ENCODERS; track++) {
+    uint16_t bit = 1u << track;
+    debugSerial.print(F("T"));
+    debugSerial.print(track + 1);
+    debugSerial.print(F(": "));
+    if (failedMask & bit) {
+      debugSerial.print(F("FALLO"));
+    } else if (getStaleMask() & bit) {
+      debugSerial.print(F("pendiente"));
+    } else {
+      debugSerial.print(getTrackAge(track));
+      debugSerial.print(F("s"));
+    }
+    debugSerial.print((track % 4 == 3) ? F("\n") : F("  "));
+  }
+  debugSerial.println(F("============================\n"));
+}
@@ -0,0 +1,89 @@
+#ifndef RESYNC_MANAGER_H
+#define RESYNC_MANAGER_H
+
+#include "Config.h"
+#include <Arduino.h>
+
+#define RESYNC_MAX_IN_FLIGHT   4     // Rangos de tracks pedidos simultáneamente sin respuesta
+#define RESYNC_TIMEOUT_MS      500   // Espera máxima por petición (un banco entero son ~250 bytes de respuesta)
+#define RESYNC_MAX_RETRIES     3     // Reintentos antes de dar el track por fallido
+#define RESYNC_BUDGET_BYTES_S  320   // ~10% del enlace MIDI (3125 bytes/s)
+#define RESYNC_REFILL_MS       50    // Periodo de recarga del presupuesto
+#define RESYNC_BURST_BYTES     32    // Presupuesto máximo acumulado
+#define RESYNC_REQUEST_BYTES   10    // Tamaño de una petición en bloque (SYSEX_BULK_REQUEST)
+
+#define RESYNC_SLOT_FREE       0xFF
+
+// Una petición en bloque: tracks consecutivos first..first+count-1. Sigue
+// abierta mientras alguno tenga color, valor o nombre sin respuesta
+struct ResyncSlot {
+  uint8_t first;             // RESYNC_SLOT_FREE si está libre
+  uint8_t count;
+  uint8_t retries;
+  unsigned long sentAt;      // 0 = pendiente de (re)envío
+};
+
+class ResyncManager {
+private:
+  ResyncSlot slots[RESYNC_MAX_IN_FLIGHT];
+  uint8_t bank;                          // Banco que se está sincronizando
+  uint16_t staleColor;                   // Tracks con color sin confirmar
+  uint16_t staleValue;                   // Tracks con valor sin confirmar
+  uint16_t staleName;                    // Tracks con nombre sin confirmar
+  uint16_t failedMask;                   // Tracks sin respuesta tras los reintentos
+  uint16_t confirmedAt[NUM_ENCODERS];    // Segundo de la última respuesta (0 = nunca)
+  
+  // Volcado de la superficie al DAW
+  uint16_t pushMask;                     // Tracks pendientes de enviar
+  uint8_t pushBank;
+  bool pushActive;
+  bool dawLost;                          // DAW desconectado: peticiones y volcados en pausa
+  
+  // Presupuesto de ancho de banda (bytes)
+  int16_t budget;
+  unsigned long lastRefill;
+  
+  // Estadísticas
+  uint32_t requestsSent;
+  uint32_t timeouts;
+  uint32_t tracksFailed;
+  uint32_t pushesCompleted;
+  
+  uint16_t getInFlightMask() const;
+  static uint16_t rangeMask(uint8_t first, uint8_t count);
+  bool sendRequest(ResyncSlot& slot, unsigned long currentTime);
+  void confirm(uint8_t track);
+  bool pushNextTrack();
+  void finishPush();
+  static uint16_t nowSeconds();
+
+public:
+  ResyncManager();
+  
+  // Marcar datos como obsoletos
+  void invalidateBank(uint8_t newBank);
+  void invalidateTrack(uint8_t track);
+  
+  // Volcado del estado local al DAW (valor, mute y solo)
+  void startPush(uint8_t bank);
+  bool isPushing() const { return pushActive; }
+  void onDawReconnected();
+  void onDawLinkChanged(uint8_t state);   // DawLinkState, desde DawMonitor
+  
+  // Respuestas del DAW (solicitadas o no)
+  void onColorReceived(uint8_t track, uint8_t fromBank);
+  void onValueReceived(uint8_t track, uint8_t fromBank);
+  void onNameReceived(uint8_t track, uint8_t fromBank);
+  
+  // Planificación de peticiones (llamar desde loop)
+  void update(unsigned long currentTime);
+  
+  // Diagnóstico
+  bool isSynced() const { return !(getStaleMask() & ~failedMask); }
+  uint16_t getStaleMask() const { return staleColor | staleValue | staleName; }
+  uint16_t getFailedMask() const { return failedMask; }
+  uint16_t getTrackAge(uint8_t track) const;   // Segundos; 0xFFFF = nunca confirmado
+  void printStatistics() const;
+};
+
+#endif // RESYNC_MANAGER_H
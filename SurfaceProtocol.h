@@ -0,0 +1,38 @@
+#ifndef SURFACE_PROTOCOL_H
+#define SURFACE_PROTOCOL_H
+
+#include <Arduino.h>
+
+// Strips físicos de la superficie: encoders 0-7 (V-Pot) y 8-15 (fader)
+#define SURFACE_STRIPS  8
+
+// Protocolo de superficie de control con significado fijo (Mackie MCU, HUI).
+// Midi_Controller le entrega los mensajes del DAW y EncoderManager los
+// movimientos locales; sin protocolo activo se usa el mapeo configurable.
+class SurfaceProtocol {
+public:
+  virtual ~SurfaceProtocol() {}
+  
+  virtual void setActive(bool enable) = 0;
+  virtual void update(unsigned long currentTime) = 0;
+  
+  // Entrada desde el DAW (Pitch Bend ya reducido a 0-127)
+  virtual void handleNote(uint8_t note, uint8_t velocity) = 0;
+  virtual void handleControlChange(uint8_t cc, uint8_t value) = 0;
+  virtual void handlePitchBend(uint8_t channel, uint8_t value) {}
+  virtual void handleChannelPressure(uint8_t value) {}
+  virtual void handlePolyPressure(uint8_t note, uint8_t value) {}
+  
+  // SysEx con header Mackie 00 00 66: recibe los bytes posteriores al header
+  virtual void beginSysEx() = 0;
+  virtual void handleSysExByte(uint8_t data) = 0;
+  virtual void endSysEx() {}
+  
+  // Salida hacia el DAW
+  virtual void sendVPot(uint8_t strip, int8_t delta) = 0;
+  virtual void sendFader(uint8_t strip, uint8_t value) = 0;
+  virtual void sendStripButton(uint8_t switchIndex, bool pressed) = 0;
+  virtual void sendButton(uint8_t buttonIndex) = 0;
+};
+
+#endif // SURFACE_PROTOCOL_H
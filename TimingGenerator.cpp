@@ -0,0 +1,419 @@
+#include "TimingGenerator.h"
+#include "UsbMidiPort.h"
+#include "MtcEngine.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#define GUARD_CLOCK_COUNTS   (TIMING_GUARD_CLOCK_US / TIMING_TIMER_US)
+#define GUARD_MTC_COUNTS     (TIMING_GUARD_MTC_US / TIMING_TIMER_US)
+#define CLOCK_COUNTS_X10     6250000UL   // 60e6 us / 24 ppqn / 4 us * 10
+
+TimingGenerator timingGenerator;
+
+// Cuartos de frame en cuentas del timer: numerador/denominador por MtcRate
+static const uint32_t quarterNumerators[4] = {62500UL, 62500UL, 625625UL, 62500UL};
+static const uint16_t quarterDenominators[4] = {24, 25, 300, 30};
+
+TimingGenerator::TimingGenerator()
+  : mode(MASTER_OFF), tempoX10(1200), rate(MTC_RATE_25),
+    clockAccumulator(0), quarterAccumulator(0),
+    running(false), awaitingFirstClock(false), pendingTransport(0), mtcRunning(false),
+    mtcStartPending(false), songPosition(0), nextReady(false), piece(0), cycleFrame(0),
+    nextCycleFrame(0), stoppedFrame(0), guardLevel(TX_HOLD_NONE),
+    clocksSent(0), quarterFramesSent(0), lateEvents(0), quarterFramesDropped(0),
+    cycleUnderruns(0)
+{
+  computeClockPeriod();
+  computeQuarterPeriod();
+}
+
+// ==================== CONFIGURACIÓN ====================
+
+void TimingGenerator::setMode(uint8_t masterMode) {
+  masterMode &= MASTER_BOTH;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uint8_t previous = mode;
+    mode = masterMode;
+
+    if (mode == MASTER_OFF) {
+      configureTimer(false);
+      running = false;
+      pendingTransport = 0;
+    } else {
+      if (previous == MASTER_OFF) configureTimer(true);
+
+      if ((mode & MASTER_CLOCK) && !(previous & MASTER_CLOCK)) {
+        OCR3A = TCNT3 + clockCounts;
+        TIFR3 = _BV(OCF3A);
+        TIMSK3 |= _BV(OCIE3A);
+      } else if (!(mode & MASTER_CLOCK)) {
+        TIMSK3 &= ~_BV(OCIE3A);
+        pendingTransport = 0;
+      }
+    }
+
+    if (!(mode & MASTER_MTC)) {
+      mtcRunning = false;
+      mtcStartPending = false;
+      TIMSK3 &= ~_BV(OCIE3B);
+    }
+    if (mode != MASTER_OFF) armGuard();
+  }
+}
+
+void TimingGenerator::setTempo(uint16_t bpmX10) {
+  tempoX10 = constrain(bpmX10, TIMING_MIN_TEMPO_X10, TIMING_MAX_TEMPO_X10);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    computeClockPeriod();
+  }
+}
+
+void TimingGenerator::setFrameRate(uint8_t mtcRate) {
+  rate = mtcRate & 0x03;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    computeQuarterPeriod();
+  }
+}
+
+void TimingGenerator::computeClockPeriod() {
+  clockCounts = CLOCK_COUNTS_X10 / tempoX10;
+  clockRemainder = CLOCK_COUNTS_X10 % tempoX10;
+  clockDenominator = tempoX10;
+  clockAccumulator = 0;
+}
+
+void TimingGenerator::computeQuarterPeriod() {
+  quarterCounts = quarterNumerators[rate] / quarterDenominators[rate];
+  quarterRemainder = quarterNumerators[rate] % quarterDenominators[rate];
+  quarterDenominator = quarterDenominators[rate];
+  quarterAccumulator = 0;
+}
+
+void TimingGenerator::configureTimer(bool enable) {
+  if (enable) {
+    // Timer3 libre (modo normal) con prescaler 64: 4 us por cuenta
+    TCCR3A = 0;
+    TCCR3C = 0;
+    TIMSK3 = 0;
+    TCCR3B = _BV(CS31) | _BV(CS30);
+  } else {
+    TIMSK3 = 0;
+    TCCR3B = 0;
+    mtcRunning = false;
+    mtcStartPending = false;
+    midiUart.setTxHoldFromIsr(TX_HOLD_NONE);
+  }
+}
+
+// ==================== TRANSPORTE ====================
+
+void TimingGenerator::start() {
+  if (mode == MASTER_OFF || running || pendingTransport == MIDI_PLAY || pendingTransport == MIDI_CONTINUE) return;
+
+  // Los dos primeros ciclos de quarter frames se preparan fuera de la ISR
+  int32_t frame = stoppedFrame & ~1L;
+  if (mode & MASTER_MTC) {
+    fillCycle(cycleNibbles, frame);
+    fillCycle(nextNibbles, frame + 2);
+    nextCycleFrame = frame + 4;
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    piece = 0;
+    cycleFrame = frame;
+    nextReady = true;
+
+    if (mode & MASTER_CLOCK) {
+      // FA/FB sale tras el próximo clock; el MTC arranca con el primer tiempo
+      pendingTransport = (songPosition == 0) ? MIDI_PLAY : MIDI_CONTINUE;
+      mtcStartPending = (mode & MASTER_MTC) != 0;
+    } else {
+      running = true;
+      mtcRunning = true;
+      OCR3B = TCNT3 + GUARD_MTC_COUNTS + 4;
+      TIFR3 = _BV(OCF3B);
+      TIMSK3 |= _BV(OCIE3B);
+    }
+    armGuard();
+  }
+}
+
+void TimingGenerator::stop() {
+  if (mode == MASTER_OFF) return;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    bool active = running || pendingTransport == MIDI_PLAY || pendingTransport == MIDI_CONTINUE;
+
+    if (active) {
+      if (mtcRunning) stoppedFrame = cycleFrame + (piece >> 2);
+      mtcRunning = false;
+      mtcStartPending = false;
+      TIMSK3 &= ~_BV(OCIE3B);
+
+      if (mode & MASTER_CLOCK) {
+        pendingTransport = MIDI_STOP;
+      } else {
+        running = false;
+      }
+      armGuard();
+    } else {
+      // Segunda pulsación de Stop: volver al principio
+      songPosition = 0;
+      stoppedFrame = 0;
+    }
+  }
+}
+
+uint32_t TimingGenerator::getSongPosition() const {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = songPosition; }
+  return value;
+}
+
+uint32_t TimingGenerator::getClocksSent() const {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = clocksSent; }
+  return value;
+}
+
+uint32_t TimingGenerator::getQuarterFramesSent() const {
+  uint32_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = quarterFramesSent; }
+  return value;
+}
+
+void TimingGenerator::getClockData(ClockData& out) const {
+  uint32_t position = getSongPosition();
+  uint32_t beats = position / CLOCK_PPQN;
+  uint32_t bar = beats / CLOCK_BEATS_PER_BAR + 1;
+  out.bar = (bar > 9999) ? 9999 : bar;
+  out.beat = beats % CLOCK_BEATS_PER_BAR + 1;
+  out.tick = position % CLOCK_PPQN;
+  out.bpmX10 = tempoX10;
+  out.tempoValid = true;
+  out.isRunning = running;
+}
+
+// ==================== QUARTER FRAMES ====================
+
+void TimingGenerator::fillCycle(volatile uint8_t* nibbles, int32_t frame) {
+  MtcData time;
+  MtcEngine::framesToTime(rate, frame % MtcEngine::framesPerDay(rate), time);
+
+  nibbles[0] = time.frames & 0x0F;
+  nibbles[1] = time.frames >> 4;
+  nibbles[2] = time.seconds & 0x0F;
+  nibbles[3] = time.seconds >> 4;
+  nibbles[4] = time.minutes & 0x0F;
+  nibbles[5] = time.minutes >> 4;
+  nibbles[6] = time.hours & 0x0F;
+  nibbles[7] = (time.hours >> 4) | (rate << 1);
+}
+
+void TimingGenerator::update() {
+  // La ISR consumió el ciclo preparado: calcular el siguiente (2 frames más)
+  if (mtcRunning && !nextReady) {
+    fillCycle(nextNibbles, nextCycleFrame);
+    nextCycleFrame += 2;
+    nextReady = true;
+  }
+}
+
+// ==================== ISR ====================
+
+inline uint16_t TimingGenerator::advance(uint16_t base, uint16_t counts, uint16_t remainder,
+                                         uint16_t denominator, volatile uint16_t& accumulator) {
+  // Periodo fraccional sin deriva: el resto se acumula y suma una cuenta al desbordar
+  accumulator += remainder;
+  if (accumulator >= denominator) {
+    accumulator -= denominator;
+    counts++;
+  }
+  return base + counts;
+}
+
+inline uint16_t TimingGenerator::schedule(uint16_t next, uint16_t period) {
+  // Si la ISR llegó tan tarde que el siguiente instante ya pasó, no esperar a
+  // la vuelta completa del contador (262 ms)
+  uint16_t now = TCNT3;
+  if ((uint16_t)(next - now) > period) {
+    lateEvents++;
+    next = now + 8;
+  }
+  return next;
+}
+
+inline void TimingGenerator::emitQuarterFrame(uint16_t eventTime) {
+  if (midiUart.isCommonPending()) quarterFramesDropped++;
+  midiUart.injectCommonFromIsr(MTC_QUARTER_FRAME, (piece << 4) | cycleNibbles[piece]);
+  quarterFramesSent++;
+
+  piece = (piece + 1) & 0x07;
+  if (piece == 0) {
+    cycleFrame += 2;
+    if (nextReady) {
+      for (uint8_t i = 0; i < 8; i++) cycleNibbles[i] = nextNibbles[i];
+      nextReady = false;
+    } else {
+      cycleUnderruns++;  // Se repite el ciclo anterior
+    }
+  }
+
+  uint16_t next = advance(eventTime, quarterCounts, quarterRemainder, quarterDenominator, quarterAccumulator);
+  OCR3B = schedule(next, quarterCounts + 1);
+}
+
+inline void TimingGenerator::armGuard() {
+  // Retener la transmisión antes del próximo evento: byte a byte para un
+  // clock, a frontera de mensaje para un quarter frame
+  uint16_t now = TCNT3;
+  uint8_t holdNow = TX_HOLD_NONE;
+  int32_t nextStart = INT32_MAX;
+  uint8_t nextLevel = TX_HOLD_NONE;
+
+  if (mode & MASTER_CLOCK) {
+    bool withMtc = mtcStartPending && running;
+    uint8_t level = withMtc ? TX_HOLD_MESSAGE : TX_HOLD_BYTE;
+    int32_t start = (int32_t)(uint16_t)(OCR3A - now) - (withMtc ? GUARD_MTC_COUNTS : GUARD_CLOCK_COUNTS);
+    if (start <= 0) {
+      holdNow = level;
+    } else {
+      nextStart = start;
+      nextLevel = level;
+    }
+  }
+
+  if (mtcRunning) {
+    int32_t start = (int32_t)(uint16_t)(OCR3B - now) - GUARD_MTC_COUNTS;
+    if (start <= 0) {
+      holdNow = TX_HOLD_MESSAGE;
+    } else if (start < nextStart) {
+      nextStart = start;
+      nextLevel = TX_HOLD_MESSAGE;
+    }
+  }
+
+  if (holdNow != TX_HOLD_NONE) midiUart.setTxHoldFromIsr(holdNow);
+
+  if (nextStart != INT32_MAX) {
+    OCR3C = now + (uint16_t)nextStart;
+    guardLevel = nextLevel;
+    TIFR3 = _BV(OCF3C);
+    TIMSK3 |= _BV(OCIE3C);
+  } else {
+    TIMSK3 &= ~_BV(OCIE3C);
+  }
+}
+
+inline void TimingGenerator::handleClockEvent() {
+  uint16_t eventTime = OCR3A;
+
+  midiUart.injectRealTimeFromIsr(MIDI_CLOCK);
+  clocksSent++;
+
+  if (running) {
+    if (awaitingFirstClock) {
+      // Primer tiempo tras Start/Continue: el MTC arranca alineado con él
+      awaitingFirstClock = false;
+      if (mtcStartPending) {
+        mtcStartPending = false;
+        mtcRunning = true;
+        emitQuarterFrame(eventTime);
+        TIFR3 = _BV(OCF3B);
+        TIMSK3 |= _BV(OCIE3B);
+      }
+    } else {
+      songPosition++;
+    }
+  }
+
+  if (pendingTransport) {
+    // Start/Continue/Stop justo detrás del clock: el siguiente clock es el primer tiempo
+    midiUart.injectRealTimeFromIsr(pendingTransport);
+    if (pendingTransport == MIDI_STOP) {
+      running = false;
+    } else {
+      running = true;
+      awaitingFirstClock = true;
+    }
+    pendingTransport = 0;
+  }
+
+  uint16_t next = advance(eventTime, clockCounts, clockRemainder, clockDenominator, clockAccumulator);
+  OCR3A = schedule(next, clockCounts + 1);
+
+  midiUart.setTxHoldFromIsr(TX_HOLD_NONE);
+  armGuard();
+}
+
+inline void TimingGenerator::handleQuarterFrameEvent() {
+  if (!mtcRunning) {
+    TIMSK3 &= ~_BV(OCIE3B);
+    return;
+  }
+  emitQuarterFrame(OCR3B);
+  midiUart.setTxHoldFromIsr(TX_HOLD_NONE);
+  armGuard();
+}
+
+inline void TimingGenerator::handleGuardEvent() {
+  midiUart.setTxHoldFromIsr(guardLevel);
+  TIMSK3 &= ~_BV(OCIE3C);
+  armGuard();
+}
+
+// ==================== DIAGNÓSTICO ====================
+
+void TimingGenerator::printStatistics() const {
+  static const char* const modeNames[4] = {"off", "clock", "MTC", "clock+MTC"};
+
+  debugSerial.print(F("Maestro: "));
+  debugSerial.print(modeNames[mode & MASTER_BOTH]);
+  debugSerial.print(F(" @ "));
+  debugSerial.print(tempoX10 / 10);
+  debugSerial.print(F("."));
+  debugSerial.print(tempoX10 % 10);
+  debugSerial.println(running ? F(" BPM, en marcha") : F(" BPM, parado"));
+
+  uint32_t clocks, quarters, late, dropped, underruns;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    clocks = clocksSent;
+    quarters = quarterFramesSent;
+    late = lateEvents;
+    dropped = quarterFramesDropped;
+    underruns = cycleUnderruns;
+  }
+  debugSerial.print(F("Maestro clocks/quarter frames: "));
+  debugSerial.print(clocks);
+  debugSerial.print(F("/"));
+  debugSerial.println(quarters);
+  debugSerial.print(F("Maestro eventos tarde/QF perdidos/ciclos repetidos: "));
+  debugSerial.print(late);
+  debugSerial.print(F("/"));
+  debugSerial.print(dropped);
+  debugSerial.print(F("/"));
+  debugSerial.println(underruns);
+}
+
+void TimingGenerator::resetStatistics() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    clocksSent = 0;
+    quarterFramesSent = 0;
+    lateEvents = 0;
+    quarterFramesDropped = 0;
+    cycleUnderruns = 0;
+  }
+}
+
+ISR(TIMER3_COMPA_vect) {
+  timingGenerator.handleClockEvent();
+}
+
+ISR(TIMER3_COMPB_vect) {
+  timingGenerator.handleQuarterFrameEvent();
+}
+
+ISR(TIMER3_COMPC_vect) {
+  timingGenerator.handleGuardEvent();
+}
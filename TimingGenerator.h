@@ -0,0 +1,112 @@
+#ifndef TIMING_GENERATOR_H
+#define TIMING_GENERATOR_H
+
+#include "Config.h"
+#include "MidiUart.h"
+#include <Arduino.h>
+
+// Generador de MIDI clock (24 ppqn) y quarter frames MTC como maestro.
+// Usa el Timer3 de 16 bits en modo libre a 4 us por cuenta: OCR3A marca el
+// siguiente clock, OCR3B el siguiente quarter frame y OCR3C el instante en
+// que hay que retener la transmisión para que la línea esté libre al llegar
+// el evento. Los bytes salen por el camino de inyección de MidiUart, sin
+// pasar por la cola TX ni esperar a los mensajes que haya en ella.
+#define TIMING_TIMER_US           4       // Prescaler 64 a 16 MHz
+#define TIMING_GUARD_CLOCK_US     700     // Dos bytes en vuelo (registro + desplazamiento)
+#define TIMING_GUARD_MTC_US       1400    // Terminar un mensaje de 3 bytes antes del quarter frame
+#define TIMING_MIN_TEMPO_X10      300     // 30.0 BPM
+#define TIMING_MAX_TEMPO_X10      3000    // 300.0 BPM
+
+#define MIDI_CLOCK                0xF8
+#define MIDI_CONTINUE             0xFB
+#define MTC_QUARTER_FRAME         0xF1
+
+class TimingGenerator {
+private:
+  // Configuración (escrita desde el loop con interrupciones deshabilitadas)
+  volatile uint8_t mode;                 // MasterMode
+  uint16_t tempoX10;
+  uint8_t rate;                          // MtcRate
+
+  // Periodos en cuentas del timer con resto fraccional (Bresenham)
+  volatile uint16_t clockCounts;
+  volatile uint16_t clockRemainder;
+  volatile uint16_t clockDenominator;
+  volatile uint16_t clockAccumulator;
+  volatile uint16_t quarterCounts;
+  volatile uint16_t quarterRemainder;
+  volatile uint16_t quarterDenominator;
+  volatile uint16_t quarterAccumulator;
+
+  // Estado del transporte
+  volatile bool running;
+  volatile bool awaitingFirstClock;      // El primer clock tras Start/Continue no avanza
+  volatile uint8_t pendingTransport;     // FA/FB/FC a enviar tras el próximo clock
+  volatile bool mtcRunning;
+  volatile bool mtcStartPending;         // Arrancar el MTC en el próximo clock (alineado)
+  volatile uint32_t songPosition;        // Pulsos de clock desde el inicio
+
+  // Quarter frames: el ciclo actual lo consume la ISR, el siguiente lo prepara el loop
+  volatile uint8_t cycleNibbles[8];
+  volatile uint8_t nextNibbles[8];
+  volatile bool nextReady;
+  volatile uint8_t piece;
+  volatile int32_t cycleFrame;           // Frame del ciclo que envía la ISR
+  int32_t nextCycleFrame;                // Frame del próximo ciclo (solo loop)
+  int32_t stoppedFrame;                  // Donde se reanuda el MTC
+  volatile uint8_t guardLevel;           // MidiTxHold a aplicar en OCR3C
+
+  // Estadísticas
+  volatile uint32_t clocksSent;
+  volatile uint32_t quarterFramesSent;
+  volatile uint32_t lateEvents;          // Evento programado en el pasado
+  volatile uint32_t quarterFramesDropped;  // El anterior seguía esperando frontera
+  volatile uint32_t cycleUnderruns;      // El loop no preparó el siguiente ciclo a tiempo
+
+  void configureTimer(bool enable);
+  void computeClockPeriod();
+  void computeQuarterPeriod();
+  void fillCycle(volatile uint8_t* nibbles, int32_t frame);
+  inline void armGuard();
+  inline void emitQuarterFrame(uint16_t eventTime);
+  inline uint16_t schedule(uint16_t next, uint16_t period);
+  static inline uint16_t advance(uint16_t base, uint16_t counts, uint16_t remainder,
+                                 uint16_t denominator, volatile uint16_t& accumulator);
+
+public:
+  TimingGenerator();
+
+  void setMode(uint8_t masterMode);
+  void setTempo(uint16_t bpmX10);
+  void setFrameRate(uint8_t mtcRate);
+  uint8_t getMode() const { return mode; }
+  uint16_t getTempo() const { return tempoX10; }
+  uint8_t getFrameRate() const { return rate; }
+  bool isActive() const { return mode != MASTER_OFF; }
+  bool generatesMtc() const { return mode & MASTER_MTC; }
+
+  // Transporte (botones Play/Stop en modo maestro)
+  void start();                          // Start desde el principio o Continue
+  void stop();                           // Segunda pulsación: volver al principio
+  bool isRunning() const { return running; }
+  uint32_t getSongPosition() const;
+  uint32_t getClocksSent() const;
+  uint32_t getQuarterFramesSent() const;
+  void getClockData(ClockData& out) const;
+
+  // Preparar el siguiente ciclo de quarter frames (llamar desde loop)
+  void update();
+
+  // Llamados desde las ISR de Timer3
+  inline void handleClockEvent();
+  inline void handleQuarterFrameEvent();
+  inline void handleGuardEvent();
+
+  // Diagnóstico
+  void printStatistics() const;
+  void resetStatistics();
+};
+
+extern TimingGenerator timingGenerator;
+
+#endif // TIMING_GENERATOR_H
@@ -0,0 +1,142 @@
+#include "UsbMidiPort.h"
+#include "MidiStats.h"
+#include "MidiTrace.h"
+
+#define RX_MASK (USB_MIDI_RX_SIZE - 1)
+
+UsbMidiPort usbMidi;
+DebugSerial debugSerial;
+
+UsbMidiPort::UsbMidiPort()
+  : enabled(false), rxHead(0), rxTail(0),
+    pingDetect(false), pingRequests(0), rxRunningStatus(0), rxDataIndex(0), rxFirstData(0),
+    bytesReceived(0), bytesSent(0), rxOverflows(0), rxHighWater(0)
+{
+}
+
+void UsbMidiPort::setEnabled(bool enable) {
+  if (enable == enabled) return;
+
+  if (enable) {
+    // Terminar de enviar la depuración pendiente antes del primer byte MIDI
+    Serial.flush();
+    while (Serial.available() > 0) Serial.read();
+  }
+  enabled = enable;
+  rxHead = rxTail = 0;
+  rxRunningStatus = 0;
+  rxDataIndex = 0;
+}
+
+void UsbMidiPort::poll() {
+  if (!enabled) return;
+
+  while (Serial.available() > 0) {
+    uint8_t data = Serial.read();
+    bytesReceived++;
+    if (pingDetect) detectPing(data);
+
+    uint8_t next = (rxHead + 1) & RX_MASK;
+    if (next == rxTail) {
+      rxOverflows++;
+      continue;
+    }
+    rxBuffer[rxHead] = data;
+    rxHead = next;
+
+    uint8_t used = (rxHead - rxTail) & RX_MASK;
+    if (used > rxHighWater) rxHighWater = used;
+  }
+}
+
+int UsbMidiPort::available() {
+  poll();
+  return (rxHead - rxTail) & RX_MASK;
+}
+
+int UsbMidiPort::peek() {
+  if (rxHead == rxTail) return -1;
+  return rxBuffer[rxTail];
+}
+
+int UsbMidiPort::read() {
+  if (rxHead == rxTail) return -1;
+  uint8_t data = rxBuffer[rxTail];
+  rxTail = (rxTail + 1) & RX_MASK;
+  return data;
+}
+
+size_t UsbMidiPort::write(uint8_t data) {
+  if (!enabled) return 0;
+  bytesSent++;
+  midiStats.countOut(STATS_PORT_USB, data);
+  midiTrace.captureOut(STATS_PORT_USB, data);
+  return Serial.write(data);
+}
+
+uint8_t UsbMidiPort::availableForWrite() {
+  if (!enabled) return 0;
+  int space = Serial.availableForWrite();
+  return (space > 0xFF) ? 0xFF : space;
+}
+
+void UsbMidiPort::detectPing(uint8_t data) {
+  // Mismo seguimiento mínimo del running status que MidiUart
+  if (data >= 0xF8) return;
+  if (data & 0x80) {
+    rxRunningStatus = data;
+    rxDataIndex = 0;
+    return;
+  }
+  if (rxRunningStatus != 0x90) return;
+
+  if (rxDataIndex == 0) {
+    rxFirstData = data;
+    rxDataIndex = 1;
+  } else {
+    if (rxFirstData == 0x00 && data == 0x00 && pingRequests < 0xFF) pingRequests++;
+    rxDataIndex = 0;
+  }
+}
+
+void UsbMidiPort::setPingDetect(bool enable) {
+  pingDetect = enable;
+  pingRequests = 0;
+  rxRunningStatus = 0;
+  rxDataIndex = 0;
+}
+
+uint8_t UsbMidiPort::takePingRequests() {
+  poll();
+  uint8_t value = pingRequests;
+  pingRequests = 0;
+  return value;
+}
+
+void UsbMidiPort::printStatistics() const {
+  debugSerial.print(F("USB MIDI bytes RX/TX: "));
+  debugSerial.print(bytesReceived);
+  debugSerial.print(F("/"));
+  debugSerial.println(bytesSent);
+  debugSerial.print(F("USB MIDI buffer RX (max/cap): "));
+  debugSerial.print(rxHighWater);
+  debugSerial.print(F("/"));
+  debugSerial.println(USB_MIDI_RX_SIZE - 1);
+  debugSerial.print(F("USB MIDI desbordes RX: "));
+  debugSerial.println(rxOverflows);
+}
+
+void UsbMidiPort::resetStatistics() {
+  bytesReceived = 0;
+  bytesSent = 0;
+  rxOverflows = 0;
+  rxHighWater = (rxHead - rxTail) & RX_MASK;
+}
+
+size_t DebugSerial::write(uint8_t data) {
+  if (usbMidi.isEnabled()) {
+    bytesSuppressed++;
+    return 1;
+  }
+  return Serial.write(data);
+}
@@ -0,0 +1,88 @@
+#ifndef USB_MIDI_PORT_H
+#define USB_MIDI_PORT_H
+
+#include <Arduino.h>
+
+// Segundo transporte MIDI sobre Serial (USB del Mega). En el host se
+// conecta con un puente serie-MIDI (pty o driver loopback). A 115200 baudios
+// da unas 3.7 veces el ancho de banda del MIDI DIN.
+//
+// El buffer RX de HardwareSerial (64 bytes) se llena en 5.5 ms a esta
+// velocidad, así que poll() lo vacía en un ring propio desde el loop y
+// desde los redibujados largos (onDisplayYield).
+#define USB_MIDI_BAUD_RATE     115200
+#define USB_MIDI_RX_SIZE       128   // Potencia de 2, máximo 256
+
+#if (USB_MIDI_RX_SIZE & (USB_MIDI_RX_SIZE - 1)) || USB_MIDI_RX_SIZE > 256
+#error "USB_MIDI_RX_SIZE debe ser potencia de 2 y <= 256"
+#endif
+
+class UsbMidiPort {
+private:
+  bool enabled;
+
+  uint8_t rxBuffer[USB_MIDI_RX_SIZE];
+  uint8_t rxHead;
+  uint8_t rxTail;
+
+  // Detector del ping HUI (90 00 00), como el de MidiUart
+  bool pingDetect;
+  uint8_t pingRequests;
+  uint8_t rxRunningStatus;
+  uint8_t rxDataIndex;
+  uint8_t rxFirstData;
+
+  // Estadísticas
+  uint32_t bytesReceived;
+  uint32_t bytesSent;
+  uint32_t rxOverflows;
+  uint16_t rxHighWater;
+
+  void detectPing(uint8_t data);
+
+public:
+  UsbMidiPort();
+
+  // Con el puerto activo Serial transporta MIDI y la depuración se silencia
+  void setEnabled(bool enable);
+  bool isEnabled() const { return enabled; }
+
+  // Pasar lo recibido por HardwareSerial al ring propio
+  void poll();
+
+  int available();
+  int peek();
+  int read();
+  size_t write(uint8_t data);
+  uint8_t availableForWrite();
+
+  // Ping HUI recibido por USB
+  void setPingDetect(bool enable);
+  uint8_t takePingRequests();
+
+  // Diagnóstico
+  uint32_t getRxOverflows() const { return rxOverflows; }
+  void printStatistics() const;
+  void resetStatistics();
+};
+
+// Salida de depuración: Serial mientras no transporte MIDI. Los mensajes de
+// texto intercalados en el stream MIDI los interpretaría el host como bytes
+// de datos, así que con el puerto USB activo se descartan.
+class DebugSerial : public Print {
+private:
+  uint32_t bytesSuppressed;
+
+public:
+  DebugSerial() : bytesSuppressed(0) {}
+
+  virtual size_t write(uint8_t data);
+  using Print::write;
+
+  uint32_t getBytesSuppressed() const { return bytesSuppressed; }
+};
+
+extern UsbMidiPort usbMidi;
+extern DebugSerial debugSerial;
+
+#endif // USB_MIDI_PORT_H